@@ -13,384 +13,2120 @@
     http://www.wtfpl.net/ for more details.
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <map>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+    #include <cpuid.h>
+#endif
+#if defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
 
 #include "rh_common.h"
 #include "bilinear_functions.h"
 #include "reduceby2_functions.h"
+#include "bilinear_functions_16bit.h"
+#include "reduceby2_functions_16bit.h"
+#include "bilinear_functions_float.h"
+#include "reduceby2_functions_float.h"
+#include "straight_alpha_functions.h"
+#include "convert_functions.h"
 
 #include "ResizeHalf.h"
 
 
 
-enum ProcType : int {
-    PROC_HV,
-    PROC_H,
-    PROC_V,
-};
-
-enum : int {
-    UNALIGNED_IMAGE = 0,
-    ALIGNED_IMAGE = (1 << 16),
-};
+static ResizeHalf::SIMD get_supported_simd() noexcept
+{
+#if defined(__SSE2__)
+    int regs[4] = {};
+#if defined(_MSC_VER)
+    __cpuid(regs, 1);
+#else
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    // AVX2 needs the OS to save YMM registers (OSXSAVE and XCR0[2:1]).
+    if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0) {
+        return ResizeHalf::SIMD_SSE;
+    }
+#if defined(_MSC_VER)
+    auto xcr0 = _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    auto xcr0 = eax;
+#endif
+    if ((xcr0 & 6) != 6) {
+        return ResizeHalf::SIMD_SSE;
+    }
+#if defined(_MSC_VER)
+    __cpuidex(regs, 7, 0);
+#else
+    __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    if ((regs[1] & (1 << 5)) == 0) {
+        return ResizeHalf::SIMD_SSE;
+    }
+    // AVX-512F/BW/VBMI, and the OS must save opmask and ZMM registers.
+    if ((regs[1] & (1 << 16)) && (regs[1] & (1 << 30)) && (regs[2] & (1 << 1))
+            && (xcr0 & 0xE6) == 0xE6) {
+        return ResizeHalf::SIMD_AVX512;
+    }
+    return ResizeHalf::SIMD_AVX2;
+#elif defined(RH_VECTOR_EXT)
+    return ResizeHalf::SIMD_VECTOR;
+#else
+    return ResizeHalf::SIMD_NONE;
+#endif
+}
 
 
-ResizeHalf::ResizeHalf(const FMT fmt, const MODE m) :
-    format(fmt), mode(m), image(nullptr), buffsize(0), width(0), height(0),
-    stride(0), align(16 - 1)
-{}
+ResizeHalf::SIMD ResizeHalf::getSupportedSimd() noexcept
+{
+    static const SIMD supported = get_supported_simd();
+    return supported;
+}
 
 
-ResizeHalf::~ResizeHalf()
+// Returns the size of the largest cache reported by CPUID, or 0.
+static size_t get_cache_size() noexcept
 {
 #if defined(__SSE2__)
-    _mm_free(image);
+    return cache_size_from_cpuid([](int regs[4], const int leaf, const int sub) {
+#if defined(_MSC_VER)
+        __cpuidex(regs, leaf, sub);
 #else
-    std::free(image);
+        __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    });
+#else
+    return 0;
 #endif
-    image = nullptr;
 }
 
 
-void ResizeHalf::setFormat(const FMT f) noexcept
+size_t ResizeHalf::getCacheSize() noexcept
 {
-    format = f;
+    // assumed if unknown.
+    constexpr size_t default_cache_size = 8 << 20;
+
+    static const size_t size = get_cache_size();
+    return size != 0 ? size : default_cache_size;
 }
 
 
-void ResizeHalf::setProcMode(const MODE m) noexcept
+// REDUCE_BY_2_EXACT without the bit of exact rounding.
+static int without_exact(const int flag) noexcept
 {
-    mode = m;
+    return flag & ~(ResizeHalf::REDUCE_BY_2_EXACT ^ ResizeHalf::REDUCE_BY_2);
 }
 
 
-void ResizeHalf::alloc()
+// C kernels round exactly in any mode.
+static proc_func_t get_proc_c(const int pt, const int flag) noexcept
 {
+    switch (without_exact(flag) & ~(ALIGNED_IMAGE | CACHED_STORE)) {
+    case (ResizeHalf::BILINEAR | ResizeHalf::GREY8):
+        return pt == PROC_HV ? bilinear_hv_grey_c
+            : pt == PROC_H ? bilinear_h_grey_c : bilinear_v_grey_c;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGB888):
+        return pt == PROC_HV ? bilinear_hv_rgb888_c
+            : pt == PROC_H ? bilinear_h_rgb888_c : bilinear_v_rgb888_c;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? bilinear_hv_rgba_c
+            : pt == PROC_H ? bilinear_h_rgba_c : bilinear_v_rgba_c;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_grey_c
+            : pt == PROC_H ? reduceby2_h_grey_c : reduceby2_v_grey_c;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGB888):
+        return pt == PROC_HV ? reduceby2_hv_rgb888_c
+            : pt == PROC_H ? reduceby2_h_rgb888_c : reduceby2_v_rgb888_c;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_rgba_c
+            : pt == PROC_H ? reduceby2_h_rgba_c : reduceby2_v_rgba_c;
+    case (ResizeHalf::BILINEAR | ResizeHalf::GREY16):
+        return pt == PROC_HV ? bilinear_hv_16bit_c<1>
+            : pt == PROC_H ? bilinear_h_16bit_c<1> : bilinear_v_16bit_c<1>;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGB48):
+        return pt == PROC_HV ? bilinear_hv_16bit_c<3>
+            : pt == PROC_H ? bilinear_h_16bit_c<3> : bilinear_v_16bit_c<3>;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGBA64):
+        return pt == PROC_HV ? bilinear_hv_16bit_c<4>
+            : pt == PROC_H ? bilinear_h_16bit_c<4> : bilinear_v_16bit_c<4>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY16):
+        return pt == PROC_HV ? reduceby2_hv_16bit_c<1>
+            : pt == PROC_H ? reduceby2_h_16bit_c<1> : reduceby2_v_16bit_c<1>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGB48):
+        return pt == PROC_HV ? reduceby2_hv_16bit_c<3>
+            : pt == PROC_H ? reduceby2_h_16bit_c<3> : reduceby2_v_16bit_c<3>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA64):
+        return pt == PROC_HV ? reduceby2_hv_16bit_c<4>
+            : pt == PROC_H ? reduceby2_h_16bit_c<4> : reduceby2_v_16bit_c<4>;
+    case (ResizeHalf::BILINEAR | ResizeHalf::GREYF32):
+        return pt == PROC_HV ? bilinear_hv_float_c<1>
+            : pt == PROC_H ? bilinear_h_float_c<1> : bilinear_v_float_c<1>;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGBF32):
+        return pt == PROC_HV ? bilinear_hv_float_c<3>
+            : pt == PROC_H ? bilinear_h_float_c<3> : bilinear_v_float_c<3>;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGBAF32):
+        return pt == PROC_HV ? bilinear_hv_float_c<4>
+            : pt == PROC_H ? bilinear_h_float_c<4> : bilinear_v_float_c<4>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREYF32):
+        return pt == PROC_HV ? reduceby2_hv_float_c<1>
+            : pt == PROC_H ? reduceby2_h_float_c<1> : reduceby2_v_float_c<1>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBF32):
+        return pt == PROC_HV ? reduceby2_hv_float_c<3>
+            : pt == PROC_H ? reduceby2_h_float_c<3> : reduceby2_v_float_c<3>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBAF32):
+        return pt == PROC_HV ? reduceby2_hv_float_c<4>
+            : pt == PROC_H ? reduceby2_h_float_c<4> : reduceby2_v_float_c<4>;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGBA8888_STRAIGHT):
+        return pt == PROC_HV ? straight_alpha_c<true, PROC_HV>
+            : pt == PROC_H ? straight_alpha_c<true, PROC_H>
+            : straight_alpha_c<true, PROC_V>;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888_STRAIGHT):
+        return pt == PROC_HV ? straight_alpha_c<false, PROC_HV>
+            : pt == PROC_H ? straight_alpha_c<false, PROC_H>
+            : straight_alpha_c<false, PROC_V>;
+    case (ResizeHalf::BILINEAR | UV88):
+        return pt == PROC_HV ? bilinear_hv_uv_c
+            : pt == PROC_H ? bilinear_h_uv_c : bilinear_v_uv_c;
+    case (ResizeHalf::REDUCE_BY_2 | UV88):
+        return pt == PROC_HV ? reduceby2_hv_uv_c
+            : pt == PROC_H ? reduceby2_h_uv_c : reduceby2_v_uv_c;
+    default:
+        return nullptr;
+    }
+}
+
+
 #if defined(__SSE2__)
-    _mm_free(image);
-    image = static_cast<uint8_t*>(_mm_malloc(stride * height, align + 1));
+template <bool STREAM>
+static proc_func_t get_proc_sse2(const int pt, const int flag) noexcept
+{
+    switch (flag) {
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREY8):
+        return pt == PROC_HV ? bilinear_hv_grey<true, STREAM>
+            : pt == PROC_H ? bilinear_h_grey<true, STREAM>
+            : bilinear_v_grey<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? bilinear_hv_rgba<true, STREAM>
+            : pt == PROC_H ? bilinear_h_rgba<true, STREAM>
+            : bilinear_v_rgba<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_grey<true, STREAM>
+            : pt == PROC_H ? reduceby2_h_grey<true, STREAM>
+            : reduceby2_v_grey<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_rgba<true, STREAM>
+            : pt == PROC_H ? reduceby2_h_rgba<true, STREAM>
+            : reduceby2_v_rgba<true, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREY8):
+        return pt == PROC_HV ? bilinear_hv_grey<false, STREAM>
+            : pt == PROC_H ? bilinear_h_grey<false, STREAM>
+            : bilinear_v_grey<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGB888):
+#if defined(__SSSE3__)
+        return pt == PROC_HV ? bilinear_hv_rgb888
+            : pt == PROC_H ? bilinear_h_rgb888 : bilinear_v_rgb888;
 #else
-    std::free(image);
-    image = static_cast<uint8_t*>(std::malloc(stride * height));
+        return pt == PROC_HV ? bilinear_hv_rgb888_c
+            : pt == PROC_H ? bilinear_h_rgb888_c : bilinear_v_rgb888;
 #endif
-    if (!image) {
-        throw std::runtime_error("failed to allocate buffer.");
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? bilinear_hv_rgba<false, STREAM>
+            : pt == PROC_H ? bilinear_h_rgba<false, STREAM>
+            : bilinear_v_rgba<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_grey<false, STREAM>
+            : pt == PROC_H ? reduceby2_h_grey<false, STREAM>
+            : reduceby2_v_grey<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGB888):
+#if defined(__SSSE3__)
+        return pt == PROC_HV ? reduceby2_hv_rgb888
+            : pt == PROC_H ? reduceby2_h_rgb888<false> : reduceby2_v_rgb888<false>;
+#else
+        return pt == PROC_HV ? reduceby2_hv_rgb888_c
+            : pt == PROC_H ? reduceby2_h_rgb888_c : reduceby2_v_rgb888<false>;
+#endif
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_rgba<false, STREAM>
+            : pt == PROC_H ? reduceby2_h_rgba<false, STREAM>
+            : reduceby2_v_rgba<false, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_exact<1, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_grey<true, STREAM, true>
+            : reduceby2_v_grey<true, STREAM, true>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_exact<4, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_rgba<true, STREAM, true>
+            : reduceby2_v_rgba<true, STREAM, true>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_exact<1, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_grey<false, STREAM, true>
+            : reduceby2_v_grey<false, STREAM, true>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | ResizeHalf::RGB888):
+#if defined(__SSSE3__)
+        return pt == PROC_HV ? reduceby2_hv_rgb888_exact
+            : pt == PROC_H ? reduceby2_h_rgb888<true> : reduceby2_v_rgb888<true>;
+#else
+        return pt == PROC_HV ? reduceby2_hv_rgb888_c
+            : pt == PROC_H ? reduceby2_h_rgb888_c : reduceby2_v_rgb888<true>;
+#endif
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_exact<4, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_rgba<false, STREAM, true>
+            : reduceby2_v_rgba<false, STREAM, true>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREY16):
+        return pt == PROC_HV ? bilinear_hv_16bit<1, true, STREAM>
+            : pt == PROC_H ? bilinear_h_16bit<1, true, STREAM>
+            : bilinear_v_16bit<1, true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA64):
+        return pt == PROC_HV ? bilinear_hv_16bit<4, true, STREAM>
+            : pt == PROC_H ? bilinear_h_16bit<4, true, STREAM>
+            : bilinear_v_16bit<4, true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY16):
+        return pt == PROC_HV ? reduceby2_hv_16bit<1, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_16bit<1, true, STREAM>
+            : reduceby2_v_16bit<1, true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA64):
+        return pt == PROC_HV ? reduceby2_hv_16bit<4, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_16bit<4, true, STREAM>
+            : reduceby2_v_16bit<4, true, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREY16):
+        return pt == PROC_HV ? bilinear_hv_16bit<1, false, STREAM>
+            : pt == PROC_H ? bilinear_h_16bit<1, false, STREAM>
+            : bilinear_v_16bit<1, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA64):
+        return pt == PROC_HV ? bilinear_hv_16bit<4, false, STREAM>
+            : pt == PROC_H ? bilinear_h_16bit<4, false, STREAM>
+            : bilinear_v_16bit<4, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY16):
+        return pt == PROC_HV ? reduceby2_hv_16bit<1, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_16bit<1, false, STREAM>
+            : reduceby2_v_16bit<1, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA64):
+        return pt == PROC_HV ? reduceby2_hv_16bit<4, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_16bit<4, false, STREAM>
+            : reduceby2_v_16bit<4, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGB48):
+        return pt == PROC_HV ? bilinear_hv_rgb48
+            : pt == PROC_H ? bilinear_h_rgb48 : bilinear_v_16bit<3, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGB48):
+        return pt == PROC_HV ? reduceby2_hv_rgb48
+            : pt == PROC_H ? reduceby2_h_rgb48 : reduceby2_v_16bit<3, false, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREYF32):
+        return pt == PROC_HV ? bilinear_hv_float<1, true, STREAM>
+            : pt == PROC_H ? bilinear_h_float<1, true, STREAM>
+            : bilinear_v_float<1, true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBAF32):
+        return pt == PROC_HV ? bilinear_hv_float<4, true, STREAM>
+            : pt == PROC_H ? bilinear_h_float<4, true, STREAM>
+            : bilinear_v_float<4, true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREYF32):
+        return pt == PROC_HV ? reduceby2_hv_float<1, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_float<1, true, STREAM>
+            : reduceby2_v_float<1, true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBAF32):
+        return pt == PROC_HV ? reduceby2_hv_float<4, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_float<4, true, STREAM>
+            : reduceby2_v_float<4, true, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREYF32):
+        return pt == PROC_HV ? bilinear_hv_float<1, false, STREAM>
+            : pt == PROC_H ? bilinear_h_float<1, false, STREAM>
+            : bilinear_v_float<1, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBAF32):
+        return pt == PROC_HV ? bilinear_hv_float<4, false, STREAM>
+            : pt == PROC_H ? bilinear_h_float<4, false, STREAM>
+            : bilinear_v_float<4, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREYF32):
+        return pt == PROC_HV ? reduceby2_hv_float<1, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_float<1, false, STREAM>
+            : reduceby2_v_float<1, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBAF32):
+        return pt == PROC_HV ? reduceby2_hv_float<4, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_float<4, false, STREAM>
+            : reduceby2_v_float<4, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBF32):
+        return pt == PROC_HV ? bilinear_hv_rgbf32
+            : pt == PROC_H ? bilinear_h_rgbf32 : bilinear_v_float<3, false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBF32):
+        return pt == PROC_HV ? reduceby2_hv_rgbf32
+            : pt == PROC_H ? reduceby2_h_rgbf32 : reduceby2_v_float<3, false, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA8888_STRAIGHT):
+        return pt == PROC_HV ? bilinear_hv_straight<true, STREAM>
+            : pt == PROC_H ? bilinear_h_straight<true, STREAM>
+            : bilinear_v_straight<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888_STRAIGHT):
+        return pt == PROC_HV ? reduceby2_hv_straight<true, STREAM>
+            : pt == PROC_H ? reduceby2_h_straight<true, STREAM>
+            : reduceby2_v_straight<true, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA8888_STRAIGHT):
+        return pt == PROC_HV ? bilinear_hv_straight<false, STREAM>
+            : pt == PROC_H ? bilinear_h_straight<false, STREAM>
+            : bilinear_v_straight<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888_STRAIGHT):
+        return pt == PROC_HV ? reduceby2_hv_straight<false, STREAM>
+            : pt == PROC_H ? reduceby2_h_straight<false, STREAM>
+            : reduceby2_v_straight<false, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | UV88):
+        return pt == PROC_HV ? bilinear_hv_uv<true, STREAM>
+            : pt == PROC_H ? bilinear_h_uv<true, STREAM>
+            : bilinear_v_uv<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | UV88):
+        return pt == PROC_HV ? reduceby2_hv_uv<true, STREAM>
+            : pt == PROC_H ? reduceby2_h_uv<true, STREAM>
+            : reduceby2_v_uv<true, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | UV88):
+        return pt == PROC_HV ? bilinear_hv_uv<false, STREAM>
+            : pt == PROC_H ? bilinear_h_uv<false, STREAM>
+            : bilinear_v_uv<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | UV88):
+        return pt == PROC_HV ? reduceby2_hv_uv<false, STREAM>
+            : pt == PROC_H ? reduceby2_h_uv<false, STREAM>
+            : reduceby2_v_uv<false, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | UV88):
+        return pt == PROC_HV ? reduceby2_hv_exact<2, true, STREAM>
+            : pt == PROC_H ? reduceby2_h_uv<true, STREAM, true>
+            : reduceby2_v_uv<true, STREAM, true>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2_EXACT | UV88):
+        return pt == PROC_HV ? reduceby2_hv_exact<2, false, STREAM>
+            : pt == PROC_H ? reduceby2_h_uv<false, STREAM, true>
+            : reduceby2_v_uv<false, STREAM, true>;
+    default:
+        return nullptr;
     }
-    buffsize = stride * height;
 }
 
 
-const size_t ResizeHalf::
-prepare(const uint8_t* srcp, const size_t sw, const size_t sh, const size_t ss,
-        const size_t ds, int pt)
+static proc_func_t get_proc_sse2(const int pt, const int flag) noexcept
 {
-    if (sw < 16 || sh < 16) {
-        throw std::runtime_error("source image is too small.");
-    }
-    if (!srcp) {
-        throw std::runtime_error("null pointer exception.");
+    return flag & CACHED_STORE ? get_proc_sse2<false>(pt, flag & ~CACHED_STORE)
+        : get_proc_sse2<true>(pt, flag);
+}
+#endif
+
+
+namespace {
+
+// A kernel to process with. SIMD kernels load and store whole vectors, so
+// they may read and write up to margin bytes after the end of a row. Those
+// bytes are in the next row except for the last rows, which are processed one
+// by one: their last columns are made from a copy in a small buffer. So
+// nothing after the last rows is touched, and the results are the same.
+// Strides may be negative (bottom-up images). Then the bytes after a row are
+// in the previous one: the rows reading the first source row are processed
+// one by one, and so are all rows if output rows are of a negative stride.
+struct Proc {
+    proc_func_t func;
+    int pt;
+    bool reduce;
+    size_t bpp;
+    size_t margin;      // 0 for C kernels.
+
+    explicit operator bool() const noexcept { return func != nullptr; }
+
+    // If tight, nothing after the end of any output row is written.
+    void operator()(const uint8_t* srcp, uint8_t* dstp, const size_t width,
+                    const size_t height, const ptrdiff_t ss, const ptrdiff_t ds,
+                    const bool tight=false) const noexcept;
+
+    void procRow(const uint8_t* srcp, uint8_t* dstp, const size_t width,
+                 const size_t rows, const ptrdiff_t ss) const noexcept;
+};
+
+// Largest margin, and the size of the buffer for the last columns of a row
+// (up to 3 source rows and an output row).
+constexpr size_t max_margin = 256;
+constexpr size_t tail_stride = 1024;
+
+} // namespace
+
+
+// Offset of the row y of stride, which may be negative.
+static inline ptrdiff_t row_offset(const size_t y, const ptrdiff_t stride) noexcept
+{
+    return static_cast<ptrdiff_t>(y) * stride;
+}
+
+
+void Proc::operator()(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t ss, const ptrdiff_t ds, const bool tight) const noexcept
+{
+    if (margin == 0) {
+        func(srcp, dstp, width, height, ss, ds);
+        return;
     }
 
-    size_t sstride = ss;
-    if (sstride == 0) {
-        if (format == GREY8) {
-            sstride = (sw + 3) & ~3;
-        } else if (format == RGB888) {
-            sstride = (sw * 3 + 3) & ~3;
-        } else {
-            sstride = sw * 4;
+    // The rows from y0 read or write within margin bytes from the ends.
+    const size_t oh = pt == PROC_H ? height : height / 2;
+    const size_t extra = reduce ? 1 : 0;
+    size_t y0 = tight || ds < 0 ? 0 : oh;
+    while (y0 > 0) {
+        const size_t y = y0 - 1;
+        const size_t last = pt == PROC_H ? y : y + 1 == oh ? height - 1 : 2 * y + 1 + extra;
+        if ((oh - 1 - y) * static_cast<size_t>(ds) >= margin
+                && (ss < 0 || (height - 1 - last) * static_cast<size_t>(ss) >= margin)) {
+            break;
         }
+        --y0;
     }
-    if (sstride < sw * format) {
-        throw std::runtime_error("inavlid src_stride was specified.");
+    // The rows before y1 read within margin bytes from the end of the first
+    // source row, of a negative stride.
+    size_t y1 = 0;
+    while (ss < 0 && y1 < y0
+           && (pt == PROC_H ? y1 : 2 * y1) * static_cast<size_t>(-ss) < margin) {
+        ++y1;
     }
 
-    width = pt == PROC_V ? sw : sw / 2;
-    if (ds != 0 && ds < width * format) {
-        throw std::runtime_error("invalid dst_stride was specified.");
+    auto proc_row = [&](const size_t y) {
+        const size_t sy = pt == PROC_H ? y : 2 * y;
+        const size_t rows = pt == PROC_H ? 1 : y + 1 == oh ? height - sy : 2 + extra;
+        procRow(srcp + row_offset(sy, ss), dstp + row_offset(y, ds), width, rows, ss);
+    };
+    for (size_t y = 0; y < y1; ++y) {
+        proc_row(y);
     }
-    height = pt == PROC_H ? sh : sh / 2;
-    auto f = format == RGB888 ? 4 : format;
-    stride = (width * f + align) & ~align;
-    if (height * stride > buffsize) {
-        alloc();
+    if (y0 > y1) {
+        const size_t sy = pt == PROC_H ? y1 : 2 * y1;
+        func(srcp + row_offset(sy, ss), dstp + row_offset(y1, ds), width,
+             pt == PROC_H ? y0 - y1 : 2 * (y0 - y1) + extra, ss, ds);
+    }
+    for (size_t y = y0; y < oh; ++y) {
+        proc_row(y);
     }
-
-    return sstride;
 }
 
 
-void ResizeHalf::copyToDst(uint8_t* dstp, const size_t ds) noexcept
+// Makes an output row from rows source rows.
+void Proc::procRow(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t rows,
+    const ptrdiff_t ss) const noexcept
 {
-    if (!dstp) {
-        return;
-    }
-
-    auto dstride = ds;
-    if (dstride == 0) {
-        if (format == GREY8) {
-            dstride = (width + 3) & ~3;
-        } else if (format == RGB888) {
-            dstride = (width * 3 + 3) & ~3;
-        } else {
-            dstride = width * 4;
-        }
+    // The last tail output columns are made in buf. The columns before them
+    // are made in place, as the vectors for them end margin bytes before.
+    const size_t ow = pt == PROC_V ? width : width / 2;
+    const size_t tail = std::min(ow, margin / bpp + 1);
+    const size_t k = ow - tail;
+    const size_t sx = pt == PROC_V ? k : 2 * k;
+    if (k > 0) {
+        func(srcp, dstp, pt == PROC_V ? k : 2 * k + (reduce ? 1 : 0), rows, ss, 0);
     }
 
-    const uint8_t* s = image;
-    auto rowsize = width * format;
-    if (rowsize == dstride && rowsize == stride) {
-        std::memcpy(dstp, s, rowsize * height);
-    } else {
-        for (size_t y = 0; y < height; ++y) {
-            std::memcpy(dstp, s, rowsize);
-            s += stride;
-            dstp += dstride;
-        }
+    alignas(64) uint8_t buf[4 * tail_stride];
+    const size_t tw = width - sx;
+    const size_t bs = (tw * bpp + margin + 63) & ~static_cast<size_t>(63);
+    for (size_t r = 0; r < rows; ++r) {
+        std::memcpy(buf + r * bs, srcp + row_offset(r, ss) + sx * bpp, tw * bpp);
     }
+    uint8_t* out = buf + rows * bs;
+    func(buf, out, tw, rows, bs, bs);
+    std::memcpy(dstp + k * bpp, out, tail * bpp);
 }
 
 
-int ResizeHalf::getFlag(const void* ptr, size_t bytes) const noexcept
+// Picks the kernel from the best instruction set not exceeding simd.
+static Proc get_proc(const int simd, const int pt, int flag) noexcept
 {
+    // Only SIMD kernels of 8bit formats have another version for exact
+    // rounding. The others are the same as REDUCE_BY_2.
+    const int fmt = flag & 0xFF;
+    if (fmt != ResizeHalf::GREY8 && fmt != ResizeHalf::RGB888
+            && fmt != ResizeHalf::RGBA8888 && fmt != UV88) {
+        flag = without_exact(flag);
+    }
+
+    Proc proc{nullptr, pt, (flag & ResizeHalf::REDUCE_BY_2) != 0,
+              static_cast<size_t>(flag & 0x3F), 0};
 #if defined(__SSE2__)
-    int flag = (mode | format);
-    if (format != RGB888
-            && ((reinterpret_cast<uintptr_t>(ptr) | bytes) & align) == 0) {
-        flag |= ALIGNED_IMAGE;
+    if (simd >= ResizeHalf::SIMD_AVX512) {
+        proc.func = get_proc_avx512(pt, flag);
+        proc.margin = max_margin;
+    }
+    if (!proc.func && simd >= ResizeHalf::SIMD_AVX2) {
+        proc.func = get_proc_avx2(pt, flag);
+        proc.margin = 128;
+    }
+#endif
+#if defined(RH_VECTOR_EXT)
+    if (!proc.func && simd >= ResizeHalf::SIMD_VECTOR) {
+        proc.func = get_proc_vec(pt, flag);
+        proc.margin = 64;
+    }
+#endif
+#if defined(__SSE2__)
+    if (!proc.func && simd >= ResizeHalf::SIMD_SSE) {
+        proc.func = get_proc_sse2(pt, flag);
+        proc.margin = 64;
     }
-    return flag;
-#else
-    return (mode | format);
 #endif
+    if (!proc.func) {
+        proc.func = get_proc_c(pt, flag);
+        proc.margin = 0;
+    }
+    return proc;
 }
 
 
-void ResizeHalf::resizeHV(
-    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
-    const size_t ds, const size_t ss)
+static uint8_t* aligned_malloc(const size_t size, const size_t alignment) noexcept
 {
-    auto sstride = prepare(srcp, sw, sh, ss, ds, PROC_HV);
-    int proc = getFlag(srcp, sstride);
-
 #if defined(__SSE2__)
-    switch (proc) {
-    case (ALIGNED_IMAGE | BILINEAR | GREY8):
-        bilinear_hv_grey<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | BILINEAR | RGBA8888):
-        bilinear_hv_rgba<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | REDUCE_BY_2 | GREY8):
-        reduceby2_hv_grey<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | REDUCE_BY_2 | RGBA8888):
-        reduceby2_hv_rgba<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | GREY8):
-        bilinear_hv_grey<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | RGB888):
-#if defined(__SSSE3__)
-        bilinear_hv_rgb888(srcp, image, sw, sh, sstride, stride);
+    return static_cast<uint8_t*>(_mm_malloc(size, alignment));
 #else
-        bilinear_hv_rgb888_c(srcp, image, sw, sh, sstride, stride);
+    (void)alignment;
+    return static_cast<uint8_t*>(std::malloc(size));
 #endif
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | RGBA8888):
-        bilinear_hv_rgba<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | GREY8):
-        reduceby2_hv_grey<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | RGB888):
-#if defined(__SSSE3__)
-        reduceby2_hv_rgb888(srcp, image, sw, sh, sstride, stride);
+}
+
+
+static void aligned_free(void* p) noexcept
+{
+#if defined(__SSE2__)
+    _mm_free(p);
 #else
-        reduceby2_hv_rgb888_c(srcp, image, sw, sh, sstride, stride);
+    std::free(p);
 #endif
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | RGBA8888):
-        reduceby2_hv_rgba<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    default:
-        break;
+}
+
+
+namespace {
+
+// The default allocator.
+class AlignedAllocator : public ResizeHalf::Allocator {
+public:
+    void* allocate(const size_t size, const size_t alignment) noexcept override
+    {
+        return aligned_malloc(size, alignment);
     }
-#else
-    switch (proc) {
-    case (BILINEAR | GREY8):
-        bilinear_hv_grey_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (BILINEAR | RGB888):
-        bilinear_hv_rgb888_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (BILINEAR | RGBA8888):
-        bilinear_hv_rgba_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | GREY8):
-        reduceby2_hv_grey_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | RGB888):
-        reduceby2_hv_rgb888_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | RGBA8888):
-        reduceby2_hv_rgba_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    default:
-        break;
+
+    void deallocate(void* p, const size_t) noexcept override
+    {
+        aligned_free(p);
     }
-#endif
+};
+
+} // namespace
 
-    copyToDst(dstp, ds);
+
+static std::shared_ptr<ResizeHalf::Allocator> default_allocator()
+{
+    static const std::shared_ptr<ResizeHalf::Allocator> a =
+        std::make_shared<AlignedAllocator>();
+    return a;
 }
 
 
-void ResizeHalf::resizeHorizontal(
-    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
-    const size_t ds, const size_t ss)
+// Free buffers of BufferPool by size, all aligned to 64 bytes.
+struct ResizeHalf::BufferPool::Blocks {
+    std::mutex mtx;
+    std::multimap<size_t, void*> free;
+    size_t pooled;
+    size_t max_pooled;
+};
+
+
+// Rounds size up to 1.25, 1.5, 1.75 or 2 times a power of 2 (4KiB at least),
+// so that a buffer freed is reused for a little smaller or larger one.
+static size_t pool_size(const size_t size) noexcept
+{
+    size_t step = 1024;
+    while (step * 8 <= size) {
+        step *= 2;
+    }
+    return std::max<size_t>((size + step - 1) & ~(step - 1), 4096);
+}
+
+
+ResizeHalf::BufferPool::BufferPool(const size_t max_pooled) :
+    blocks(new Blocks())
 {
-    auto sstride = prepare(srcp, sw, sh, ss, ds, PROC_H);
-    int proc = getFlag(srcp, sstride);
+    blocks->pooled = 0;
+    blocks->max_pooled = max_pooled;
+}
 
-#if defined(__SSE2__)
-    switch (proc) {
-    case (ALIGNED_IMAGE | BILINEAR | GREY8):
-        bilinear_h_grey<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | BILINEAR | RGBA8888):
-        bilinear_h_rgba<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | REDUCE_BY_2 | GREY8):
-        reduceby2_h_grey<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | REDUCE_BY_2 | RGBA8888):
-        reduceby2_h_rgba<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | GREY8):
-        bilinear_h_grey<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | RGB888):
-#if defined(__SSSE3__)
-        bilinear_h_rgb888(srcp, image, sw, sh, sstride, stride);
-#else
-        bilinear_h_rgb888_c(srcp, image, sw, sh, sstride, stride);
+
+ResizeHalf::BufferPool::~BufferPool()
+{
+    trim();
+}
+
+
+void* ResizeHalf::BufferPool::allocate(const size_t size, const size_t alignment) noexcept
+{
+    const size_t n = pool_size(size);
+    {
+        std::lock_guard<std::mutex> lock(blocks->mtx);
+        auto it = blocks->free.find(n);
+        if (it != blocks->free.end()) {
+            void* p = it->second;
+            blocks->free.erase(it);
+            blocks->pooled -= n;
+            return p;
+        }
+    }
+    return aligned_malloc(n, std::max<size_t>(alignment, 64));
+}
+
+
+void ResizeHalf::BufferPool::deallocate(void* p, const size_t size) noexcept
+{
+    if (!p) {
+        return;
+    }
+    const size_t n = pool_size(size);
+    {
+        std::lock_guard<std::mutex> lock(blocks->mtx);
+        if (blocks->pooled + n <= blocks->max_pooled) {
+            try {
+                blocks->free.emplace(n, p);
+                blocks->pooled += n;
+                return;
+            } catch (const std::bad_alloc&) {
+            }
+        }
+    }
+    aligned_free(p);
+}
+
+
+void ResizeHalf::BufferPool::trim() noexcept
+{
+    std::multimap<size_t, void*> free;
+    {
+        std::lock_guard<std::mutex> lock(blocks->mtx);
+        free.swap(blocks->free);
+        blocks->pooled = 0;
+    }
+    for (auto& b : free) {
+        aligned_free(b.second);
+    }
+}
+
+
+size_t ResizeHalf::BufferPool::getPooledBytes() const noexcept
+{
+    std::lock_guard<std::mutex> lock(blocks->mtx);
+    return blocks->pooled;
+}
+
+
+#if defined(__linux__)
+// Size of huge pages (x86-64 and the default of arm64).
+constexpr size_t huge_page_size = 2 << 20;
+
+
+// Maps size bytes (a multiple of huge_page_size) at an address aligned to
+// huge_page_size, so that they can be of transparent huge pages.
+static void* map_aligned(const size_t size) noexcept
+{
+    const size_t n = size + huge_page_size;
+    void* m = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) {
+        return nullptr;
+    }
+    uint8_t* p = static_cast<uint8_t*>(m);
+    uint8_t* a = reinterpret_cast<uint8_t*>(
+        (reinterpret_cast<uintptr_t>(p) + huge_page_size - 1) & ~(huge_page_size - 1));
+    if (a > p) {
+        munmap(p, a - p);
+    }
+    if (p + n > a + size) {
+        munmap(a + size, p + n - (a + size));
+    }
+    return a;
+}
+
+
+// Prefers the NUMA node of the calling thread for the pages of p, which are
+// not touched yet. Nothing is done if it is unknown.
+static void bind_local(void* p, const size_t size) noexcept
+{
+    constexpr unsigned max_nodes = 1024;
+    constexpr size_t bits = 8 * sizeof(unsigned long);
+    constexpr int mpol_preferred = 1;
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= max_nodes) {
+        return;
+    }
+    unsigned long mask[max_nodes / bits] = {};
+    mask[node / bits] = 1UL << (node % bits);
+    syscall(SYS_mbind, p, size, mpol_preferred, mask, max_nodes + 1, 0);
+}
 #endif
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | RGBA8888):
-        bilinear_h_rgba<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | GREY8):
-        reduceby2_h_grey<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | RGB888):
-#if defined(__SSSE3__)
-        reduceby2_h_rgb888(srcp, image, sw, sh, sstride, stride);
-#else
-        reduceby2_h_rgb888_c(srcp, image, sw, sh, sstride, stride);
+
+
+ResizeHalf::PageAllocator::PageAllocator(const PAGES pg, const bool local) noexcept :
+    pages(pg), node_local(local)
+{
+}
+
+
+void* ResizeHalf::PageAllocator::allocate(const size_t size, const size_t alignment) noexcept
+{
+#if defined(__linux__)
+    if (size >= huge_page_size) {
+        const size_t n = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+        void* p = nullptr;
+#if defined(MAP_HUGETLB)
+        if (pages == PAGES_HUGE) {
+            p = mmap(nullptr, n, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            p = p == MAP_FAILED ? nullptr : p;
+        }
 #endif
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | RGBA8888):
-        reduceby2_h_rgba<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    default:
-        break;
+        if (!p) {
+            p = map_aligned(n);
+#if defined(MADV_HUGEPAGE)
+            if (p && pages != PAGES_DEFAULT) {
+                madvise(p, n, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        if (p && node_local) {
+            bind_local(p, n);
+        }
+        return p;
     }
 #else
-    switch (proc) {
-    case (BILINEAR | GREY8):
-        bilinear_h_grey_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (BILINEAR | RGB888):
-        bilinear_h_rgb888_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (BILINEAR | RGBA8888):
-        bilinear_h_rgba_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | GREY8):
-        reduceby2_h_grey_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | RGB888):
-        reduceby2_h_rgb888_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | RGBA8888):
-        reduceby2_h_rgba_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    default:
-        break;
+    (void)pages;
+    (void)node_local;
+#endif
+    return aligned_malloc(size, alignment);
+}
+
+
+void ResizeHalf::PageAllocator::deallocate(void* p, const size_t size) noexcept
+{
+#if defined(__linux__)
+    if (size >= huge_page_size) {
+        munmap(p, (size + huge_page_size - 1) & ~(huge_page_size - 1));
+        return;
     }
 #endif
+    aligned_free(p);
+}
+
+
+// State of beginRows()/pushRows().
+struct ResizeHalf::RowStream {
+    std::function<void(const uint8_t*, size_t)> on_row;
+    Proc func;          // for the rows in window.
+    std::shared_ptr<Allocator> allocator;   // of row.
+    uint8_t* row;       // an output row, followed by window.
+    uint8_t* window;    // the rows [lo, lo + cnt) of the source.
+    size_t size;        // of row.
+    size_t src_width;
+    size_t src_height;
+    size_t wstride;
+    size_t lo;
+    size_t cnt;
+    size_t y;           // next output row.
+
+    RowStream() : row(nullptr), window(nullptr), size(0) {}
+    ~RowStream() { release(); }
+
+    void release() noexcept
+    {
+        if (row) {
+            allocator->deallocate(row, size);
+        }
+        row = window = nullptr;
+    }
+};
+
 
-    copyToDst(dstp, ds);
+ResizeHalf::ResizeHalf(const FMT fmt, const MODE m) :
+    align(16 - 1), simd(SIMD_NONE), format(fmt), mode(m), conv(CONV_NONE), store(STORE_AUTO),
+    image(nullptr),
+    buffsize(0), allocator(default_allocator()), width(0), height(0), stride(0), threads(1), tile_width(0),
+    row_stream(nullptr)
+{
+    setSimd(getSupportedSimd());
 }
 
 
-void ResizeHalf::resizeVertical(
-    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
-    const size_t ds, const size_t ss)
+ResizeHalf::~ResizeHalf()
 {
-    auto sstride = prepare(srcp, sw, sh, ss, ds, PROC_V);
-    int proc = getFlag(srcp, sstride);
+    releaseBuffer();
+}
 
-#if defined(__SSE2__)
-    switch (proc) {
-    case (ALIGNED_IMAGE | BILINEAR | GREY8):
-        bilinear_v_grey<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | BILINEAR | RGBA8888):
-        bilinear_v_rgba<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | REDUCE_BY_2 | GREY8):
-        reduceby2_v_grey<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (ALIGNED_IMAGE | REDUCE_BY_2 | RGBA8888):
-        reduceby2_v_rgba<true>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | GREY8):
-        bilinear_v_grey<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | RGB888):
-        bilinear_v_rgb888(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | BILINEAR | RGBA8888):
-        bilinear_v_rgba<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | GREY8):
-        reduceby2_v_grey<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | RGB888):
-        reduceby2_v_rgb888(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (UNALIGNED_IMAGE | REDUCE_BY_2 | RGBA8888):
-        reduceby2_v_rgba<false>(srcp, image, sw, sh, sstride, stride);
-        break;
-    default:
-        break;
-    }
-#else
-    switch (proc) {
-    case (BILINEAR | GREY8):
-        bilinear_v_grey_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (BILINEAR | RGB888):
-        bilinear_v_rgb888_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (BILINEAR | RGBA8888):
-        bilinear_v_rgba_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | GREY8):
-        reduceby2_v_grey_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | RGB888):
-        reduceby2_v_rgb888_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    case (REDUCE_BY_2 | RGBA8888):
-        reduceby2_v_rgba_c(srcp, image, sw, sh, sstride, stride);
-        break;
-    default:
-        break;
+
+ResizeHalf::ResizeHalf(ResizeHalf&& other) noexcept :
+    align(other.align), simd(other.simd), format(other.format), mode(other.mode),
+    conv(other.conv), store(other.store), image(other.image), buffsize(other.buffsize),
+    allocator(other.allocator), width(other.width), height(other.height),
+    stride(other.stride), threads(other.threads), tile_width(other.tile_width),
+    row_stream(std::move(other.row_stream))
+{
+    other.image = nullptr;
+    other.buffsize = 0;
+}
+
+
+ResizeHalf& ResizeHalf::operator=(ResizeHalf&& other) noexcept
+{
+    if (this != &other) {
+        releaseBuffer();
+        align = other.align;
+        simd = other.simd;
+        format = other.format;
+        mode = other.mode;
+        conv = other.conv;
+        store = other.store;
+        image = other.image;
+        buffsize = other.buffsize;
+        allocator = other.allocator;
+        width = other.width;
+        height = other.height;
+        stride = other.stride;
+        threads = other.threads;
+        tile_width = other.tile_width;
+        row_stream = std::move(other.row_stream);
+        other.image = nullptr;
+        other.buffsize = 0;
     }
-#endif
+    return *this;
+}
+
+
+void ResizeHalf::setAllocator(std::shared_ptr<Allocator> a)
+{
+    releaseBuffer();
+    allocator = a ? std::move(a) : default_allocator();
+}
+
+
+void ResizeHalf::releaseBuffer() noexcept
+{
+    freeBuffer(image, buffsize);
+    image = nullptr;
+    buffsize = 0;
+    row_stream.reset();
+}
+
+
+void ResizeHalf::setFormat(const FMT f) noexcept
+{
+    format = f;
+}
+
+
+void ResizeHalf::setProcMode(const MODE m) noexcept
+{
+    mode = m;
+}
 
-    copyToDst(dstp, ds);
+
+void ResizeHalf::setStorePolicy(const STORE s) noexcept
+{
+    store = s;
+}
+
+
+void ResizeHalf::setTileWidth(const size_t w) noexcept
+{
+    tile_width = w;
 }
 
+
+void ResizeHalf::setConversion(const CONV c) noexcept
+{
+    conv = c;
+}
+
+
+void ResizeHalf::setSimd(const SIMD s) noexcept
+{
+    simd = std::min(s, getSupportedSimd());
+    size_t a = simd >= SIMD_AVX512 ? 64 - 1
+        : simd >= SIMD_AVX2 ? 32 - 1 : 16 - 1;
+    if (a > align && image) {
+        // the current buffer may not be aligned enough.
+        freeBuffer(image, buffsize);
+        image = nullptr;
+        buffsize = 0;
+    }
+    align = a;
+}
+
+
+void ResizeHalf::setThreads(const size_t n) noexcept
+{
+    threads = n != 0 ? n : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+
+void ResizeHalf::alloc(const size_t size)
+{
+    freeBuffer(image, buffsize);
+    buffsize = 0;
+    image = allocBuffer(size);
+    if (!image) {
+        throw std::runtime_error("failed to allocate buffer.");
+    }
+    buffsize = size;
+}
+
+
+uint8_t* ResizeHalf::allocBuffer(const size_t size) const noexcept
+{
+    return static_cast<uint8_t*>(allocator->allocate(size, align + 1));
+}
+
+
+void ResizeHalf::freeBuffer(void* p, const size_t size) const noexcept
+{
+    if (p) {
+        allocator->deallocate(p, size);
+    }
+}
+
+
+static inline size_t default_stride(const size_t width, const size_t bpp)
+{
+    // Windows Bitmap standard.
+    return (width * bpp + 3) & ~static_cast<size_t>(3);
+}
+
+
+static inline size_t abs_stride(const ptrdiff_t stride)
+{
+    return static_cast<size_t>(stride < 0 ? -stride : stride);
+}
+
+
+// Returns the error message if the arguments of a reduction are invalid.
+static const char*
+check_args(const uint8_t* srcp, const size_t sw, const size_t sh, const ptrdiff_t ss,
+           const ptrdiff_t ds, const size_t bpp, const size_t dbpp, const int pt,
+           const int times) noexcept
+{
+    // every level reduced must be 16x16 or larger.
+    if ((sw >> (times - 1)) < 16 || (sh >> (times - 1)) < 16) {
+        return "source image is too small.";
+    }
+    if (!srcp) {
+        return "null pointer exception.";
+    }
+    if (ss != 0 && abs_stride(ss) < sw * bpp) {
+        return "inavlid src_stride was specified.";
+    }
+    size_t w = pt == PROC_V ? sw : sw >> times;
+    if (ds != 0 && abs_stride(ds) < w * dbpp) {
+        return "invalid dst_stride was specified.";
+    }
+    return nullptr;
+}
+
+
+ptrdiff_t ResizeHalf::
+prepare(const uint8_t* srcp, const size_t sw, const size_t sh, const ptrdiff_t ss,
+        const ptrdiff_t ds, int pt, const int times)
+{
+    auto error = check_args(srcp, sw, sh, ss, ds, bytesPerPixel(), outBytesPerPixel(),
+                            pt, times);
+    if (error) {
+        throw std::runtime_error(error);
+    }
+
+    width = pt == PROC_V ? sw : sw >> times;
+    height = pt == PROC_H ? sh : sh >> times;
+    stride = conv == CONV_NONE ? paddedStride(width)
+        : (width * outBytesPerPixel() + align) & ~align;
+
+    return ss == 0 ? static_cast<ptrdiff_t>(default_stride(sw, bytesPerPixel())) : ss;
+}
+
+
+uint8_t* ResizeHalf::setDst(uint8_t* dstp, ptrdiff_t& ds)
+{
+    if (dstp) {
+        if (ds == 0) {
+            ds = static_cast<ptrdiff_t>(default_stride(width, outBytesPerPixel()));
+        }
+        // SIMD kernels store aligned vectors. The bytes after a row may be
+        // written before the next row is made. Conversions store no more
+        // than rowsize.
+        if (simd == SIMD_NONE || conv != CONV_NONE
+                || (abs_stride(ds) >= width * bytesPerPixel()
+                && ((reinterpret_cast<uintptr_t>(dstp) | static_cast<uintptr_t>(ds))
+                    & align) == 0)) {
+            return dstp;
+        }
+    }
+
+    if (height * stride > buffsize) {
+        alloc(height * stride);
+    }
+    ds = static_cast<ptrdiff_t>(stride);
+    return image;
+}
+
+
+static void
+copy_rows(uint8_t* dstp, const ptrdiff_t ds, const uint8_t* srcp, const ptrdiff_t ss,
+          const size_t rowsize, const size_t height) noexcept
+{
+    if (static_cast<ptrdiff_t>(rowsize) == ds && ds == ss) {
+        std::memcpy(dstp, srcp, rowsize * height);
+    } else {
+        for (size_t y = 0; y < height; ++y) {
+            std::memcpy(dstp, srcp, rowsize);
+            srcp += ss;
+            dstp += ds;
+        }
+    }
+}
+
+
+void ResizeHalf::copyToDst(uint8_t* dstp, const ptrdiff_t ds) noexcept
+{
+    if (!dstp) {
+        return;
+    }
+
+    auto dstride = ds == 0
+        ? static_cast<ptrdiff_t>(default_stride(width, outBytesPerPixel())) : ds;
+    copy_rows(dstp, dstride, image, static_cast<ptrdiff_t>(stride),
+              width * outBytesPerPixel(), height);
+}
+
+
+// Stride of the buffers made here. Kernels of RGB888 may store a whole
+// vector beyond the end of each row.
+size_t ResizeHalf::paddedStride(const size_t w) const noexcept
+{
+    size_t f = format == RGB888 ? 4 : bytesPerPixel();
+    return (w * f + align) & ~align;
+}
+
+
+size_t ResizeHalf::outBytesPerPixel() const noexcept
+{
+    return conv == CONV_RGBA ? 4 : conv == CONV_GREY ? 1 : bytesPerPixel();
+}
+
+
+// Returns CACHED_STORE if the processed image of bytes is not to be streamed.
+int ResizeHalf::storeFlag(const size_t bytes) const noexcept
+{
+    if (store == STORE_AUTO) {
+        return bytes > getCacheSize() / 2 ? 0 : CACHED_STORE;
+    }
+    return store == STORE_CACHED ? CACHED_STORE : 0;
+}
+
+
+int ResizeHalf::getFlag(const void* ptr, ptrdiff_t bytes) const noexcept
+{
+    int flag = (mode | format);
+    if (simd != SIMD_NONE && format != RGB888 && format != RGB48 && format != RGBF32
+            && ((reinterpret_cast<uintptr_t>(ptr) | static_cast<uintptr_t>(bytes))
+                & align) == 0) {
+        flag |= ALIGNED_IMAGE;
+    }
+    return flag;
+}
+
+
+// Returns the number of source rows the kernel is given for the output rows
+// [y0, y1) of oh rows, from the row sy. They are the rows it reads for them on
+// the whole image: reduce-by-2 needs one more row below, and the last rows keep
+// the parity of sh for the even height handling. So the result does not depend
+// on how the rows are split.
+static size_t src_rows(const int mode, const int pt, const size_t sh, const size_t oh,
+                       const size_t y0, const size_t y1, size_t& sy) noexcept
+{
+    sy = pt == PROC_H ? y0 : 2 * y0;
+    return y1 == oh ? sh - sy
+        : pt == PROC_H ? y1 - y0
+        : 2 * (y1 - y0) + (mode & ResizeHalf::REDUCE_BY_2 ? 1 : 0);
+}
+
+
+// Processes the output rows [y0, y1) of oh rows.
+static void proc_rows(
+    const Proc& func, const int mode, const int pt, const uint8_t* srcp,
+    uint8_t* dstp, const size_t sw, const size_t sh, const ptrdiff_t ss,
+    const ptrdiff_t ds, const size_t oh, const size_t y0, const size_t y1) noexcept
+{
+    size_t sy;
+    size_t h = src_rows(mode, pt, sh, oh, y0, y1, sy);
+    func(srcp + row_offset(sy, ss), dstp + row_offset(y0, ds), sw, h, ss, ds);
+}
+
+
+// TILE_AUTO tiles the images of which 3 source rows do not fit in L2 cache
+// comfortably, by strips of 3 source rows of about tile_strip_size bytes.
+constexpr size_t tile_min_rows_size = 512 << 10;
+constexpr size_t tile_strip_size = 128 << 10;
+
+constexpr size_t ResizeHalf::TILE_AUTO;
+
+
+// Returns the output columns of each strip for setTileWidth(), or 0 to
+// process whole rows. Strips start at multiples of 64 pixels, so they are
+// aligned as the whole rows.
+static size_t tile_columns(const size_t tile_width, const int pt, const size_t sw,
+                           const size_t bpp) noexcept
+{
+    const size_t ow = pt == PROC_V ? sw : sw / 2;
+    size_t tile = tile_width;
+    if (tile == ResizeHalf::TILE_AUTO) {
+        if (3 * sw * bpp <= tile_min_rows_size) {
+            return 0;
+        }
+        tile = tile_strip_size / (3 * bpp * (pt == PROC_V ? 1 : 2));
+    }
+    tile = (tile + 63) & ~static_cast<size_t>(63);
+    return tile >= ow ? 0 : tile;
+}
+
+
+// Processes the output rows [y0, y1) in vertical strips of tile output columns
+// from left to right. A strip is given one more source column at the right for
+// reduce-by-2, as proc_rows() gives rows. Vectors stored after the end of a
+// strip are made again by the next one, and the last one is tight. The last
+// strip takes the columns after it if they are fewer than 16 source pixels.
+static void proc_tiles(
+    const Proc& func, const int mode, const int pt, const uint8_t* srcp,
+    uint8_t* dstp, const size_t sw, const size_t sh, const ptrdiff_t ss,
+    const ptrdiff_t ds, const size_t oh, const size_t y0, const size_t y1,
+    const size_t tile) noexcept
+{
+    const size_t ow = pt == PROC_V ? sw : sw / 2;
+    size_t sy;
+    size_t h = src_rows(mode, pt, sh, oh, y0, y1, sy);
+    for (size_t x0 = 0; x0 < ow; x0 += tile) {
+        const size_t next = pt == PROC_V ? x0 + tile : 2 * (x0 + tile);
+        const bool last = x0 + tile >= ow || sw - next < 16;
+        const size_t sx = pt == PROC_V ? x0 : 2 * x0;
+        const size_t w = last ? sw - sx : pt == PROC_V ? tile
+            : 2 * tile + (mode & ResizeHalf::REDUCE_BY_2 ? 1 : 0);
+        const bool tight = last && (ds < 0 || abs_stride(ds) < ow * func.bpp + func.margin);
+        func(srcp + row_offset(sy, ss) + sx * func.bpp,
+             dstp + row_offset(y0, ds) + x0 * func.bpp, w, h, ss, ds, tight);
+        if (last) {
+            break;
+        }
+    }
+}
+
+
+// Calls proc(i) for each i in [0, n) on its own thread. The calling thread
+// takes 0. If a thread cannot be created, the rest are called here.
+template <typename F>
+static void run_threads(const size_t n, F proc)
+{
+    auto proc_one = [&](const size_t i) {
+        proc(i);
+#if defined(__SSE2__)
+        // make streamed data visible to the joining thread.
+        _mm_sfence();
+#endif
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(n - 1);
+    size_t i = 1;
+    try {
+        for (; i < n; ++i) {
+            workers.emplace_back(proc_one, i);
+        }
+    } catch (const std::system_error&) {
+        for (; i < n; ++i) {
+            proc_one(i);
+        }
+    }
+    proc_one(0);
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+
+// Calls proc(y0, y1) for bands of the output rows [0, oh) on up to threads
+// threads.
+template <typename F>
+static void run_bands(const size_t threads, const size_t oh, F proc)
+{
+    // Smaller bands are not worth a thread.
+    constexpr size_t min_band_rows = 16;
+
+    const size_t bands = std::min(threads, std::max<size_t>(oh / min_band_rows, 1));
+    if (bands == 1) {
+        proc(0, oh);
+        return;
+    }
+    run_threads(bands, [&](const size_t i) {
+        proc(oh * i / bands, oh * (i + 1) / bands);
+    });
+}
+
+
+void ResizeHalf::process(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss, const int pt)
+{
+    if (conv != CONV_NONE || dstp == srcp) {
+        processBlocks(dstp, srcp, sw, sh, ds, ss, pt);
+        return;
+    }
+
+    auto sstride = prepare(srcp, sw, sh, ss, ds, pt);
+    ptrdiff_t dstride = ds;
+    uint8_t* d = setDst(dstp, dstride);
+
+    // the buffer is copied to dstp soon.
+    int flag = getFlag(srcp, sstride);
+    flag |= d == image && dstp ? CACHED_STORE : storeFlag(height * getRowsize());
+    auto func = get_proc(simd, pt, flag);
+    if (!func) {
+        throw std::runtime_error("unsupported format or mode.");
+    }
+
+    const size_t tile = tile_columns(tile_width, pt, sw, bytesPerPixel());
+    run_bands(threads, height, [&](const size_t y0, const size_t y1) {
+        if (tile == 0) {
+            proc_rows(func, mode, pt, srcp, d, sw, sh, sstride, dstride, height, y0, y1);
+        } else {
+            proc_tiles(func, mode, pt, srcp, d, sw, sh, sstride, dstride, height, y0, y1,
+                       tile);
+        }
+    });
+
+    if (d == image) {
+        copyToDst(dstp, ds);
+    }
+}
+
+
+// Picks the kernel of a conversion from the source format.
+static proc_func_t get_convert(const int simd, const int conv, const int format) noexcept
+{
+    const bool rgb = format == ResizeHalf::RGB888;
+    if (!rgb && format != ResizeHalf::RGBA8888) {
+        return nullptr;
+    }
+#if defined(__SSE2__)
+    if (simd >= ResizeHalf::SIMD_SSE) {
+        switch (conv) {
+#if defined(__SSSE3__)
+        case ResizeHalf::CONV_RGBA:
+            return rgb ? convert_rgb888_to_rgba : nullptr;
+        case ResizeHalf::CONV_GREY:
+            return rgb ? convert_rgb888_to_grey : convert_rgba_to_grey;
+        case ResizeHalf::CONV_SWAP_RB:
+            return rgb ? convert_swap_rb_rgb888 : convert_swap_rb_rgba;
+#else
+        case ResizeHalf::CONV_GREY:
+            return rgb ? convert_to_grey_c<3> : convert_rgba_to_grey;
+        case ResizeHalf::CONV_SWAP_RB:
+            return rgb ? convert_swap_rb_c<3> : convert_swap_rb_rgba;
+#endif
+        default:
+            break;
+        }
+    }
+#else
+    (void)simd;
+#endif
+    switch (conv) {
+    case ResizeHalf::CONV_RGBA:
+        return rgb ? convert_rgb888_to_rgba_c : nullptr;
+    case ResizeHalf::CONV_GREY:
+        return rgb ? convert_to_grey_c<3> : convert_to_grey_c<4>;
+    case ResizeHalf::CONV_SWAP_RB:
+        return rgb ? convert_swap_rb_c<3> : convert_swap_rb_c<4>;
+    default:
+        return nullptr;
+    }
+}
+
+
+// Bytes of the rows made at a time by processBlocks(). They are converted
+// while they are in L1 cache.
+constexpr size_t conv_block_size = 16 << 10;
+
+
+// process() with a conversion or in place. The rows are reduced in the source
+// format into a small buffer of each band, and converted or copied from it to
+// dstp. In place, the rows are processed in order on one thread: the output
+// rows of a block are written after their source rows were read, and before
+// the source rows of the next block as dst_stride is not larger than
+// src_stride, and of the same sign.
+void ResizeHalf::processBlocks(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss, const int pt)
+{
+    auto sstride = prepare(srcp, sw, sh, ss, ds, pt);
+    proc_func_t convert = nullptr;
+    if (conv != CONV_NONE) {
+        convert = get_convert(simd, conv, format);
+        if (!convert) {
+            throw std::runtime_error("unsupported format or conversion.");
+        }
+    }
+    // the buffer is read soon.
+    auto func = get_proc(simd, pt, getFlag(srcp, sstride) | CACHED_STORE);
+    if (!func) {
+        throw std::runtime_error("unsupported format or mode.");
+    }
+
+    const bool in_place = dstp == srcp;
+    ptrdiff_t dstride = ds;
+    uint8_t* d = dstp;
+    if (!in_place) {
+        d = setDst(dstp, dstride);
+    } else {
+        if (dstride == 0) {
+            dstride = static_cast<ptrdiff_t>(default_stride(width, outBytesPerPixel()));
+        }
+        if ((dstride < 0) != (sstride < 0) || abs_stride(dstride) > abs_stride(sstride)) {
+            throw std::runtime_error("dst_stride is larger than src_stride in place.");
+        }
+    }
+
+    const size_t bs = paddedStride(width);
+    const size_t batch = std::max<size_t>(conv_block_size / bs, 1);
+
+    std::atomic<bool> failed(false);
+    run_bands(in_place ? 1 : threads, height, [&](const size_t y0, const size_t y1) {
+        uint8_t* buf = allocBuffer(batch * bs);
+        if (!buf) {
+            failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+        for (size_t y = y0; y < y1; y += batch) {
+            auto ye = std::min(y + batch, y1);
+            size_t sy;
+            size_t h = src_rows(mode, pt, sh, height, y, ye, sy);
+            func(srcp + row_offset(sy, sstride), buf, sw, h, sstride, bs);
+            if (convert) {
+                convert(buf, d + row_offset(y, dstride), width, ye - y, bs, dstride);
+            } else {
+                copy_rows(d + row_offset(y, dstride), dstride, buf, bs, getRowsize(),
+                          ye - y);
+            }
+        }
+        freeBuffer(buf, batch * bs);
+    });
+    if (failed) {
+        throw std::runtime_error("failed to allocate buffer.");
+    }
+
+    if (d == image) {
+        copyToDst(dstp, ds);
+    }
+}
+
+
+// Throws if a conversion is set, for the functions which do not support it.
+void ResizeHalf::noConversion() const
+{
+    if (conv != CONV_NONE) {
+        throw std::runtime_error("conversion is not supported by this function.");
+    }
+}
+
+
+std::vector<ResizeHalf::Level> ResizeHalf::
+getPyramidLayout(const size_t sw, const size_t sh, const size_t min_size) const
+{
+    std::vector<Level> levels;
+    size_t w = sw, h = sh, offset = 0;
+    while (w >= 16 && h >= 16 && w / 2 >= min_size && h / 2 >= min_size) {
+        w /= 2;
+        h /= 2;
+        size_t s = paddedStride(w);
+        levels.push_back(Level{w, h, s, offset});
+        offset += s * h;
+    }
+    return levels;
+}
+
+
+std::vector<ResizeHalf::Level> ResizeHalf::
+buildPyramid(uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+             const ptrdiff_t ss, const size_t min_size)
+{
+    noConversion();
+    auto sstride = prepare(srcp, sw, sh, ss, 0, PROC_HV);
+    auto levels = getPyramidLayout(sw, sh, min_size);
+    if (levels.empty()) {
+        return levels;
+    }
+    const size_t n = levels.size();
+    const size_t total = levels[n - 1].offset + levels[n - 1].stride * levels[n - 1].height;
+
+    if (!dstp) {
+        if (total > buffsize) {
+            alloc(total);
+        }
+        dstp = image;
+    } else if ((reinterpret_cast<uintptr_t>(dstp) & align) != 0) {
+        throw std::runtime_error("dstp is not aligned enough.");
+    }
+
+    // source of each level.
+    std::vector<const uint8_t*> sp(n);
+    std::vector<size_t> sws(n), shs(n);
+    std::vector<ptrdiff_t> sss(n);
+    std::vector<Proc> funcs(n);
+    for (size_t k = 0; k < n; ++k) {
+        sp[k] = k == 0 ? srcp : dstp + levels[k - 1].offset;
+        sws[k] = k == 0 ? sw : levels[k - 1].width;
+        shs[k] = k == 0 ? sh : levels[k - 1].height;
+        sss[k] = k == 0 ? sstride : static_cast<ptrdiff_t>(levels[k - 1].stride);
+        funcs[k] = get_proc(simd, PROC_HV, getFlag(sp[k], sss[k]) | storeFlag(total));
+        if (!funcs[k]) {
+            throw std::runtime_error("unsupported format or mode.");
+        }
+    }
+
+    if (threads > 1) {
+        for (size_t k = 0; k < n; ++k) {
+            const size_t oh = levels[k].height;
+            run_bands(threads, oh, [&](const size_t y0, const size_t y1) {
+                proc_rows(funcs[k], mode, PROC_HV, sp[k], dstp + levels[k].offset,
+                          sws[k], shs[k], sss[k], levels[k].stride, oh, y0, y1);
+            });
+        }
+        return levels;
+    }
+
+    // Make a few rows of the first level at a time, and then all rows of the
+    // following levels which can be made from the rows made so far. All levels
+    // are finished in the pass that finishes the first one.
+    const size_t chunk = std::max<size_t>((256 << 10) / (2 * abs_stride(sstride)), 1);
+    std::vector<size_t> done(n, 0);
+    while (done[0] < levels[0].height) {
+        for (size_t k = 0; k < n; ++k) {
+            const size_t oh = levels[k].height;
+            const size_t avail = k == 0 ? shs[k] : done[k - 1];
+            size_t y1 = oh;
+            if (avail < shs[k]) {
+                // output row y needs source rows 2y, 2y+1 (and 2y+2 for reduce-by-2),
+                // and the last one needs the rest of the source.
+                y1 = mode & REDUCE_BY_2 ? (avail > 0 ? (avail - 1) / 2 : 0) : avail / 2;
+                y1 = std::min(y1, oh - 1);
+            }
+            if (k == 0) {
+                y1 = std::min(y1, done[0] + chunk);
+            }
+            y1 = std::min(y1, oh);
+            if (y1 <= done[k]) {
+                continue;
+            }
+            proc_rows(funcs[k], mode, PROC_HV, sp[k], dstp + levels[k].offset,
+                      sws[k], shs[k], sss[k], levels[k].stride, oh, done[k], y1);
+            done[k] = y1;
+        }
+    }
+
+    return levels;
+}
+
+
+namespace {
+
+// A level of the cascade made by ResizeHalf::cascade(). Level 0 is the source
+// image, and only the rows [lo, lo + cnt) of the other levels are kept in buf.
+struct CascadeLevel {
+    Proc func;              // makes this level from the previous one.
+    const uint8_t* srcp;
+    uint8_t* buf;
+    size_t width;
+    size_t height;
+    ptrdiff_t stride;       // negative only for a bottom-up source.
+    size_t lo;
+    size_t cnt;
+};
+
+} // namespace
+
+
+static const uint8_t*
+fetch_rows(CascadeLevel* lv, const size_t k, const size_t r0, const size_t r1,
+           const size_t extra) noexcept;
+
+
+// Makes the rows [y0, y1) of level k from level k - 1 in the same way as
+// proc_rows(), so the result is the same as reducing each level entirely.
+static void
+make_rows(CascadeLevel* lv, const size_t k, const size_t y0, const size_t y1,
+          uint8_t* dstp, const ptrdiff_t ds, const size_t extra) noexcept
+{
+    const auto& prev = lv[k - 1];
+    size_t sy0 = 2 * y0;
+    size_t sy1 = y1 == lv[k].height ? prev.height : 2 * y1 + extra;
+    auto s = fetch_rows(lv, k - 1, sy0, sy1, extra);
+    lv[k].func(s, dstp, prev.width, sy1 - sy0, prev.stride, ds);
+}
+
+
+// Returns the address of the row r0 of level k after making the rows [r0, r1)
+// available. Rows are requested in increasing order, and the rows kept from the
+// last request are moved to the top of the window instead of being made again.
+static const uint8_t*
+fetch_rows(CascadeLevel* lv, const size_t k, const size_t r0, const size_t r1,
+           const size_t extra) noexcept
+{
+    auto& l = lv[k];
+    if (k == 0) {
+        return l.srcp + row_offset(r0, l.stride);
+    }
+
+    size_t have = 0;
+    if (r0 < l.lo + l.cnt) {
+        have = std::min(l.lo + l.cnt - r0, r1 - r0);
+        if (r0 > l.lo) {
+            std::memmove(l.buf, l.buf + row_offset(r0 - l.lo, l.stride),
+                         have * abs_stride(l.stride));
+        }
+    }
+    l.lo = r0;
+    l.cnt = r1 - r0;
+    if (r0 + have < r1) {
+        make_rows(lv, k, r0 + have, r1, l.buf + row_offset(have, l.stride), l.stride, extra);
+    }
+    return l.buf;
+}
+
+
+void ResizeHalf::cascade(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss, const int times)
+{
+    noConversion();
+    auto sstride = prepare(srcp, sw, sh, ss, ds, PROC_HV, times);
+    const size_t n = static_cast<size_t>(times);
+    const size_t extra = mode & REDUCE_BY_2 ? 1 : 0;
+
+    ptrdiff_t dstride = ds;
+    uint8_t* d = setDst(dstp, dstride);
+    const int last_store = d == image && dstp ? CACHED_STORE : storeFlag(height * getRowsize());
+
+    std::vector<CascadeLevel> levels(n + 1);
+    levels[0] = CascadeLevel{Proc(), srcp, nullptr, sw, sh, sstride, 0, 0};
+    for (size_t k = 1; k <= n; ++k) {
+        auto& l = levels[k];
+        const auto& prev = levels[k - 1];
+        l.width = prev.width / 2;
+        l.height = prev.height / 2;
+        l.stride = paddedStride(l.width);
+        // windows are allocated aligned, so only the source may be unaligned.
+        // They are read soon after being made, so they are not streamed to.
+        int flag = getFlag(k == 1 ? srcp : nullptr, prev.stride);
+        l.func = get_proc(simd, PROC_HV, flag | (k < n ? CACHED_STORE : last_store));
+        if (!l.func) {
+            throw std::runtime_error("unsupported format or mode.");
+        }
+    }
+
+    // Rows of the last level made at a time. The window of the first
+    // intermediate level is about 128KiB, and the others are smaller.
+    const size_t batch = std::max<size_t>(
+        (128 << 10) / (levels[1].stride << (n - 1)), 1);
+    std::vector<size_t> caps(n, 0);
+    size_t window_size = 0;
+    for (size_t k = n - 1; k > 0; --k) {
+        caps[k] = k == n - 1 ? 2 * batch + 1 : 2 * caps[k + 1] + 1;
+        window_size += caps[k] * levels[k].stride;
+    }
+
+    std::atomic<bool> failed(false);
+    run_bands(threads, height, [&](const size_t y0, const size_t y1) {
+        auto lv = levels;
+        uint8_t* window = allocBuffer(window_size);
+        if (!window) {
+            failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+        uint8_t* p = window;
+        for (size_t k = 1; k < n; ++k) {
+            lv[k].buf = p;
+            p += caps[k] * lv[k].stride;
+        }
+        for (size_t y = y0; y < y1; y += batch) {
+            auto ye = std::min(y + batch, y1);
+            make_rows(lv.data(), n, y, ye, d + row_offset(y, dstride), dstride, extra);
+        }
+        freeBuffer(window, window_size);
+    });
+    if (failed) {
+        throw std::runtime_error("failed to allocate buffer.");
+    }
+
+    if (d == image) {
+        copyToDst(dstp, ds);
+    }
+}
+
+
+void ResizeHalf::
+beginRows(const size_t sw, const size_t sh,
+          std::function<void(const uint8_t* row, size_t y)> on_row)
+{
+    noConversion();
+    if (sw < 16 || sh < 16) {
+        throw std::runtime_error("source image is too small.");
+    }
+    if (!on_row) {
+        throw std::runtime_error("null pointer exception.");
+    }
+
+    width = sw / 2;
+    height = sh / 2;
+    stride = paddedStride(width);
+
+    if (!row_stream) {
+        row_stream.reset(new RowStream());
+    }
+    auto& rs = *row_stream;
+    rs.release();
+    rs.wstride = (sw * bytesPerPixel() + align) & ~align;
+    rs.allocator = allocator;
+    rs.size = stride + 3 * rs.wstride;
+    rs.row = allocBuffer(rs.size);
+    if (!rs.row) {
+        throw std::runtime_error("failed to allocate buffer.");
+    }
+    rs.window = rs.row + stride;
+    // output rows are read by on_row soon.
+    rs.func = get_proc(simd, PROC_HV, getFlag(rs.window, rs.wstride) | CACHED_STORE);
+    if (!rs.func) {
+        throw std::runtime_error("unsupported format or mode.");
+    }
+    rs.on_row = std::move(on_row);
+    rs.src_width = sw;
+    rs.src_height = sh;
+    rs.lo = rs.cnt = rs.y = 0;
+}
+
+
+void ResizeHalf::pushRows(const uint8_t* srcp, size_t count, const ptrdiff_t ss)
+{
+    if (!row_stream || !row_stream->window) {
+        throw std::runtime_error("beginRows() was not called.");
+    }
+    auto& rs = *row_stream;
+    if (count == 0) {
+        return;
+    }
+    if (!srcp) {
+        throw std::runtime_error("null pointer exception.");
+    }
+    const size_t rowsize = rs.src_width * bytesPerPixel();
+    const ptrdiff_t sstride = ss == 0
+        ? static_cast<ptrdiff_t>(default_stride(rs.src_width, bytesPerPixel())) : ss;
+    if (count > 1 && abs_stride(sstride) < rowsize) {
+        throw std::runtime_error("inavlid src_stride was specified.");
+    }
+    if (rs.lo + rs.cnt + count > rs.src_height) {
+        throw std::runtime_error("too many rows were pushed.");
+    }
+
+    auto func = get_proc(simd, PROC_HV, getFlag(srcp, sstride) | CACHED_STORE);
+    const size_t extra = mode & REDUCE_BY_2 ? 1 : 0;
+    size_t taken = 0;   // rows in window copied from srcp.
+
+    while (count > 0) {
+        // output row y needs the source rows [2y, 2y + 2 + extra), and the
+        // last one needs the rest of the source as proc_rows() gives.
+        const bool last = rs.y + 1 == height;
+        const size_t n = last ? rs.src_height - 2 * rs.y : 2 + extra;
+
+        if (rs.cnt == 0 && count >= n) {
+            func(srcp, rs.row, rs.src_width, n, sstride, stride);
+            rs.on_row(rs.row, rs.y++);
+            const size_t used = last ? n : 2;
+            srcp += row_offset(used, sstride);
+            count -= used;
+            rs.lo += used;
+            continue;
+        }
+
+        std::memcpy(rs.window + rs.cnt * rs.wstride, srcp, rowsize);
+        srcp += sstride;
+        --count;
+        ++taken;
+        if (++rs.cnt < n) {
+            continue;
+        }
+        rs.func(rs.window, rs.row, rs.src_width, n, rs.wstride, stride);
+        rs.on_row(rs.row, rs.y++);
+        const size_t keep = last ? 0 : n - 2;
+        rs.lo += n - keep;
+        rs.cnt = keep;
+        taken = std::min(taken, keep);
+        if (keep > 0 && keep == taken) {
+            // the rows kept are still in srcp, use them in place.
+            srcp -= row_offset(keep, sstride);
+            count += keep;
+            rs.cnt = taken = 0;
+        } else if (keep > 0) {
+            std::memmove(rs.window, rs.window + (n - keep) * rs.wstride,
+                         keep * rs.wstride);
+        }
+    }
+}
+
+
+size_t ResizeHalf::getPushedRows() const noexcept
+{
+    return row_stream ? row_stream->lo + row_stream->cnt : 0;
+}
+
+
+size_t ResizeHalf::resizeBatch(BatchItem* items, const size_t count)
+{
+    noConversion();
+    std::vector<size_t> order;
+    order.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto& it = items[i];
+        it.error = check_args(it.srcp, it.src_width, it.src_height, it.src_stride,
+                              it.dst_stride, bytesPerPixel(), bytesPerPixel(),
+                              PROC_HV, 1);
+        if (!it.error && !it.dstp) {
+            it.error = "null pointer exception.";
+        }
+        if (!it.error) {
+            order.push_back(i);
+        }
+    }
+    // larger images first, so the threads finish at nearly the same time.
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return items[a].src_width * items[a].src_height
+            > items[b].src_width * items[b].src_height;
+    });
+
+    const size_t n = order.size();
+    std::atomic<size_t> next(0);
+
+    auto worker = [&](const size_t) {
+        uint8_t* buff = nullptr;
+        size_t size = 0;
+        for (size_t j = next++; j < n; j = next++) {
+            auto& it = items[order[j]];
+            const ptrdiff_t ss = it.src_stride == 0
+                ? static_cast<ptrdiff_t>(default_stride(it.src_width, bytesPerPixel()))
+                : it.src_stride;
+            const size_t w = it.src_width / 2, h = it.src_height / 2;
+            const ptrdiff_t ds = it.dst_stride == 0
+                ? static_cast<ptrdiff_t>(default_stride(w, bytesPerPixel())) : it.dst_stride;
+            const size_t bs = paddedStride(w);
+
+            bool direct = simd == SIMD_NONE || (abs_stride(ds) >= w * bytesPerPixel()
+                && ((reinterpret_cast<uintptr_t>(it.dstp) | static_cast<uintptr_t>(ds))
+                    & align) == 0);
+            if (!direct && bs * h > size) {
+                freeBuffer(buff, size);
+                buff = allocBuffer(bs * h);
+                size = buff ? bs * h : 0;
+                if (!buff) {
+                    it.error = "failed to allocate buffer.";
+                    continue;
+                }
+            }
+            // the buffer is copied to dstp soon.
+            int flag = getFlag(it.srcp, ss);
+            flag |= direct ? storeFlag(h * w * bytesPerPixel()) : CACHED_STORE;
+            auto func = get_proc(simd, PROC_HV, flag);
+            if (!func) {
+                it.error = "unsupported format or mode.";
+                continue;
+            }
+            if (direct) {
+                func(it.srcp, it.dstp, it.src_width, it.src_height, ss, ds);
+            } else {
+                func(it.srcp, buff, it.src_width, it.src_height, ss, bs);
+                copy_rows(it.dstp, ds, buff, bs, w * bytesPerPixel(), h);
+            }
+        }
+        freeBuffer(buff, size);
+    };
+
+    const size_t workers = std::min(threads, n);
+    if (workers > 1) {
+        run_threads(workers, worker);
+    } else {
+        worker(0);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        failed += items[i].error ? 1 : 0;
+    }
+    return failed;
+}
+
+
+namespace {
+
+// A plane of the image processed by ResizeHalf::resizeYUV().
+struct YUVPlane {
+    Proc func;
+    const uint8_t* srcp;
+    uint8_t* dstp;
+    uint8_t* buf;       // written to instead of dstp if not nullptr.
+    size_t width;       // of the source plane.
+    size_t height;
+    size_t bpp;
+    ptrdiff_t sstride;  // negative for a bottom-up plane.
+    ptrdiff_t dstride;
+    size_t bstride;     // of buf.
+};
+
+} // namespace
+
+
+void ResizeHalf::
+resizeYUV(const YUV layout, uint8_t* const dstp[], const uint8_t* const srcp[],
+          const size_t sw, const size_t sh, const ptrdiff_t ds[], const ptrdiff_t ss[])
+{
+    if (!dstp || !srcp) {
+        throw std::runtime_error("null pointer exception.");
+    }
+    if ((sw & 3) != 0 || (sh & 3) != 0) {
+        throw std::runtime_error("width and height of YUV 4:2:0 must be multiples of 4.");
+    }
+
+    const size_t n = layout == NV12 ? 2 : 3;
+    const size_t out_bytes = sw / 2 * (sh / 2) * 3 / 2;    // of all planes.
+    YUVPlane planes[3] = {};
+    size_t offsets[3] = {};
+    bool buffered[3] = {};
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        auto& p = planes[i];
+        p.srcp = srcp[i];
+        p.dstp = dstp[i];
+        p.width = i == 0 ? sw : sw / 2;
+        p.height = i == 0 ? sh : sh / 2;
+        p.bpp = layout == NV12 && i == 1 ? 2 : 1;
+        p.sstride = ss && ss[i] != 0 ? ss[i] : static_cast<ptrdiff_t>(p.width * p.bpp);
+        p.dstride = ds && ds[i] != 0 ? ds[i] : static_cast<ptrdiff_t>(p.width / 2 * p.bpp);
+        auto error = check_args(p.srcp, p.width, p.height, p.sstride, p.dstride,
+                                p.bpp, p.bpp, PROC_HV, 1);
+        if (!error && !p.dstp) {
+            error = "null pointer exception.";
+        }
+        if (error) {
+            throw std::runtime_error(error);
+        }
+
+        p.bstride = (p.width / 2 * p.bpp + align) & ~align;
+        bool direct = simd == SIMD_NONE || (abs_stride(p.dstride) >= p.width / 2 * p.bpp
+            && ((reinterpret_cast<uintptr_t>(p.dstp) | static_cast<uintptr_t>(p.dstride))
+                & align) == 0);
+        int flag = mode | (p.bpp == 2 ? static_cast<int>(UV88) : GREY8);
+        if (simd != SIMD_NONE && ((reinterpret_cast<uintptr_t>(p.srcp)
+                | static_cast<uintptr_t>(p.sstride)) & align) == 0) {
+            flag |= ALIGNED_IMAGE;
+        }
+        // the buffer is copied to dstp soon.
+        flag |= direct ? storeFlag(out_bytes) : CACHED_STORE;
+        p.func = get_proc(simd, PROC_HV, flag);
+        if (!p.func) {
+            throw std::runtime_error("unsupported format or mode.");
+        }
+        if (!direct) {
+            buffered[i] = true;
+            offsets[i] = total;
+            total += p.bstride * (p.height / 2);
+        }
+    }
+
+    // the planes which cannot be written to dstp directly share the buffer.
+    if (total > buffsize) {
+        alloc(total);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (buffered[i]) {
+            planes[i].buf = image + offsets[i];
+        }
+    }
+    width = sw / 2;
+    height = sh / 2;
+    stride = planes[0].bstride;
+
+    // the chroma planes are processed in the halves of the bands of Y.
+    run_bands(threads, height, [&](const size_t y0, const size_t y1) {
+        for (size_t i = 0; i < n; ++i) {
+            const auto& p = planes[i];
+            const size_t r0 = i == 0 ? y0 : y0 / 2;
+            const size_t r1 = i == 0 ? y1 : y1 / 2;
+            if (p.buf) {
+                proc_rows(p.func, mode, PROC_HV, p.srcp, p.buf, p.width, p.height,
+                          p.sstride, p.bstride, p.height / 2, r0, r1);
+                copy_rows(p.dstp + row_offset(r0, p.dstride), p.dstride,
+                          p.buf + r0 * p.bstride, p.bstride, p.width / 2 * p.bpp, r1 - r0);
+            } else {
+                proc_rows(p.func, mode, PROC_HV, p.srcp, p.dstp, p.width, p.height,
+                          p.sstride, p.dstride, p.height / 2, r0, r1);
+            }
+        }
+    });
+}
+
+
+void ResizeHalf::resizeHV(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss)
+{
+    process(dstp, srcp, sw, sh, ds, ss, PROC_HV);
+}
+
+
+void ResizeHalf::resizeHorizontal(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss)
+{
+    process(dstp, srcp, sw, sh, ds, ss, PROC_H);
+}
+
+
+void ResizeHalf::resizeVertical(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss)
+{
+    process(dstp, srcp, sw, sh, ds, ss, PROC_V);
+}
+
+
+void ResizeHalf::resizeQuarter(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss)
+{
+    cascade(dstp, srcp, sw, sh, ds, ss, 2);
+}
+
+
+void ResizeHalf::resizeEighth(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const ptrdiff_t ds, const ptrdiff_t ss)
+{
+    cascade(dstp, srcp, sw, sh, ds, ss, 3);
+}
+
+
+// Widens [p0, p1) in [0, n) to 16 or more, to the end first and then to the
+// start by even numbers. Returns the number of samples to pad before 0 when
+// n does not allow it (an odd p0 in n = 16).
+static size_t widen(size_t& p0, size_t& p1, const size_t n) noexcept
+{
+    p1 = std::max(p1, std::min(n, p0 + 16));
+    if (p1 - p0 < 16) {
+        const size_t back = (16 - (p1 - p0) + 1) & ~static_cast<size_t>(1);
+        if (back > p0) {
+            const size_t pad = back - p0;
+            p0 = 0;
+            return pad;
+        }
+        p0 -= back;
+    }
+    return 0;
+}
+
+
+void ResizeHalf::resizeROI(
+    uint8_t* dstp, const uint8_t* srcp, const size_t sw, const size_t sh,
+    const Rect& roi, const ptrdiff_t ds, const ptrdiff_t ss)
+{
+    noConversion();
+    const size_t bpp = bytesPerPixel();
+    auto error = check_args(srcp, sw, sh, ss, 0, bpp, bpp, PROC_HV, 1);
+    if (!error && (roi.width < 2 || roi.height < 2 || roi.width > sw || roi.height > sh
+            || roi.x > sw - roi.width || roi.y > sh - roi.height)) {
+        error = "invalid roi was specified.";
+    }
+    const size_t ow = roi.width / 2;
+    const size_t oh = roi.height / 2;
+    if (!error && ds != 0 && abs_stride(ds) < ow * bpp) {
+        error = "invalid dst_stride was specified.";
+    }
+    if (error) {
+        throw std::runtime_error(error);
+    }
+
+    // The region reduced is roi with the pixels after it which reduce-by-2
+    // reads, as proc_tiles() gives strips.
+    const size_t extra = mode & REDUCE_BY_2 ? 1 : 0;
+    size_t x0 = roi.x, y0 = roi.y;
+    size_t x1 = std::min(sw, x0 + 2 * ow + extra);
+    size_t y1 = std::min(sh, y0 + 2 * oh + extra);
+    const size_t px = widen(x0, x1, sw);
+    const size_t py = widen(y0, y1, sh);
+    const ptrdiff_t sstride = ss == 0 ? static_cast<ptrdiff_t>(default_stride(sw, bpp)) : ss;
+    const ptrdiff_t dstride = ds == 0 ? static_cast<ptrdiff_t>(default_stride(ow, bpp)) : ds;
+    const uint8_t* row0 = srcp + row_offset(y0, sstride);
+
+    // the result is always cropped from a padded region.
+    bool cropped = px != 0 || py != 0 || x0 != roi.x || y0 != roi.y
+        || (x1 - x0) / 2 != ow || (y1 - y0) / 2 != oh;
+    const bool unaligned_dst = dstp && simd != SIMD_NONE
+        && ((reinterpret_cast<uintptr_t>(dstp) | static_cast<uintptr_t>(dstride)) & align) != 0;
+    if (px == 0 && py == 0 && (cropped || unaligned_dst)
+            && !(getFlag(row0 + x0 * bpp, sstride) & ALIGNED_IMAGE)) {
+        // the result is copied from the intermediate buffer, so the columns
+        // from an aligned one of the same parity cost only their reduction.
+        const size_t step = std::max<size_t>((align + 1) / bpp, 1);
+        const size_t xa = x0 - x0 % step;
+        if ((x0 - xa) % 2 == 0 && (getFlag(row0 + xa * bpp, sstride) & ALIGNED_IMAGE)) {
+            cropped = cropped || xa != x0;
+            x0 = xa;
+        }
+    }
+
+    if (!cropped) {
+        process(dstp, row0 + x0 * bpp, x1 - x0, y1 - y0, ds, sstride, PROC_HV);
+        return;
+    }
+
+    if (px != 0 || py != 0) {
+        // the region is placed after blank samples in a copy. No output pixel
+        // of roi reads the samples before it.
+        const size_t tw = px + x1 - x0, th = py + y1 - y0;
+        const size_t ts = (tw * bpp + align) & ~align;
+        uint8_t* tmp = allocBuffer(ts * th);
+        if (!tmp) {
+            throw std::runtime_error("failed to allocate buffer.");
+        }
+        std::memset(tmp, 0, ts * th);
+        copy_rows(tmp + py * ts + px * bpp, static_cast<ptrdiff_t>(ts), row0 + x0 * bpp,
+                  sstride, (x1 - x0) * bpp, y1 - y0);
+        try {
+            process(nullptr, tmp, tw, th, 0, static_cast<ptrdiff_t>(ts), PROC_HV);
+        } catch (...) {
+            freeBuffer(tmp, ts * th);
+            throw;
+        }
+        freeBuffer(tmp, ts * th);
+    } else {
+        process(nullptr, row0 + x0 * bpp, x1 - x0, y1 - y0, 0, sstride, PROC_HV);
+    }
+    const uint8_t* s = image + (roi.y - y0 + py) / 2 * stride + (roi.x - x0 + px) / 2 * bpp;
+    width = ow;
+    height = oh;
+    if (dstp) {
+        copy_rows(dstp, dstride, s, static_cast<ptrdiff_t>(stride), ow * bpp, oh);
+        return;
+    }
+    // rows are moved up and to the left, so each one is read before written.
+    for (size_t y = 0; y < oh; ++y) {
+        std::memmove(image + y * stride, s + y * stride, ow * bpp);
+    }
+}
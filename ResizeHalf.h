@@ -17,8 +17,12 @@
 #ifndef RESIZE_HALF_H
 #define RESIZE_HALF_H
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
 #define RESIZE_HALF_VERSION_MAJOR   0
 #define RESIZE_HALF_VERSION_MINOR   0
@@ -26,6 +30,13 @@
 #define RESIZE_HALF_VERSION_STRING  "0.0.3"
 
 // Add -mssse3 when compiling for x86 with GCC/clang.
+// Add -mavx2 to ResizeHalf_avx2.cpp only. AVX2 kernels are used if the CPU supports them.
+// Add -mavx512bw -mavx512vbmi to ResizeHalf_avx512.cpp only, likewise.
+// On other CPUs, ResizeHalf_vec.cpp provides kernels with GCC/clang vector extensions.
+// Define RESIZE_HALF_FORCE_VECTOR for all files to use them on x86 instead of SSE.
+// Add -pthread on Linux (setThreads() uses std::thread).
+// CMakeLists.txt builds the library with these flags, the unit tests (resizehalf_test),
+// the benchmark (resizehalf_bench) and the command resizehalf for PGM/PPM/BMP files.
 
 // Note that this class throws std::runtime_error if any errors occur during processing.
 
@@ -34,83 +45,375 @@
 //                  This value is equal to width for GRAY8.
 //                  For RGB888, this value is three times the width.
 //                  For RGBA888, this value is four times the width.
+//                  For 16bit formats, this value is twice as much as 8bit ones.
+//                  For float formats, this value is four times as much as 8bit ones.
 // height:      Image height.
 // padding:     Data inserted after each line of image to adjust memory alignment.
 // stride:      The number of real bytes in each line of the image (rowsize + padding),
 //                  In most cases it will be a multiple of 4 in Windows Bitmap.
 //                  This value should be a multiple of 16 or more power of 2 when using SSE.
+//              Images need no padding after the last line: nothing after its rowsize is
+//              read or written. Padding between lines of dst may be overwritten.
 
 
 class ResizeHalf {
-    const size_t align;
+public:
+    class Allocator;
+
+private:
+    size_t align;
+    int simd;
     int format;
     int mode;
+    int conv;
+    int store;
     uint8_t* image;
     size_t buffsize;
+    std::shared_ptr<Allocator> allocator;
     size_t width;
     size_t height;
     size_t stride;
+    size_t threads;
+    size_t tile_width;
 
-    int getFlag(const void* ptr, size_t bytes) const noexcept;
-    void alloc();
-    const size_t prepare(const uint8_t* s, const size_t sw, const size_t sh,
-                         const size_t ss, const size_t ds, int pt);
-    void copyToDst(uint8_t* d, const size_t ds) noexcept;
+    // State of beginRows()/pushRows().
+    struct RowStream;
+    std::unique_ptr<RowStream> row_stream;
+
+    size_t bytesPerPixel() const noexcept { return format & 0x3F; }
+    size_t outBytesPerPixel() const noexcept;
+    int getFlag(const void* ptr, ptrdiff_t bytes) const noexcept;
+    int storeFlag(const size_t bytes) const noexcept;
+    size_t paddedStride(const size_t width) const noexcept;
+    void alloc(const size_t size);
+    uint8_t* allocBuffer(const size_t size) const noexcept;
+    void freeBuffer(void* p, const size_t size) const noexcept;
+    ptrdiff_t prepare(const uint8_t* s, const size_t sw, const size_t sh,
+                      const ptrdiff_t ss, const ptrdiff_t ds, int pt,
+                      const int times=1);
+    uint8_t* setDst(uint8_t* d, ptrdiff_t& ds);
+    void copyToDst(uint8_t* d, const ptrdiff_t ds) noexcept;
+    void process(uint8_t* dstp, const uint8_t* srcp, const size_t sw,
+                 const size_t sh, const ptrdiff_t ds, const ptrdiff_t ss, const int pt);
+    void processBlocks(uint8_t* dstp, const uint8_t* srcp, const size_t sw,
+                       const size_t sh, const ptrdiff_t ds, const ptrdiff_t ss, const int pt);
+    void noConversion() const;
+    void cascade(uint8_t* dstp, const uint8_t* srcp, const size_t sw,
+                 const size_t sh, const ptrdiff_t ds, const ptrdiff_t ss, const int times);
 
 public:
-    // Format of image to resize.
+    // Format of image to resize. The lower 6 bits are the number of bytes per pixel.
     enum FMT : int {
         GREY8       = 1,
         RGB888      = 3,
         RGBA8888    = 4,
+        GREY16      = 2,    // 16bit formats are of uint16_t in native byte order.
+        RGB48       = 6,
+        RGBA64      = 8,
+        GREYF32     = 0x40 | 4,     // float formats are not rounded or clamped.
+        RGBF32      = 0x40 | 12,
+        RGBAF32     = 0x40 | 16,
+        RGBA8888_STRAIGHT = 0x80 | 4,   // RGBA8888 of straight (not premultiplied) alpha.
+                                        // Colors are weighted by alpha while reducing.
     };
 
     // Resize method.
     enum MODE : int {
         BILINEAR    = (1 << 8),
         REDUCE_BY_2 = (1 << 9), // port from VirtualDub filter (better).
+        REDUCE_BY_2_EXACT = REDUCE_BY_2 | (1 << 10),
+                                // REDUCE_BY_2 rounding as C on any SIMD. SIMD of
+                                // REDUCE_BY_2 may make 8bit pixels smaller by 1.
+    };
+
+    // Conversion of the processed image (setConversion()).
+    enum CONV : int {
+        CONV_NONE    = 0,
+        CONV_RGBA    = 1,   // RGB888 to RGBA8888 of alpha 255.
+        CONV_GREY    = 2,   // RGB888 or RGBA8888 to GREY8, (77R + 150G + 29B + 128) >> 8.
+        CONV_SWAP_RB = 3,   // Swap the 1st and 3rd bytes of RGB888 or RGBA8888 (RGB <-> BGR).
+    };
+
+    // How SIMD kernels store the processed image (setStorePolicy()).
+    enum STORE : int {
+        STORE_AUTO   = 0,   // STORE_STREAM if it is larger than half of getCacheSize().
+        STORE_STREAM = 1,   // Non-temporal stores. Best if the image is not read soon.
+        STORE_CACHED = 2,   // Regular stores. Best if the image is read soon after.
+    };
+
+    // Instruction set to process with.
+    enum SIMD : int {
+        SIMD_NONE   = 0,
+        SIMD_SSE    = 1,    // SSE2, or SSSE3 if enabled at compile time.
+        SIMD_VECTOR = 1,    // Generic vectors of GCC/clang, used instead of SSE on other CPUs.
+        SIMD_AVX2   = 2,
+        SIMD_AVX512 = 3,    // AVX-512BW and AVX-512VBMI.
+    };
+
+    // Memory of the buffers (setAllocator()). It must be thread-safe, as the
+    // buffers of bands are allocated on their threads.
+    class Allocator {
+    public:
+        virtual ~Allocator() {}
+        // Returns size bytes aligned to alignment (a power of 2 up to 64), or nullptr.
+        virtual void* allocate(const size_t size, const size_t alignment) noexcept = 0;
+        // Frees p returned by allocate() for size bytes.
+        virtual void deallocate(void* p, const size_t size) noexcept = 0;
+    };
+
+    // An Allocator which keeps freed buffers to reuse them, shared by any number
+    // of instances on any threads. Sizes are rounded up to 1.25, 1.5, 1.75 or 2
+    // times a power of 2. Buffers freed beyond max_pooled bytes are released.
+    class BufferPool : public Allocator {
+        struct Blocks;
+        std::unique_ptr<Blocks> blocks;
+    public:
+        explicit BufferPool(const size_t max_pooled=(256 << 20));
+        ~BufferPool();
+        void* allocate(const size_t size, const size_t alignment) noexcept override;
+        void deallocate(void* p, const size_t size) noexcept override;
+        // Releases all the buffers kept.
+        void trim() noexcept;
+        // Returns the number of bytes kept.
+        size_t getPooledBytes() const noexcept;
+    };
+
+    // An Allocator for large images, of pages mapped for each buffer on Linux.
+    // Buffers of 2MiB or more are on huge pages: PAGES_HUGE maps them from the
+    // reserved huge pages (vm.nr_hugepages), or as PAGES_TRANSPARENT if none is
+    // left. PAGES_TRANSPARENT asks for transparent huge pages (madvise).
+    // If node_local, they are placed on the NUMA node of the allocating thread,
+    // rather than of the thread which touches each page first.
+    // Smaller buffers, and all of them on other systems, are of the default allocator.
+    class PageAllocator : public Allocator {
+    public:
+        enum PAGES : int {
+            PAGES_DEFAULT     = 0,
+            PAGES_TRANSPARENT = 1,
+            PAGES_HUGE        = 2,
+        };
+
+        explicit PageAllocator(const PAGES pages=PAGES_TRANSPARENT,
+                               const bool node_local=true) noexcept;
+        void* allocate(const size_t size, const size_t alignment) noexcept override;
+        void deallocate(void* p, const size_t size) noexcept override;
+
+    private:
+        PAGES pages;
+        bool node_local;
     };
 
     ResizeHalf(const FMT format, const MODE mode=REDUCE_BY_2);
     ~ResizeHalf();
 
+    // Instances are moved with their buffers and settings, but not copied.
+    ResizeHalf(ResizeHalf&& other) noexcept;
+    ResizeHalf& operator=(ResizeHalf&& other) noexcept;
+    ResizeHalf(const ResizeHalf&) = delete;
+    ResizeHalf& operator=(const ResizeHalf&) = delete;
+
+    // Allocate the intermediate buffer and the others with allocator.
+    // nullptr restores the default one (_mm_malloc or malloc). The intermediate
+    // buffer is released.
+    void setAllocator(std::shared_ptr<Allocator> allocator);
+
+    // Release the intermediate buffer, which only grows otherwise, and the
+    // buffer of beginRows(). data() is nullptr until the next processing.
+    void releaseBuffer() noexcept;
+
     // Change the image format to process.
     void setFormat(const FMT format) noexcept;
 
     // Change the methid to process.
     void setProcMode(const MODE mode) noexcept;
 
+    // Set how the processed image is stored (default STORE_AUTO).
+    // The intermediate buffer to be copied to dstp is always stored regularly.
+    void setStorePolicy(const STORE store) noexcept;
+
+    // Process resizeHV(), resizeHorizontal() and resizeVertical() in vertical strips of
+    // tile_width output pixels (rounded up to a multiple of 64), so that the source rows
+    // of a strip stay in cache for very wide images. The result is the same as without.
+    // 0 (default) processes whole rows. TILE_AUTO tiles only the images of which 3 source
+    // rows are larger than 512KiB, by strips of 3 source rows of about 128KiB.
+    // Tiling is not used with a conversion.
+    static constexpr size_t TILE_AUTO = ~static_cast<size_t>(0);
+    void setTileWidth(const size_t tile_width) noexcept;
+
+    // Convert the image made by resizeHV(), resizeHorizontal() and resizeVertical()
+    // (default CONV_NONE). A few rows are reduced at a time into a small buffer and
+    // converted to dstp while they are in cache, so dstp is written only once.
+    // dst_stride and the intermediate buffer are of the converted format.
+    // The other functions throw std::runtime_error unless this is CONV_NONE.
+    void setConversion(const CONV conv) noexcept;
+
+    // Limit the instruction set to process with.
+    // By default, the best one supported by the CPU is used.
+    void setSimd(const SIMD simd) noexcept;
+
+    // Set the number of threads to process with (default 1).
+    // The image is split into bands of rows, and the result is the same as
+    // with one thread. 0 means the number of CPU threads.
+    void setThreads(const size_t threads) noexcept;
+
     // Reduce the image to vertical and horizontal halves (round down after the decimal point).
     // dstp      : Start address of buffer to write the image after reduction.
-    //             If this value is nullptr, do not copy from the intermediate buffer.
+    //             If this value is nullptr, the result is left in the intermediate buffer.
+    //             If dstp and dst_stride are multiples of 16 (32 for AVX2, 64 for
+    //             AVX-512), the image is written to dstp directly without passing
+    //             through the intermediate buffer.
     // srcp      : Start address of original image.
     // src_width : Width of original image.
     // src_height: Height of original image.
     // dst_stride: Stride of processed image.
     // src_stride: Stride of original image.
     // ※ If src_stride and dst_stride are 0, they are treated as Windows Bitmap standard respectively.
+    // ※ A negative stride is for a bottom-up image: srcp/dstp point to its top row,
+    //   and the next row is at srcp + src_stride.
+    // ※ dstp may be srcp to reduce in place, if the strides have the same sign and
+    //   dst_stride is not larger than src_stride in magnitude.
+    //   Only a few rows are buffered, and they are processed on one thread.
+    //   The same applies to resizeHorizontal() and resizeVertical().
     void resizeHV(uint8_t* dstp, const uint8_t* srcp, const size_t src_width,
-                  const size_t src_height, const size_t dst_stride=0,
-                  const size_t src_stride=0);
+                  const size_t src_height, const ptrdiff_t dst_stride=0,
+                  const ptrdiff_t src_stride=0);
 
     // Reduce the image horizontally by half (round down after the decimal point).
     void resizeHorizontal(uint8_t* dstp, const uint8_t* srcp,
                           const size_t src_width, const size_t src_height,
-                          const size_t dst_stride=0, const size_t src_stride=0);
+                          const ptrdiff_t dst_stride=0, const ptrdiff_t src_stride=0);
 
     // Reduce the image vertically by half (round down after the decimal point)
     void resizeVertical(uint8_t* dstp, const uint8_t* srcp,
                         const size_t src_width, const size_t src_height,
-                        const size_t dst_stride=0, const size_t src_stride=0);
+                        const ptrdiff_t dst_stride=0, const ptrdiff_t src_stride=0);
+
+    // Reduce the image to quarters (or eighths) in one pass. The result is the same as
+    // calling resizeHV() two (or three) times, but the intermediate images are not
+    // made entirely: only a few rows of them are kept in small windows.
+    // Each intermediate image must not be smaller than 16x16.
+    void resizeQuarter(uint8_t* dstp, const uint8_t* srcp, const size_t src_width,
+                       const size_t src_height, const ptrdiff_t dst_stride=0,
+                       const ptrdiff_t src_stride=0);
+
+    void resizeEighth(uint8_t* dstp, const uint8_t* srcp, const size_t src_width,
+                      const size_t src_height, const ptrdiff_t dst_stride=0,
+                      const ptrdiff_t src_stride=0);
+
+    // A rectangle in an image.
+    struct Rect {
+        size_t x;
+        size_t y;
+        size_t width;
+        size_t height;
+    };
+
+    // Reduce the rectangle roi of the image to halves, as resizeHV() with srcp at its
+    // top-left pixel, except that reduce-by-2 makes the last column and row with the
+    // pixels after roi instead of repeating its own, if they are in the image.
+    // roi may be as small as 2x2: the pixels around it are read to make 16x16, and
+    // blank ones stand in for those before it in a 16-pixel image.
+    // If the result goes through the intermediate buffer anyway, the source is read
+    // from an aligned column before roi for the aligned kernels when possible.
+    // dstp must not point into the image.
+    void resizeROI(uint8_t* dstp, const uint8_t* srcp, const size_t src_width,
+                   const size_t src_height, const Rect& roi, const ptrdiff_t dst_stride=0,
+                   const ptrdiff_t src_stride=0);
+
+    // Reduce the image to halves (as resizeHV) from source rows pushed in order.
+    // Only the rows needed for the next output row (3 at most) are kept, and each
+    // output row is passed to on_row with its number as soon as it is made.
+    // The row is valid only during the call. getWidth() etc. describe the output.
+    void beginRows(const size_t src_width, const size_t src_height,
+                   std::function<void(const uint8_t* row, size_t y)> on_row);
+
+    // Push count source rows from the start address of the first one.
+    // Rows pushed together are used in place when possible.
+    void pushRows(const uint8_t* srcp, const size_t count=1, const ptrdiff_t src_stride=0);
+
+    // Returns the number of source rows pushed since beginRows().
+    size_t getPushedRows() const noexcept;
+
+    // An image to process with resizeBatch().
+    struct BatchItem {
+        uint8_t* dstp;          // Must not be nullptr.
+        const uint8_t* srcp;
+        size_t src_width;
+        size_t src_height;
+        ptrdiff_t dst_stride;   // 0 means Windows Bitmap standard as resizeHV().
+        ptrdiff_t src_stride;   // Negative for a bottom-up image as resizeHV().
+        const char* error;      // Set by resizeBatch(). nullptr if succeeded.
+    };
+
+    // Reduce each of count images to halves as resizeHV() (current format and method).
+    // All images are checked first, and then processed on getThreads() threads from
+    // the largest one. Each thread reuses one buffer for the images which cannot be
+    // written to dstp directly.
+    // This does not throw for an invalid image: its error is set and the others are
+    // processed. Returns the number of images which failed.
+    size_t resizeBatch(BatchItem* items, const size_t count);
+
+    // Layout of YUV 4:2:0 images for resizeYUV().
+    enum YUV : int {
+        I420 = 0,   // Y, U and V planes.
+        NV12 = 1,   // Y plane, and UV plane of interleaved U and V.
+    };
+
+    // Reduce all planes of a YUV 4:2:0 image to halves (as resizeHV) in one call.
+    // dstp      : Start addresses of the planes (Y, U and V for I420, Y and UV for NV12).
+    //             They must not be nullptr.
+    // srcp      : Start addresses of the planes of the original image.
+    // src_width : Width of the Y plane. Chroma planes are half as wide and high as Y.
+    // src_height: Height of the Y plane. Both must be multiples of 4 and 32 or more.
+    // dst_stride: Strides of the processed planes.
+    // src_stride: Strides of the original planes.
+    // ※ If the strides are nullptr or 0, they are the rowsizes of the planes.
+    // ※ A negative stride is for a bottom-up plane, as with resizeHV().
+    // The format set by setFormat() and the conversion are not used. The planes are processed in the same
+    // bands of rows on getThreads() threads, and the planes which cannot be written to
+    // dstp directly share the intermediate buffer.
+    void resizeYUV(const YUV layout, uint8_t* const dstp[], const uint8_t* const srcp[],
+                   const size_t src_width, const size_t src_height,
+                   const ptrdiff_t dst_stride[]=nullptr,
+                   const ptrdiff_t src_stride[]=nullptr);
+
+    // A level of the pyramid made by buildPyramid().
+    struct Level {
+        size_t width;
+        size_t height;
+        size_t stride;
+        size_t offset;      // Number of bytes from the start of the buffer.
+    };
+
+    // Returns the layout of the pyramid of a src_width x src_height image with the
+    // current format and instruction set. Levels are made while the previous level
+    // is not smaller than 16x16 and the new level is not smaller than min_size.
+    // The buffer size is back().offset + back().stride * back().height.
+    std::vector<Level> getPyramidLayout(const size_t src_width,
+                                        const size_t src_height,
+                                        const size_t min_size=1) const;
+
+    // Reduce the image to halves repeatedly (as resizeHV) and store all levels in one
+    // buffer laid out as getPyramidLayout().
+    // dstp      : Start address of the buffer. It must be aligned to getAlignment().
+    //             If this value is nullptr, the levels are stored in the intermediate
+    //             buffer, which is reused by the next call.
+    // The rows of each level are processed soon after the rows of the previous level
+    // they need were made, unless getThreads() is more than 1.
+    std::vector<Level> buildPyramid(uint8_t* dstp, const uint8_t* srcp,
+                                    const size_t src_width, const size_t src_height,
+                                    const ptrdiff_t src_stride=0,
+                                    const size_t min_size=1);
 
     // Returns the start address of the intermediate buffer where processed image data is stored.
+    // The contents are valid only when the last processing did not write to dstp directly.
     const uint8_t* data() const noexcept { return image; }
 
     // Returns the width of the processed image currently stored in the intermediate buffer.
     const size_t getWidth() const noexcept { return width; }
 
     // Returns the number of valid bytes per line of the processed image currently stored in the intermediate buffer.
-    const size_t getRowsize() const noexcept { return width * format; }
+    const size_t getRowsize() const noexcept { return width * outBytesPerPixel(); }
 
     // Returns the hidth of the processed image currently stored in the intermediate buffer.
     const size_t getHeight() const noexcept { return height; }
@@ -118,11 +421,35 @@ public:
     // Returns the stride of the processed image currently stored in the intermediate buffer.
     const size_t getStride() const noexcept { return stride; }
 
+    // Returns the alignment of the intermediate buffer and of its strides.
+    size_t getAlignment() const noexcept { return align + 1; }
+
     // Returns the currently set image format to process
     const int getFormat() const noexcept { return format; }
 
     // Returns the currently set method to process
     const int getProcMode() const noexcept { return mode; }
+
+    // Returns the currently set conversion.
+    int getConversion() const noexcept { return conv; }
+
+    // Returns the instruction set currently used to process.
+    int getSimd() const noexcept { return simd; }
+
+    // Returns the number of threads to process with.
+    size_t getThreads() const noexcept { return threads; }
+
+    // Returns the currently set store policy.
+    int getStorePolicy() const noexcept { return store; }
+
+    // Returns the tile width set by setTileWidth().
+    size_t getTileWidth() const noexcept { return tile_width; }
+
+    // Returns the best instruction set supported by both the build and the CPU.
+    static SIMD getSupportedSimd() noexcept;
+
+    // Returns the size of the last level cache in bytes (8MiB if it is unknown).
+    static size_t getCacheSize() noexcept;
 };
 
 
@@ -0,0 +1,84 @@
+/*
+    ResizeHalf_avx2.cpp
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+// This file must be compiled with -mavx2 (/arch:AVX2 on MSVC).
+// Otherwise no AVX2 kernels are provided and SSE is used instead.
+
+#include "rh_common.h"
+#include "bilinear_functions_avx2.h"
+#include "reduceby2_functions_avx2.h"
+
+#include "ResizeHalf.h"
+
+
+#if defined(__AVX2__)
+template <bool STREAM>
+static proc_func_t get_proc(const int pt, const int flag) noexcept
+{
+    switch (flag) {
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREY8):
+        return pt == PROC_HV ? bilinear_hv_grey_avx2<true, STREAM>
+            : pt == PROC_H ? bilinear_h_grey_avx2<true, STREAM>
+            : bilinear_v_grey_avx2<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? bilinear_hv_rgba_avx2<true, STREAM>
+            : pt == PROC_H ? bilinear_h_rgba_avx2<true, STREAM>
+            : bilinear_v_rgba_avx2<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_grey_avx2<true, STREAM>
+            : pt == PROC_H ? reduceby2_h_grey_avx2<true, STREAM>
+            : reduceby2_v_grey_avx2<true, STREAM>;
+    case (ALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_rgba_avx2<true, STREAM>
+            : pt == PROC_H ? reduceby2_h_rgba_avx2<true, STREAM>
+            : reduceby2_v_rgba_avx2<true, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::GREY8):
+        return pt == PROC_HV ? bilinear_hv_grey_avx2<false, STREAM>
+            : pt == PROC_H ? bilinear_h_grey_avx2<false, STREAM>
+            : bilinear_v_grey_avx2<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGB888):
+        return pt == PROC_HV ? bilinear_hv_rgb888_avx2
+            : pt == PROC_H ? bilinear_h_rgb888_avx2 : bilinear_v_rgb888_avx2;
+    case (UNALIGNED_IMAGE | ResizeHalf::BILINEAR | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? bilinear_hv_rgba_avx2<false, STREAM>
+            : pt == PROC_H ? bilinear_h_rgba_avx2<false, STREAM>
+            : bilinear_v_rgba_avx2<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_grey_avx2<false, STREAM>
+            : pt == PROC_H ? reduceby2_h_grey_avx2<false, STREAM>
+            : reduceby2_v_grey_avx2<false, STREAM>;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGB888):
+        return pt == PROC_HV ? reduceby2_hv_rgb888_avx2
+            : pt == PROC_H ? reduceby2_h_rgb888_avx2 : reduceby2_v_rgb888_avx2;
+    case (UNALIGNED_IMAGE | ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_rgba_avx2<false, STREAM>
+            : pt == PROC_H ? reduceby2_h_rgba_avx2<false, STREAM>
+            : reduceby2_v_rgba_avx2<false, STREAM>;
+    default:
+        return nullptr;
+    }
+}
+#endif
+
+
+proc_func_t get_proc_avx2(const int pt, const int flag) noexcept
+{
+#if defined(__AVX2__)
+    return flag & CACHED_STORE ? get_proc<false>(pt, flag & ~CACHED_STORE)
+        : get_proc<true>(pt, flag);
+#else
+    return nullptr;
+#endif
+}
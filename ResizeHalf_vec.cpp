@@ -0,0 +1,56 @@
+/*
+    ResizeHalf_vec.cpp
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+// Kernels written with generic vectors of GCC/clang for CPUs without SSE2
+// (e.g. ARM). Compile with -DRESIZE_HALF_FORCE_VECTOR to use them on x86.
+
+#include "rh_common.h"
+#include "bilinear_functions_vec.h"
+#include "reduceby2_functions_vec.h"
+
+#include "ResizeHalf.h"
+
+
+proc_func_t get_proc_vec(const int pt, const int flag) noexcept
+{
+#if defined(RH_VECTOR_EXT)
+    switch (flag & ~(ALIGNED_IMAGE | CACHED_STORE)) {
+    case (ResizeHalf::BILINEAR | ResizeHalf::GREY8):
+        return pt == PROC_HV ? bilinear_hv_grey_vec
+            : pt == PROC_H ? bilinear_h_grey_vec : bilinear_v_grey_vec;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGB888):
+        return pt == PROC_HV ? bilinear_hv_rgb888_vec
+            : pt == PROC_H ? bilinear_h_rgb888_vec : bilinear_v_rgb888_vec;
+    case (ResizeHalf::BILINEAR | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? bilinear_hv_rgba_vec
+            : pt == PROC_H ? bilinear_h_rgba_vec : bilinear_v_rgba_vec;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::GREY8):
+        return pt == PROC_HV ? reduceby2_hv_grey_vec
+            : pt == PROC_H ? reduceby2_h_grey_vec : reduceby2_v_grey_vec;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGB888):
+        return pt == PROC_HV ? reduceby2_hv_rgb888_vec
+            : pt == PROC_H ? reduceby2_h_rgb888_vec : reduceby2_v_rgb888_vec;
+    case (ResizeHalf::REDUCE_BY_2 | ResizeHalf::RGBA8888):
+        return pt == PROC_HV ? reduceby2_hv_rgba_vec
+            : pt == PROC_H ? reduceby2_h_rgba_vec : reduceby2_v_rgba_vec;
+    default:
+        break;
+    }
+#else
+    (void)pt;
+    (void)flag;
+#endif
+    return nullptr;
+}
@@ -0,0 +1,507 @@
+/*
+    resizehalf_bench.cpp
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+// Benchmark of resizeHV(), resizeHorizontal() and resizeVertical() over
+// formats x methods x aligned/unaligned images x sizes.
+//
+// usage: resizehalf_bench [options]
+//   --json FILE     write the results to FILE as JSON ("-" for stdout).
+//   --simd N        limit the instruction set (0: C, 1: SSE, 2: AVX2, 3: AVX-512).
+//   --threads N     number of threads (default 1).
+//   --tile N        tile width of setTileWidth() (0: whole rows, auto: TILE_AUTO).
+//   --store P       store policy (auto, stream or cached).
+//   --consume       read the processed image after each call, as the next stage
+//                   would. Its time is included.
+//   --pages P       allocate the images and the buffers of ResizeHalf with
+//                   PageAllocator (default, thp or huge pages, node local).
+//   --time MS       minimum time to repeat each case (default 20).
+//   --max-width N   skip the sizes wider than N.
+//   --filter STR    run only the cases whose name contains STR.
+//   --quick         small sizes, a few runs each (smoke test).
+//
+// MPix/s and cycles/pixel are of source pixels, and GB/s counts the bytes of
+// source and processed images. Times are the median of the runs. Cycles are
+// of the time stamp counter, so they are not exact core cycles under
+// frequency scaling, and are not reported on CPUs other than x86.
+// dTLB/kpx is the number of dTLB load and store misses per 1000 source pixels,
+// counted by perf_event_open() on Linux if the CPU and the system allow it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define RH_BENCH_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define RH_BENCH_TSC
+#endif
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "ResizeHalf.h"
+
+
+struct Named {
+    int value;
+    const char* name;
+};
+
+static const Named formats[] = {
+    {ResizeHalf::GREY8, "GREY8"},
+    {ResizeHalf::RGB888, "RGB888"},
+    {ResizeHalf::RGBA8888, "RGBA8888"},
+    {ResizeHalf::GREY16, "GREY16"},
+    {ResizeHalf::RGB48, "RGB48"},
+    {ResizeHalf::RGBA64, "RGBA64"},
+    {ResizeHalf::GREYF32, "GREYF32"},
+    {ResizeHalf::RGBF32, "RGBF32"},
+    {ResizeHalf::RGBAF32, "RGBAF32"},
+    {ResizeHalf::RGBA8888_STRAIGHT, "RGBA8888_STRAIGHT"},
+};
+
+static const Named modes[] = {
+    {ResizeHalf::BILINEAR, "BILINEAR"},
+    {ResizeHalf::REDUCE_BY_2, "REDUCE_BY_2"},
+    {ResizeHalf::REDUCE_BY_2_EXACT, "REDUCE_BY_2_EXACT"},
+};
+
+static const char* const procs[] = {"HV", "H", "V"};
+
+static const size_t sizes[][2] = {
+    {16, 16}, {64, 64}, {256, 256}, {640, 480}, {1280, 720},
+    {1920, 1080}, {3840, 2160}, {7680, 4320},
+};
+
+
+struct Options {
+    const char* json = nullptr;
+    int simd = -1;
+    size_t threads = 1;
+    size_t tile = 0;
+    int store = ResizeHalf::STORE_AUTO;
+    bool consume = false;
+    int pages = -1;     // PageAllocator::PAGES, or -1 for std::vector.
+    double time_ms = 20.0;
+    size_t max_width = 0;
+    std::string filter;
+    bool quick = false;
+};
+
+
+struct Result {
+    std::string format, mode, proc;
+    bool aligned;
+    size_t width, height;
+    size_t runs;
+    double median_us, min_us;
+    double mpix_s, gb_s;
+    double cycles_per_pixel;    // negative if not measured.
+    double tlb_per_kpx;         // likewise.
+};
+
+
+static uint64_t ticks() noexcept
+{
+#if defined(RH_BENCH_TSC)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+// Counts dTLB misses of this thread, of loads and stores. The events the CPU
+// does not have are not counted, and nothing is if neither is available.
+class TlbCounter {
+    int fds[2];
+
+public:
+    TlbCounter() : fds{-1, -1}
+    {
+#if defined(__linux__)
+        const uint64_t ops[] = {PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_OP_WRITE};
+        for (int i = 0; i < 2; ++i) {
+            perf_event_attr a;
+            std::memset(&a, 0, sizeof(a));
+            a.type = PERF_TYPE_HW_CACHE;
+            a.size = sizeof(a);
+            a.config = PERF_COUNT_HW_CACHE_DTLB | (ops[i] << 8)
+                | (static_cast<uint64_t>(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+            a.exclude_kernel = 1;
+            a.exclude_hv = 1;
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &a, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    ~TlbCounter()
+    {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    bool available() const noexcept { return fds[0] >= 0 || fds[1] >= 0; }
+
+    uint64_t read() const noexcept
+    {
+        uint64_t total = 0;
+#if defined(__linux__)
+        for (int fd : fds) {
+            uint64_t v = 0;
+            if (fd >= 0 && ::read(fd, &v, sizeof(v)) == sizeof(v)) {
+                total += v;
+            }
+        }
+#endif
+        return total;
+    }
+};
+
+
+// A buffer aligned to 64 bytes, or to the size of a sample plus 64 bytes.
+// It is of allocator if not nullptr.
+struct Buffer {
+    std::vector<uint8_t> mem;
+    ResizeHalf::Allocator* allocator;
+    uint8_t* base;
+    size_t size;
+    uint8_t* p;
+
+    Buffer(const size_t sz, const size_t offset, ResizeHalf::Allocator* a) :
+        allocator(a), base(nullptr), size(sz + 128)
+    {
+        if (allocator) {
+            base = static_cast<uint8_t*>(allocator->allocate(size, 64));
+            if (!base) {
+                throw std::bad_alloc();
+            }
+            p = base;
+        } else {
+            mem.resize(size);
+            p = mem.data();
+        }
+        while (reinterpret_cast<uintptr_t>(p) & 63) {
+            ++p;
+        }
+        p += offset;
+    }
+
+    ~Buffer()
+    {
+        if (base) {
+            allocator->deallocate(base, size);
+        }
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+};
+
+
+static size_t elem_of(const int fmt)
+{
+    return fmt & 0x40 ? 4 : fmt == ResizeHalf::GREY16 || fmt == ResizeHalf::RGB48
+        || fmt == ResizeHalf::RGBA64 ? 2 : 1;
+}
+
+
+static bool parse(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (a == "--json" && has_value) {
+            opt.json = argv[++i];
+        } else if (a == "--simd" && has_value) {
+            opt.simd = std::atoi(argv[++i]);
+        } else if (a == "--threads" && has_value) {
+            opt.threads = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (a == "--tile" && has_value) {
+            std::string v = argv[++i];
+            opt.tile = v == "auto" ? ResizeHalf::TILE_AUTO
+                : static_cast<size_t>(std::atol(v.c_str()));
+        } else if (a == "--store" && has_value) {
+            std::string v = argv[++i];
+            opt.store = v == "stream" ? ResizeHalf::STORE_STREAM
+                : v == "cached" ? ResizeHalf::STORE_CACHED : ResizeHalf::STORE_AUTO;
+        } else if (a == "--consume") {
+            opt.consume = true;
+        } else if (a == "--pages" && has_value) {
+            std::string v = argv[++i];
+            opt.pages = v == "huge" ? ResizeHalf::PageAllocator::PAGES_HUGE
+                : v == "thp" ? ResizeHalf::PageAllocator::PAGES_TRANSPARENT
+                : ResizeHalf::PageAllocator::PAGES_DEFAULT;
+        } else if (a == "--time" && has_value) {
+            opt.time_ms = std::atof(argv[++i]);
+        } else if (a == "--max-width" && has_value) {
+            opt.max_width = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (a == "--filter" && has_value) {
+            opt.filter = argv[++i];
+        } else if (a == "--quick") {
+            opt.quick = true;
+        } else {
+            std::fprintf(stderr, "unknown option: %s\n", a.c_str());
+            return false;
+        }
+    }
+    if (opt.quick) {
+        opt.max_width = opt.max_width == 0 ? 256 : std::min<size_t>(opt.max_width, 256);
+        opt.time_ms = 0.0;
+    }
+    return true;
+}
+
+
+static Result run_case(ResizeHalf& r, const Named& fmt, const Named& mode, const int pt,
+                       const bool aligned, const size_t sw, const size_t sh,
+                       const uint8_t* srcp, const size_t ss, uint8_t* dstp,
+                       const size_t ds, const TlbCounter& tlb, const Options& opt)
+{
+    r.setFormat(static_cast<ResizeHalf::FMT>(fmt.value));
+    r.setProcMode(static_cast<ResizeHalf::MODE>(mode.value));
+    const size_t bpp = static_cast<size_t>(fmt.value & 0x3F);
+    const size_t ow = pt == 2 ? sw : sw / 2;
+    const size_t oh = pt == 1 ? sh : sh / 2;
+    volatile uint64_t sink = 0;
+    auto call = [&] {
+        if (pt == 0) {
+            r.resizeHV(dstp, srcp, sw, sh, ds, ss);
+        } else if (pt == 1) {
+            r.resizeHorizontal(dstp, srcp, sw, sh, ds, ss);
+        } else {
+            r.resizeVertical(dstp, srcp, sw, sh, ds, ss);
+        }
+        if (opt.consume) {
+            uint64_t sum = 0;
+            for (size_t y = 0; y < oh; ++y) {
+                const uint8_t* row = dstp + y * ds;
+                for (size_t x = 0; x + 8 <= ow * bpp; x += 8) {
+                    uint64_t v;
+                    std::memcpy(&v, row + x, 8);
+                    sum += v;
+                }
+            }
+            sink = sink + sum;
+        }
+    };
+
+    call();     // warm up.
+    const size_t min_runs = opt.quick ? 1 : 5;
+    std::vector<double> times;
+    std::vector<uint64_t> cycles;
+    std::vector<uint64_t> misses;
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t m0 = tlb.read();
+        uint64_t c0 = ticks();
+        call();
+        uint64_t c1 = ticks();
+        uint64_t m1 = tlb.read();
+        auto t1 = std::chrono::steady_clock::now();
+        misses.push_back(m1 - m0);
+        times.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        cycles.push_back(c1 - c0);
+        double elapsed = std::chrono::duration<double, std::milli>(t1 - start).count();
+        if (times.size() >= min_runs && elapsed >= opt.time_ms) {
+            break;
+        }
+    }
+
+    const size_t n = times.size();
+    std::vector<double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    std::sort(cycles.begin(), cycles.end());
+    std::sort(misses.begin(), misses.end());
+
+    const double pixels = static_cast<double>(sw * sh);
+    const double bytes = static_cast<double>((sw * sh + ow * oh) * bpp);
+
+    Result res;
+    res.format = fmt.name;
+    res.mode = mode.name;
+    res.proc = procs[pt];
+    res.aligned = aligned;
+    res.width = sw;
+    res.height = sh;
+    res.runs = n;
+    res.median_us = sorted[n / 2];
+    res.min_us = sorted[0];
+    res.mpix_s = pixels / res.median_us;
+    res.gb_s = bytes / res.median_us / 1000.0;
+#if defined(RH_BENCH_TSC)
+    res.cycles_per_pixel = static_cast<double>(cycles[n / 2]) / pixels;
+#else
+    res.cycles_per_pixel = -1.0;
+#endif
+    res.tlb_per_kpx = tlb.available()
+        ? static_cast<double>(misses[n / 2]) * 1000.0 / pixels : -1.0;
+    return res;
+}
+
+
+static void write_json(std::FILE* f, const std::vector<Result>& results,
+                       const ResizeHalf& r, const int pages)
+{
+    std::fprintf(f, "{\n  \"version\": \"%s\",\n  \"simd\": %d,\n  \"threads\": %zu,\n"
+                 "  \"store\": %d,\n  \"pages\": %d,\n  \"cache_size\": %zu,\n"
+                 "  \"results\": [\n",
+                 RESIZE_HALF_VERSION_STRING, r.getSimd(), r.getThreads(),
+                 r.getStorePolicy(), pages, ResizeHalf::getCacheSize());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& x = results[i];
+        std::fprintf(f, "    {\"format\": \"%s\", \"mode\": \"%s\", \"proc\": \"%s\", "
+                     "\"aligned\": %s, \"width\": %zu, \"height\": %zu, \"runs\": %zu, "
+                     "\"median_us\": %.3f, \"min_us\": %.3f, \"mpix_s\": %.3f, "
+                     "\"gb_s\": %.4f, \"cycles_per_pixel\": ",
+                     x.format.c_str(), x.mode.c_str(), x.proc.c_str(),
+                     x.aligned ? "true" : "false", x.width, x.height, x.runs,
+                     x.median_us, x.min_us, x.mpix_s, x.gb_s);
+        if (x.cycles_per_pixel < 0) {
+            std::fprintf(f, "null");
+        } else {
+            std::fprintf(f, "%.4f", x.cycles_per_pixel);
+        }
+        if (x.tlb_per_kpx < 0) {
+            std::fprintf(f, ", \"dtlb_misses_per_kpx\": null}");
+        } else {
+            std::fprintf(f, ", \"dtlb_misses_per_kpx\": %.4f}", x.tlb_per_kpx);
+        }
+        std::fprintf(f, "%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+}
+
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        return 2;
+    }
+
+    ResizeHalf r(ResizeHalf::GREY8);
+    if (opt.simd >= 0) {
+        r.setSimd(static_cast<ResizeHalf::SIMD>(opt.simd));
+    }
+    r.setThreads(opt.threads);
+    r.setTileWidth(opt.tile);
+    r.setStorePolicy(static_cast<ResizeHalf::STORE>(opt.store));
+    std::shared_ptr<ResizeHalf::PageAllocator> pages;
+    if (opt.pages >= 0) {
+        pages = std::make_shared<ResizeHalf::PageAllocator>(
+            static_cast<ResizeHalf::PageAllocator::PAGES>(opt.pages));
+        r.setAllocator(pages);
+    }
+    TlbCounter tlb;
+
+    // The table goes to stderr when the JSON goes to stdout.
+    std::FILE* out = opt.json && std::strcmp(opt.json, "-") == 0 ? stderr : stdout;
+    std::fprintf(out, "simd %d, threads %zu, cache %zuKiB, pages %d, dTLB counters %s\n",
+                 r.getSimd(), r.getThreads(), ResizeHalf::getCacheSize() >> 10, opt.pages,
+                 tlb.available() ? "yes" : "no");
+    std::fprintf(out, "%-18s %-18s %-3s %-5s %11s %12s %10s %8s %8s %9s\n", "format", "mode",
+                 "pt", "align", "size", "median(us)", "MPix/s", "GB/s", "cyc/px",
+                 "dTLB/kpx");
+
+    std::vector<Result> results;
+    for (auto& sz : sizes) {
+        const size_t sw = sz[0], sh = sz[1];
+        if (opt.max_width != 0 && sw > opt.max_width) {
+            continue;
+        }
+        for (auto& fmt : formats) for (int aligned = 1; aligned >= 0; --aligned) {
+            const size_t bpp = static_cast<size_t>(fmt.value & 0x3F);
+            const size_t e = elem_of(fmt.value);
+            // unaligned images are of rowsize stride and start at a sample after
+            // an aligned address.
+            const size_t ss = aligned ? (sw * bpp + 63) & ~static_cast<size_t>(63) : sw * bpp;
+            const size_t ds = aligned ? (sw * bpp + 63) & ~static_cast<size_t>(63) : sw * bpp;
+            Buffer src(ss * sh, aligned ? 0 : e, pages.get());
+            Buffer dst(ds * sh, aligned ? 0 : e, pages.get());
+            uint32_t seed = 1;
+            for (size_t i = 0; i < ss * sh; ++i) {
+                seed = seed * 1103515245u + 12345u;
+                src.p[i] = static_cast<uint8_t>(seed >> 16);
+            }
+            if (fmt.value & 0x40) {
+                // random floats in [0, 1)
+                for (size_t i = 0; i + 4 <= ss * sh; i += 4) {
+                    float v = static_cast<float>(src.p[i] | (src.p[i + 1] << 8)) / 65536.0f;
+                    std::memcpy(src.p + i, &v, 4);
+                }
+            }
+
+            for (auto& mode : modes) for (int pt = 0; pt < 3; ++pt) {
+                char name[128];
+                std::snprintf(name, sizeof(name), "%s/%s/%s/%s/%zux%zu", fmt.name,
+                              mode.name, procs[pt], aligned ? "aligned" : "unaligned",
+                              sw, sh);
+                if (!opt.filter.empty() && std::strstr(name, opt.filter.c_str()) == nullptr) {
+                    continue;
+                }
+                auto res = run_case(r, fmt, mode, pt, aligned != 0, sw, sh, src.p, ss,
+                                    dst.p, ds, tlb, opt);
+                char size[32];
+                std::snprintf(size, sizeof(size), "%zux%zu", sw, sh);
+                std::fprintf(out, "%-18s %-18s %-3s %-5s %11s %12.2f %10.1f %8.2f ",
+                             fmt.name, mode.name, procs[pt], aligned ? "yes" : "no",
+                             size, res.median_us, res.mpix_s, res.gb_s);
+                if (res.cycles_per_pixel < 0) {
+                    std::fprintf(out, "%8s ", "-");
+                } else {
+                    std::fprintf(out, "%8.3f ", res.cycles_per_pixel);
+                }
+                if (res.tlb_per_kpx < 0) {
+                    std::fprintf(out, "%9s\n", "-");
+                } else {
+                    std::fprintf(out, "%9.3f\n", res.tlb_per_kpx);
+                }
+                results.push_back(res);
+            }
+        }
+    }
+
+    if (opt.json) {
+        const bool to_stdout = std::strcmp(opt.json, "-") == 0;
+        std::FILE* f = to_stdout ? stdout : std::fopen(opt.json, "w");
+        if (!f) {
+            std::fprintf(stderr, "cannot open %s\n", opt.json);
+            return 1;
+        }
+        write_json(f, results, r, opt.pages);
+        if (!to_stdout) {
+            std::fclose(f);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+    bilinear_functions_16bit.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef BILINEAR_FUNCTIONS_16BIT_H
+#define BILINEAR_FUNCTIONS_16BIT_H
+
+#include "rh_common.h"
+
+// Kernels for GREY16, RGB48 and RGBA64. CH is the number of channels.
+// Sums are taken in 32bit, so SIMD results are the same as C ones.
+
+
+// Bilinear Resize for 16bit formats (no SIMD)
+template <int CH>
+static void bilinear_hv_16bit_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH;
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sa = reinterpret_cast<const uint16_t*>(srcp);
+        auto sb = reinterpret_cast<const uint16_t*>(srcp + sstride);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                d[x / 2 + c] = static_cast<uint16_t>((
+                    sa[x + c] + sa[x + CH + c] + sb[x + c] + sb[x + CH + c] + 2) / 4);
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void bilinear_h_16bit_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH;
+
+    for (size_t y = 0; y < height; ++y) {
+        auto s = reinterpret_cast<const uint16_t*>(srcp);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                d[x / 2 + c] = static_cast<uint16_t>((s[x + c] + s[x + CH + c] + 1) / 2);
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void bilinear_v_16bit_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH;
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sa = reinterpret_cast<const uint16_t*>(srcp);
+        auto sb = reinterpret_cast<const uint16_t*>(srcp + sstride);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; ++x) {
+            d[x] = static_cast<uint16_t>((sa[x] + sb[x] + 1) / 2);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+#if defined(__SSE2__)
+
+// Bilinear Resize for GREY16 (CH = 1) and RGBA64 (CH = 4)
+template <int CH>
+static F_INLINE __m128i sum_pairs16(const __m128i& v)
+{
+    return _mm_add_epi32(first16<CH>(v), second16<CH>(v));
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void bilinear_hv_16bit(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH * 2;
+    auto h = height & ~1;
+    const __m128i two = _mm_set1_epi32(2);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 32) {
+            __m128i s0 = _mm_add_epi32(
+                sum_pairs16<CH>(load<ALIGNED>(srcp + x)),
+                sum_pairs16<CH>(load<ALIGNED>(sb + x)));
+            __m128i s1 = _mm_add_epi32(
+                sum_pairs16<CH>(load<ALIGNED>(srcp + x + 16)),
+                sum_pairs16<CH>(load<ALIGNED>(sb + x + 16)));
+            s0 = _mm_srli_epi32(_mm_add_epi32(s0, two), 2);
+            s1 = _mm_srli_epi32(_mm_add_epi32(s1, two), 2);
+            store<STREAM>(dstp + x / 2, pack_u32(s0, s1));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void bilinear_h_16bit(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH * 2;
+    const __m128i one = _mm_set1_epi32(1);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 32) {
+            __m128i s0 = sum_pairs16<CH>(load<ALIGNED>(srcp + x));
+            __m128i s1 = sum_pairs16<CH>(load<ALIGNED>(srcp + x + 16));
+            s0 = _mm_srli_epi32(_mm_add_epi32(s0, one), 1);
+            s1 = _mm_srli_epi32(_mm_add_epi32(s1, one), 1);
+            store<STREAM>(dstp + x / 2, pack_u32(s0, s1));
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// CH = 3 is also fine.
+template <int CH, bool ALIGNED, bool STREAM>
+static void bilinear_v_16bit(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH * 2;
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m128i ret = _mm_avg_epu16(
+                load<ALIGNED>(srcp + x), load<ALIGNED>(srcp + x + sstride));
+            store<STREAM>(dstp + x, ret);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+// Bilinear Resize for RGB48
+// Pixels are loaded one by one, and the last ones of each row are left to
+// the C kernel not to read beyond the row. The C kernel also overwrites the
+// junk element stored after the last pixel made here.
+static void bilinear_hv_rgb48(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 2) / 2;
+    auto h = height & ~1;
+    const __m128i two = _mm_set1_epi32(2);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = s + sstride;
+        for (size_t x = 0; x < n; ++x) {
+            __m128i t = _mm_add_epi32(
+                _mm_add_epi32(load_rgb48(s + 12 * x), load_rgb48(s + 12 * x + 6)),
+                _mm_add_epi32(load_rgb48(sb + 12 * x), load_rgb48(sb + 12 * x + 6)));
+            t = _mm_srli_epi32(_mm_add_epi32(t, two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 6 * x), pack_u32(t, t));
+        }
+        s += 2 * sstride;
+        d += dstride;
+    }
+    bilinear_hv_16bit_c<3>(
+        srcp + 12 * n, dstp + 6 * n, width - 2 * n, height, sstride, dstride);
+}
+
+
+static void bilinear_h_rgb48(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 2) / 2;
+    const __m128i one = _mm_set1_epi32(1);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < n; ++x) {
+            __m128i t = _mm_add_epi32(load_rgb48(s + 12 * x), load_rgb48(s + 12 * x + 6));
+            t = _mm_srli_epi32(_mm_add_epi32(t, one), 1);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 6 * x), pack_u32(t, t));
+        }
+        s += sstride;
+        d += dstride;
+    }
+    bilinear_h_16bit_c<3>(
+        srcp + 12 * n, dstp + 6 * n, width - 2 * n, height, sstride, dstride);
+}
+
+#endif // __SSE2__
+
+#endif // BILINEAR_FUNCTIONS_16BIT_H
@@ -0,0 +1,260 @@
+/*
+    bilinear_functions_avx2.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef BILINEAR_FUNCTIONS_AVX2_H
+#define BILINEAR_FUNCTIONS_AVX2_H
+
+#include "rh_common.h"
+
+#if defined(__AVX2__)
+
+// Bilinear Resize for RGBA
+// bias is subtracted from the odd pixels to cancel rounding up twice in hv.
+static F_INLINE __m256i bl_h_rgba_avx2(
+    const __m256i& _a, const __m256i& _b, const __m256i& bias)
+{
+    __m256i a = _mm256_shuffle_epi32(_a, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i b = _mm256_shuffle_epi32(_b, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i ret = _mm256_avg_epu8(
+        _mm256_unpacklo_epi64(a, b),
+        _mm256_subs_epu8(_mm256_unpackhi_epi64(a, b), bias));
+    return _mm256_permute4x64_epi64(ret, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_hv_rgba_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 16) {
+            __m256i s0 = _mm256_avg_epu8(
+                load256<ALIGNED>(srcp + 4 * x), load256<ALIGNED>(sb + 4 * x));
+            __m256i s1 = _mm256_avg_epu8(
+                load256<ALIGNED>(srcp + 4 * x + 32),
+                load256<ALIGNED>(sb + 4 * x + 32));
+            store256<STREAM>(dstp + 2 * x, bl_h_rgba_avx2(s0, s1, one));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_h_rgba_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m256i ret = bl_h_rgba_avx2(
+                load256<ALIGNED>(srcp + 4 * x),
+                load256<ALIGNED>(srcp + 4 * x + 32), zero);
+            store256<STREAM>(dstp + 2 * x, ret);
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_v_rgba_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        for (size_t x = 0; x < width; x += 8) {
+            __m256i ret = _mm256_avg_epu8(
+                load256<ALIGNED>(srcp + 4 * x),
+                load256<ALIGNED>(srcp + 4 * x + sstride));
+            store256<STREAM>(dstp + 4 * x, ret);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+// Bilinear Resize for GREY8
+static F_INLINE __m256i bl_h_grey_avx2(
+    const __m256i& l0, const __m256i& l1, const __m256i& mask,
+    const __m256i& bias)
+{
+    __m256i ret = _mm256_avg_epu8(
+        _mm256_packus_epi16(
+            _mm256_and_si256(l0, mask), _mm256_and_si256(l1, mask)),
+        _mm256_subs_epu8(
+            _mm256_packus_epi16(
+                _mm256_srli_epi16(l0, 8), _mm256_srli_epi16(l1, 8)), bias));
+    return _mm256_permute4x64_epi64(ret, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_hv_grey_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 64) {
+            __m256i s0 = _mm256_avg_epu8(
+                load256<ALIGNED>(srcp + x), load256<ALIGNED>(sb + x));
+            __m256i s1 = _mm256_avg_epu8(
+                load256<ALIGNED>(srcp + x + 32), load256<ALIGNED>(sb + x + 32));
+            store256<STREAM>(dstp + x / 2, bl_h_grey_avx2(s0, s1, mask, one));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_h_grey_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 64) {
+            __m256i ret = bl_h_grey_avx2(
+                load256<ALIGNED>(srcp + x),
+                load256<ALIGNED>(srcp + x + 32), mask, zero);
+            store256<STREAM>(dstp + x / 2, ret);
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_v_grey_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        for (size_t x = 0; x < width; x += 32) {
+            __m256i ret = _mm256_avg_epu8(
+                load256<ALIGNED>(srcp + x),
+                load256<ALIGNED>(srcp + x + sstride));
+            store256<STREAM>(dstp + x, ret);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+// Bilinear Resize for RGB888
+static void bilinear_hv_rgb888_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i smask0 = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i smask1 = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pmask = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 16) {
+            __m256i s0 = _mm256_avg_epu8(
+                load_rgb888x2(srcp + 3 * x), load_rgb888x2(sb + 3 * x));
+            __m256i s1 = _mm256_avg_epu8(
+                load_rgb888x2(srcp + 3 * x + 24), load_rgb888x2(sb + 3 * x + 24));
+            s0 = _mm256_shuffle_epi8(s0, smask0);
+            s1 = _mm256_shuffle_epi8(s1, smask0);
+            s0 = _mm256_shuffle_epi8(bl_h_rgba_avx2(s0, s1, one), smask1);
+            storeu256(dstp + 3 * x / 2, _mm256_permutevar8x32_epi32(s0, pmask));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_h_rgb888_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i smask0 = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i smask1 = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pmask = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m256i s0 = _mm256_shuffle_epi8(
+                load_rgb888x2(srcp + 3 * x), smask0);
+            __m256i s1 = _mm256_shuffle_epi8(
+                load_rgb888x2(srcp + 3 * x + 24), smask0);
+            s0 = _mm256_shuffle_epi8(bl_h_rgba_avx2(s0, s1, zero), smask1);
+            storeu256(dstp + 3 * x / 2, _mm256_permutevar8x32_epi32(s0, pmask));
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_v_rgb888_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    bilinear_v_grey_avx2<false, true>(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+#endif // __AVX2__
+
+#endif  // BILINEAR_FUNCTIONS_AVX2_H
@@ -0,0 +1,241 @@
+/*
+    bilinear_functions_avx512.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef BILINEAR_FUNCTIONS_AVX512_H
+#define BILINEAR_FUNCTIONS_AVX512_H
+
+#include "rh_common.h"
+
+#if defined(__AVX512BW__) && defined(__AVX512VBMI__)
+
+// Row tails are processed with masked loads/stores, so these kernels never
+// touch memory beyond the rows.
+
+// Bilinear Resize for RGBA
+template <bool STREAM>
+static void bilinear_hv_rgba_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+    const ptrdiff_t rowsize = w * 4;
+
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = _mm512_setr_epi32(
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd = _mm512_setr_epi32(
+        1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (ptrdiff_t x = 0; x < rowsize; x += 128) {
+            __m512i s0 = _mm512_avg_epu8(
+                load512(srcp + x, rowsize - x), load512(sb + x, rowsize - x));
+            __m512i s1 = _mm512_avg_epu8(
+                load512(srcp + x + 64, rowsize - x - 64),
+                load512(sb + x + 64, rowsize - x - 64));
+            __m512i ret = _mm512_avg_epu8(
+                _mm512_permutex2var_epi32(s0, even, s1),
+                _mm512_subs_epu8(_mm512_permutex2var_epi32(s0, odd, s1), one));
+            store512<STREAM>(dstp + x / 2, ret, (rowsize - x) / 2);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool STREAM>
+static void bilinear_h_rgba_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = (width & ~1) * 4;
+    const __m512i even = _mm512_setr_epi32(
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd = _mm512_setr_epi32(
+        1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (ptrdiff_t x = 0; x < rowsize; x += 128) {
+            __m512i s0 = load512(srcp + x, rowsize - x);
+            __m512i s1 = load512(srcp + x + 64, rowsize - x - 64);
+            __m512i ret = _mm512_avg_epu8(
+                _mm512_permutex2var_epi32(s0, even, s1),
+                _mm512_permutex2var_epi32(s0, odd, s1));
+            store512<STREAM>(dstp + x / 2, ret, (rowsize - x) / 2);
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// Bilinear Resize for GREY8
+template <bool STREAM>
+static void bilinear_hv_grey_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t w = width & ~1;
+    auto h = height & ~1;
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = load_idx(grey_even_idx);
+    const __m512i odd = load_idx(grey_odd_idx);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (ptrdiff_t x = 0; x < w; x += 128) {
+            __m512i s0 = _mm512_avg_epu8(
+                load512(srcp + x, w - x), load512(sb + x, w - x));
+            __m512i s1 = _mm512_avg_epu8(
+                load512(srcp + x + 64, w - x - 64),
+                load512(sb + x + 64, w - x - 64));
+            __m512i ret = _mm512_avg_epu8(
+                _mm512_permutex2var_epi8(s0, even, s1),
+                _mm512_subs_epu8(_mm512_permutex2var_epi8(s0, odd, s1), one));
+            store512<STREAM>(dstp + x / 2, ret, (w - x) / 2);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool STREAM>
+static void bilinear_h_grey_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t w = width & ~1;
+    const __m512i even = load_idx(grey_even_idx);
+    const __m512i odd = load_idx(grey_odd_idx);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (ptrdiff_t x = 0; x < w; x += 128) {
+            __m512i s0 = load512(srcp + x, w - x);
+            __m512i s1 = load512(srcp + x + 64, w - x - 64);
+            __m512i ret = _mm512_avg_epu8(
+                _mm512_permutex2var_epi8(s0, even, s1),
+                _mm512_permutex2var_epi8(s0, odd, s1));
+            store512<STREAM>(dstp + x / 2, ret, (w - x) / 2);
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// width is the number of bytes in a row.
+template <bool STREAM>
+static void bilinear_v_grey_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto h = height & ~1;
+    const ptrdiff_t w = width;
+
+    for (size_t y = 0; y < h; y += 2) {
+        for (ptrdiff_t x = 0; x < w; x += 64) {
+            __m512i ret = _mm512_avg_epu8(
+                load512(srcp + x, w - x), load512(srcp + x + sstride, w - x));
+            store512<STREAM>(dstp + x, ret, w - x);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool STREAM>
+static void bilinear_v_rgba_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    bilinear_v_grey_avx512<STREAM>(srcp, dstp, width * 4, height, sstride, dstride);
+}
+
+
+// Bilinear Resize for RGB888
+// 32 pixels are deinterleaved into even/odd RGBA pixels with vpermb.
+static void bilinear_hv_rgb888_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = (width & ~1) * 3;
+    auto h = height & ~1;
+
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = load_idx(rgb888_even_idx);
+    const __m512i odd = load_idx(rgb888_odd_idx);
+    const __m512i pack = load_idx(rgb888_pack_idx);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (ptrdiff_t x = 0; x < rowsize; x += 96) {
+            __m512i s0 = _mm512_avg_epu8(
+                load512(srcp + x, rowsize - x), load512(sb + x, rowsize - x));
+            __m512i s1 = _mm512_avg_epu8(
+                load512(srcp + x + 64, rowsize - x - 64),
+                load512(sb + x + 64, rowsize - x - 64));
+            __m512i ret = _mm512_avg_epu8(
+                _mm512_permutex2var_epi8(s0, even, s1),
+                _mm512_subs_epu8(_mm512_permutex2var_epi8(s0, odd, s1), one));
+            ret = _mm512_permutexvar_epi8(pack, ret);
+            storeu512(dstp + x / 2, ret, std::min<ptrdiff_t>((rowsize - x) / 2, 48));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_h_rgb888_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = (width & ~1) * 3;
+    const __m512i even = load_idx(rgb888_even_idx);
+    const __m512i odd = load_idx(rgb888_odd_idx);
+    const __m512i pack = load_idx(rgb888_pack_idx);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (ptrdiff_t x = 0; x < rowsize; x += 96) {
+            __m512i s0 = load512(srcp + x, rowsize - x);
+            __m512i s1 = load512(srcp + x + 64, rowsize - x - 64);
+            __m512i ret = _mm512_avg_epu8(
+                _mm512_permutex2var_epi8(s0, even, s1),
+                _mm512_permutex2var_epi8(s0, odd, s1));
+            ret = _mm512_permutexvar_epi8(pack, ret);
+            storeu512(dstp + x / 2, ret, std::min<ptrdiff_t>((rowsize - x) / 2, 48));
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_v_rgb888_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    bilinear_v_grey_avx512<true>(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+#endif // __AVX512BW__ && __AVX512VBMI__
+
+#endif  // BILINEAR_FUNCTIONS_AVX512_H
@@ -0,0 +1,217 @@
+/*
+    bilinear_functions_float.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef BILINEAR_FUNCTIONS_FLOAT_H
+#define BILINEAR_FUNCTIONS_FLOAT_H
+
+#include "rh_common.h"
+
+// Kernels for GREYF32, RGBF32 and RGBAF32. CH is the number of channels.
+// Vertical pairs are added first in both C and SIMD, so the results are the same.
+
+
+// Bilinear Resize for float formats (no SIMD)
+template <int CH>
+static void bilinear_hv_float_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH;
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sa = reinterpret_cast<const float*>(srcp);
+        auto sb = reinterpret_cast<const float*>(srcp + sstride);
+        auto d = reinterpret_cast<float*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = x + c;
+                d[x / 2 + c] = ((sa[p] + sb[p]) + (sa[p + CH] + sb[p + CH])) * 0.25f;
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void bilinear_h_float_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH;
+
+    for (size_t y = 0; y < height; ++y) {
+        auto s = reinterpret_cast<const float*>(srcp);
+        auto d = reinterpret_cast<float*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                d[x / 2 + c] = (s[x + c] + s[x + CH + c]) * 0.5f;
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void bilinear_v_float_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH;
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sa = reinterpret_cast<const float*>(srcp);
+        auto sb = reinterpret_cast<const float*>(srcp + sstride);
+        auto d = reinterpret_cast<float*>(dstp);
+        for (size_t x = 0; x < w; ++x) {
+            d[x] = (sa[x] + sb[x]) * 0.5f;
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+#if defined(__SSE2__)
+
+// Bilinear Resize for GREYF32 (CH = 1) and RGBAF32 (CH = 4)
+template <int CH, bool ALIGNED, bool STREAM>
+static void bilinear_hv_float(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH * 4;
+    auto h = height & ~1;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 32) {
+            __m128 a = _mm_add_ps(load_ps<ALIGNED>(srcp + x), load_ps<ALIGNED>(sb + x));
+            __m128 b = _mm_add_ps(
+                load_ps<ALIGNED>(srcp + x + 16), load_ps<ALIGNED>(sb + x + 16));
+            __m128 r = _mm_add_ps(first_ps<CH>(a, b), second_ps<CH>(a, b));
+            store_ps<STREAM>(dstp + x / 2, _mm_mul_ps(r, quarter));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void bilinear_h_float(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width & ~1) * CH * 4;
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 32) {
+            __m128 a = load_ps<ALIGNED>(srcp + x);
+            __m128 b = load_ps<ALIGNED>(srcp + x + 16);
+            __m128 r = _mm_add_ps(first_ps<CH>(a, b), second_ps<CH>(a, b));
+            store_ps<STREAM>(dstp + x / 2, _mm_mul_ps(r, half));
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// CH = 3 is also fine.
+template <int CH, bool ALIGNED, bool STREAM>
+static void bilinear_v_float(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH * 4;
+    auto h = height & ~1;
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (size_t y = 0; y < h; y += 2) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m128 r = _mm_add_ps(
+                load_ps<ALIGNED>(srcp + x), load_ps<ALIGNED>(srcp + x + sstride));
+            store_ps<STREAM>(dstp + x, _mm_mul_ps(r, half));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+// Bilinear Resize for RGBF32
+// A pixel is loaded with the first sample of the next one, so the last pixels
+// of each row are left to the C kernel not to read beyond the row. The C
+// kernel also overwrites the junk sample stored after the last pixel made here.
+static void bilinear_hv_rgbf32(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 2) / 2;
+    auto h = height & ~1;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = s + sstride;
+        for (size_t x = 0; x < n; ++x) {
+            __m128 a = _mm_add_ps(load_ps<false>(s + 24 * x), load_ps<false>(sb + 24 * x));
+            __m128 b = _mm_add_ps(
+                load_ps<false>(s + 24 * x + 12), load_ps<false>(sb + 24 * x + 12));
+            _mm_storeu_ps(reinterpret_cast<float*>(d + 12 * x),
+                          _mm_mul_ps(_mm_add_ps(a, b), quarter));
+        }
+        s += 2 * sstride;
+        d += dstride;
+    }
+    bilinear_hv_float_c<3>(
+        srcp + 24 * n, dstp + 12 * n, width - 2 * n, height, sstride, dstride);
+}
+
+
+static void bilinear_h_rgbf32(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 2) / 2;
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < n; ++x) {
+            __m128 r = _mm_add_ps(load_ps<false>(s + 24 * x), load_ps<false>(s + 24 * x + 12));
+            _mm_storeu_ps(reinterpret_cast<float*>(d + 12 * x), _mm_mul_ps(r, half));
+        }
+        s += sstride;
+        d += dstride;
+    }
+    bilinear_h_float_c<3>(
+        srcp + 24 * n, dstp + 12 * n, width - 2 * n, height, sstride, dstride);
+}
+
+#endif // __SSE2__
+
+#endif // BILINEAR_FUNCTIONS_FLOAT_H
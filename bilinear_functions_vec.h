@@ -0,0 +1,207 @@
+/*
+    bilinear_functions_vec.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef BILINEAR_FUNCTIONS_VEC_H
+#define BILINEAR_FUNCTIONS_VEC_H
+
+#include "rh_common.h"
+
+#if defined(RH_VECTOR_EXT)
+
+// These are the same as the SSE2/SSSE3 kernels, written with generic vectors.
+
+// Bilinear Resize for RGBA
+static F_INLINE vu8x16 bl_h_rgba_vec(
+    const vu8x16& a, const vu8x16& b, const vu8x16& bias)
+{
+    vu8x16 even = RH_SHUFFLE(a, b,
+        0, 1, 2, 3, 8, 9, 10, 11, 16, 17, 18, 19, 24, 25, 26, 27);
+    vu8x16 odd = RH_SHUFFLE(a, b,
+        4, 5, 6, 7, 12, 13, 14, 15, 20, 21, 22, 23, 28, 29, 30, 31);
+    return avgv(even, subsv(odd, bias));
+}
+
+
+static void bilinear_hv_rgba_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 8) {
+            vu8x16 s0 = avgv(loadv(srcp + 4 * x), loadv(sb + 4 * x));
+            vu8x16 s1 = avgv(loadv(srcp + 4 * x + 16), loadv(sb + 4 * x + 16));
+            storev(dstp + 2 * x, bl_h_rgba_vec(s0, s1, one));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_h_rgba_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    const vu8x16 zero = setv(0);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 8) {
+            vu8x16 ret = bl_h_rgba_vec(
+                loadv(srcp + 4 * x), loadv(srcp + 4 * x + 16), zero);
+            storev(dstp + 2 * x, ret);
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// width is the number of bytes in a row.
+static void bilinear_v_grey_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto h = height & ~1;
+
+    for (size_t y = 0; y < h; y += 2) {
+        for (size_t x = 0; x < width; x += 16) {
+            storev(dstp + x, avgv(loadv(srcp + x), loadv(srcp + x + sstride)));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_v_rgba_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    bilinear_v_grey_vec(srcp, dstp, width * 4, height, sstride, dstride);
+}
+
+
+// Bilinear Resize for GREY8
+static F_INLINE vu8x16 bl_h_grey_vec(
+    const vu8x16& l0, const vu8x16& l1, const vu8x16& bias)
+{
+    vu8x16 even = RH_SHUFFLE(l0, l1,
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    vu8x16 odd = RH_SHUFFLE(l0, l1,
+        1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    return avgv(even, subsv(odd, bias));
+}
+
+
+static void bilinear_hv_grey_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 32) {
+            vu8x16 s0 = avgv(loadv(srcp + x), loadv(sb + x));
+            vu8x16 s1 = avgv(loadv(srcp + x + 16), loadv(sb + x + 16));
+            storev(dstp + x / 2, bl_h_grey_vec(s0, s1, one));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_h_grey_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    const vu8x16 zero = setv(0);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 32) {
+            vu8x16 ret = bl_h_grey_vec(
+                loadv(srcp + x), loadv(srcp + x + 16), zero);
+            storev(dstp + x / 2, ret);
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// Bilinear Resize for RGB888
+static void bilinear_hv_rgb888_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    auto h = height & ~1;
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < h; y += 2) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 8) {
+            vu8x16 s0 = avgv(loadv(srcp + 3 * x), loadv(sb + 3 * x));
+            vu8x16 s1 = avgv(loadv(srcp + 3 * x + 12), loadv(sb + 3 * x + 12));
+            s0 = bl_h_rgba_vec(expand_rgb888_vec(s0), expand_rgb888_vec(s1), one);
+            storev(dstp + 3 * x / 2, pack_rgb888_vec(s0));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_h_rgb888_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width & ~1;
+    const vu8x16 zero = setv(0);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 8) {
+            vu8x16 s0 = expand_rgb888_vec(loadv(srcp + 3 * x));
+            vu8x16 s1 = expand_rgb888_vec(loadv(srcp + 3 * x + 12));
+            storev(dstp + 3 * x / 2, pack_rgb888_vec(bl_h_rgba_vec(s0, s1, zero)));
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void bilinear_v_rgb888_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    bilinear_v_grey_vec(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+#endif // RH_VECTOR_EXT
+
+#endif // BILINEAR_FUNCTIONS_VEC_H
@@ -0,0 +1,262 @@
+/*
+    convert_functions.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef CONVERT_FUNCTIONS_H
+#define CONVERT_FUNCTIONS_H
+
+#include "rh_common.h"
+
+// Kernels of setConversion(), for the rows just reduced. width is the number of
+// pixels. Nothing after the rowsizes of src and dst is read or written: the last
+// pixels of each row, which are not a whole vector, are left to C.
+// Grey is (77R + 150G + 29B + 128) >> 8 (BT.601) on SIMD as well.
+
+
+static F_INLINE uint8_t grey_c(const uint8_t* s)
+{
+    return static_cast<uint8_t>((77 * s[0] + 150 * s[1] + 29 * s[2] + 128) >> 8);
+}
+
+
+// Conversions (no SIMD). x0 is the first pixel to convert.
+static void rgb888_to_rgba_row_c(const uint8_t* s, uint8_t* d, const size_t x0,
+                                 const size_t width) noexcept
+{
+    for (size_t x = x0; x < width; ++x) {
+        d[4 * x + 0] = s[3 * x + 0];
+        d[4 * x + 1] = s[3 * x + 1];
+        d[4 * x + 2] = s[3 * x + 2];
+        d[4 * x + 3] = 0xFF;
+    }
+}
+
+
+template <int CH>
+static void to_grey_row_c(const uint8_t* s, uint8_t* d, const size_t x0,
+                          const size_t width) noexcept
+{
+    for (size_t x = x0; x < width; ++x) {
+        d[x] = grey_c(s + CH * x);
+    }
+}
+
+
+template <int CH>
+static void swap_rb_row_c(const uint8_t* s, uint8_t* d, const size_t x0,
+                          const size_t width) noexcept
+{
+    for (size_t x = x0; x < width; ++x) {
+        const uint8_t r = s[CH * x];
+        d[CH * x + 0] = s[CH * x + 2];
+        d[CH * x + 1] = s[CH * x + 1];
+        d[CH * x + 2] = r;
+        if (CH == 4) {
+            d[CH * x + 3] = s[CH * x + 3];
+        }
+    }
+}
+
+
+static void convert_rgb888_to_rgba_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < height; ++y) {
+        rgb888_to_rgba_row_c(srcp, dstp, 0, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void convert_to_grey_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < height; ++y) {
+        to_grey_row_c<CH>(srcp, dstp, 0, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void convert_swap_rb_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < height; ++y) {
+        swap_rb_row_c<CH>(srcp, dstp, 0, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+#if defined(__SSE2__)
+
+// Grey of 4 RGBA pixels, in 32bit.
+static F_INLINE __m128i grey_rgba(const __m128i& v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coef = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+    // RG and BA of each pixel
+    __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(v, zero), coef));
+    __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(v, zero), coef));
+    __m128i sum = _mm_add_epi32(
+        _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))),
+        _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))));
+    return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+}
+
+
+static F_INLINE __m128i pack_grey(const __m128i& a, const __m128i& b,
+                                  const __m128i& c, const __m128i& d)
+{
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+
+// RGBA8888 to GREY8
+static void convert_rgba_to_grey(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t w = width & ~static_cast<size_t>(15);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 16) {
+            const uint8_t* s = srcp + 4 * x;
+            storeu(dstp + x, pack_grey(
+                grey_rgba(load<false>(s)), grey_rgba(load<false>(s + 16)),
+                grey_rgba(load<false>(s + 32)), grey_rgba(load<false>(s + 48))));
+        }
+        to_grey_row_c<4>(srcp, dstp, w, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// RGBA8888 to BGRA8888 and back
+static void convert_swap_rb_rgba(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t w = width & ~static_cast<size_t>(3);
+    const __m128i ga = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+    const __m128i lsb = _mm_set1_epi32(0xFF);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 4) {
+            __m128i v = load<false>(srcp + 4 * x);
+            __m128i rb = _mm_or_si128(
+                _mm_and_si128(_mm_srli_epi32(v, 16), lsb),
+                _mm_slli_epi32(_mm_and_si128(v, lsb), 16));
+            storeu(dstp + 4 * x, _mm_or_si128(_mm_and_si128(v, ga), rb));
+        }
+        swap_rb_row_c<4>(srcp, dstp, w, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+#if defined(__SSSE3__)
+// Kernels of RGB888 load 16 bytes for 4 pixels (12 bytes), so the last
+// 2 pixels at least are left to C.
+static F_INLINE size_t rgb888_simd_width(const size_t width)
+{
+    return width < 2 ? 0 : (width - 2) & ~static_cast<size_t>(3);
+}
+
+
+static F_INLINE __m128i expand_rgb888(const uint8_t* s)
+{
+    const __m128i smask0 = _mm_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    return _mm_shuffle_epi8(load<false>(s), smask0);
+}
+
+
+// RGB888 to RGBA8888 of alpha 255
+static void convert_rgb888_to_rgba(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t w = rgb888_simd_width(width);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 4) {
+            storeu(dstp + 4 * x, _mm_or_si128(expand_rgb888(srcp + 3 * x), alpha));
+        }
+        rgb888_to_rgba_row_c(srcp, dstp, w, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// RGB888 to GREY8
+static void convert_rgb888_to_grey(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t w = width < 18 ? 0 : (width - 2) & ~static_cast<size_t>(15);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 16) {
+            const uint8_t* s = srcp + 3 * x;
+            storeu(dstp + x, pack_grey(
+                grey_rgba(expand_rgb888(s)), grey_rgba(expand_rgb888(s + 12)),
+                grey_rgba(expand_rgb888(s + 24)), grey_rgba(expand_rgb888(s + 36))));
+        }
+        to_grey_row_c<3>(srcp, dstp, w, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// RGB888 to BGR888 and back. 12 bytes are stored for 4 pixels in 2 overlapped stores.
+static void convert_swap_rb_rgb888(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t w = rgb888_simd_width(width);
+    const __m128i smask = _mm_setr_epi8(
+        2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 4) {
+            __m128i v = _mm_shuffle_epi8(load<false>(srcp + 3 * x), smask);
+            uint8_t* d = dstp + 3 * x;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d), v);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 4), _mm_srli_si128(v, 4));
+        }
+        swap_rb_row_c<3>(srcp, dstp, w, width);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+#endif // __SSSE3__
+
+#endif // __SSE2__
+
+#endif // CONVERT_FUNCTIONS_H
@@ -22,27 +22,24 @@
 #if defined(__SSE2__)
 
 // ReduceBy2 helper
-#if 1
+// (s0 + 2 * s1 + s2 + 2) / 4. The result may be smaller by 1 unless EXACT.
+template <bool EXACT = false>
 static F_INLINE __m128i red_by_2(
     const __m128i& s0, const __m128i& s1, const __m128i& s2, const __m128i& one)
-{
-    return _mm_avg_epu8(
-        _mm_avg_epu8(s0, s1), _mm_subs_epu8(_mm_avg_epu8(s2, s1), one));
-}
-#else
-static F_INLINE __m128i red_by_2(   // accurate version
-    const __m128i& s0, const __m128i& s1, const __m128i& s2, const __m128i& one)
 {
     __m128i t0 = _mm_avg_epu8(s0, s1);
     __m128i t1 = _mm_avg_epu8(s2, s1);
+    if (!EXACT) {
+        return _mm_avg_epu8(t0, _mm_subs_epu8(t1, one));
+    }
     __m128i error = _mm_or_si128(_mm_xor_si128(s0, s1), _mm_xor_si128(s2, s1));
     __m128i err2 = _mm_xor_si128(t0, t1);
     error = _mm_and_si128(_mm_and_si128(error, err2), one);
     return _mm_subs_epu8(_mm_avg_epu8(t0, t1), error);
 }
-#endif
 
 // ReduceBy2 for RGBA
+template <bool EXACT = false>
 static F_INLINE __m128i red_by_2_h_rgba(
     const __m128i& _l, const __m128i& _c, const __m128i& _r, const __m128i& one)
 {
@@ -55,14 +52,14 @@ static F_INLINE __m128i red_by_2_h_rgba(
 #else
     __m128i r = _mm_or_si128(_mm_srli_si128(l, 4), _mm_slli_si128(_r, 12));
 #endif
-    return red_by_2(l, c, r, one);
+    return red_by_2<EXACT>(l, c, r, one);
 }
 
 
-template <bool ALIGNED>
+template <bool ALIGNED, bool STREAM>
 static void reduceby2_hv_rgba(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
 
@@ -82,7 +79,7 @@ static void reduceby2_hv_rgba(
                 load<ALIGNED>(sc + 4 * x + 32), one);
 
             center = red_by_2_h_rgba(left, center, right, one);
-            stream(dstp + 2 * x, center);
+            store<STREAM>(dstp + 2 * x, center);
 
             left = right;
         }
@@ -120,10 +117,10 @@ static void reduceby2_hv_rgba(
 }
 
 
-template <bool ALIGNED>
+template <bool ALIGNED, bool STREAM, bool EXACT = false>
 static void reduceby2_h_rgba(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
 
@@ -132,8 +129,8 @@ static void reduceby2_h_rgba(
         for (size_t x = 0; x < width - 2; x += 8) {
             __m128i s1 = load<ALIGNED>(srcp + 4 * x + 16);
             __m128i s2 = load<ALIGNED>(srcp + 4 * x + 32);
-            __m128i ret = red_by_2_h_rgba(s0, s1, s2, one);
-            stream(dstp + 2 * x, ret);
+            __m128i ret = red_by_2_h_rgba<EXACT>(s0, s1, s2, one);
+            store<STREAM>(dstp + 2 * x, ret);
             s0 = s2;
         }
         if ((width & 1) == 0) {
@@ -147,20 +144,20 @@ static void reduceby2_h_rgba(
 }
 
 
-template <bool ALIGNED>
+template <bool ALIGNED, bool STREAM, bool EXACT = false>
 static void reduceby2_v_rgba(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
 
     for (size_t y = 0; y < height - 2; y += 2) {
         for (size_t x = 0; x < width; x += 4) {
-            __m128i ret = red_by_2(
+            __m128i ret = red_by_2<EXACT>(
                 load<ALIGNED>(srcp + 4 * x),
                 load<ALIGNED>(srcp + 4 * x + sstride),
                 load<ALIGNED>(srcp + 4 * x + sstride * 2), one);
-            stream(dstp + 4 * x, ret);
+            store<STREAM>(dstp + 4 * x, ret);
         }
         srcp += 2 * sstride;
         dstp += dstride;
@@ -170,14 +167,15 @@ static void reduceby2_v_rgba(
         for (size_t x = 0; x < width; x += 4) {
             __m128i s0 = load<ALIGNED>(srcp + 4 * x);
             __m128i s1 = load<ALIGNED>(srcp + 4 * x + sstride);
-            s1 = red_by_2(s0, s1, s1, one);
-            stream(dstp + 4 * x, s1);
+            s1 = red_by_2<EXACT>(s0, s1, s1, one);
+            store<STREAM>(dstp + 4 * x, s1);
         }
     }
 }
 
 
 // ReduceBy2 for GREY8
+template <bool EXACT = false>
 static F_INLINE __m128i red_by_2_h_grey(
     const __m128i& l0, const __m128i& l1, const __m128i& l2, const __m128i& mask,
     const __m128i& one)
@@ -189,14 +187,14 @@ static F_INLINE __m128i red_by_2_h_grey(
 #else
     __m128i r = _mm_or_si128(_mm_srli_si128(l, 1), _mm_slli_si128(l2, 15));
 #endif
-    return red_by_2(l, m , r, one);
+    return red_by_2<EXACT>(l, m, r, one);
 }
 
 
-template <bool ALIGNED>
+template <bool ALIGNED, bool STREAM>
 static void reduceby2_hv_grey(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
     const __m128i mask = _mm_set1_epi16(0x00FF);
@@ -217,7 +215,7 @@ static void reduceby2_hv_grey(
                 load<ALIGNED>(sc + x + 32), one);
 
             center = red_by_2_h_grey(left, center, right, mask, one);
-            stream(dstp + x / 2, center);
+            store<STREAM>(dstp + x / 2, center);
 
             left = right;
         }
@@ -239,7 +237,7 @@ static void reduceby2_hv_grey(
         __m128i s1 = load<ALIGNED>(sb);
         __m128i left = red_by_2(s0, s1, s1, one);
 
-        for (size_t x = 0; x < width; x += 32) {
+        for (size_t x = 0; x < width - 2; x += 32) {
             s0 = load<ALIGNED>(srcp + x + 16);
             s1 = load<ALIGNED>(sb + x + 16);
             __m128i center = red_by_2(s0, s1, s1, one);
@@ -249,7 +247,7 @@ static void reduceby2_hv_grey(
             __m128i right = red_by_2(s0, s1, s1, one);
 
             center = red_by_2_h_grey(left, center, right, mask, one);
-            stream(dstp + x / 2, center);
+            store<STREAM>(dstp + x / 2, center);
 
             left = right;
         }
@@ -262,10 +260,10 @@ static void reduceby2_hv_grey(
 }
 
 
-template <bool ALIGNED>
+template <bool ALIGNED, bool STREAM, bool EXACT = false>
 static void reduceby2_h_grey(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
     const __m128i mask = _mm_set1_epi16(0x00FF);
@@ -276,9 +274,9 @@ static void reduceby2_h_grey(
         for (size_t x = 0; x < width - 2; x += 32) {
             __m128i center = load<ALIGNED>(srcp + x + 16);
             __m128i right = load<ALIGNED>(srcp + x + 32);
-            center = red_by_2_h_grey(left, center, right, mask, one);
-            stream(dstp + x / 2, center);
-            left = center;
+            center = red_by_2_h_grey<EXACT>(left, center, right, mask, one);
+            store<STREAM>(dstp + x / 2, center);
+            left = right;
         }
         if ((width & 1) == 0) {
             dstp[width / 2 - 1] = (
@@ -290,20 +288,20 @@ static void reduceby2_h_grey(
 }
 
 
-template <bool ALIGNED>
+template <bool ALIGNED, bool STREAM, bool EXACT = false>
 static void reduceby2_v_grey(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
 
     for (size_t y = 0; y < height - 2; y += 2) {
         for (size_t x = 0; x < width; x += 16) {
-            __m128i ret = red_by_2(
+            __m128i ret = red_by_2<EXACT>(
                 load<ALIGNED>(srcp + x),
                 load<ALIGNED>(srcp + x + sstride),
                 load<ALIGNED>(srcp + x + 2 * sstride), one);
-            stream(dstp + x, ret);
+            store<STREAM>(dstp + x, ret);
         }
         srcp += 2 * sstride;
         dstp += dstride;
@@ -313,18 +311,147 @@ static void reduceby2_v_grey(
         for (size_t x = 0; x < width; x += 16) {
             __m128i s0 = load<ALIGNED>(srcp + x);
             __m128i s1 = load<ALIGNED>(srcp + x + sstride);
-            __m128i ret = red_by_2(s0, s1, s1, one);
-            stream(dstp + x, ret);
+            __m128i ret = red_by_2<EXACT>(s0, s1, s1, one);
+            store<STREAM>(dstp + x, ret);
         }
     }
 }
 
 
+// ReduceBy2 for UV88
+template <bool EXACT = false>
+static F_INLINE __m128i red_by_2_h_uv(
+    const __m128i& _l, const __m128i& _c, const __m128i& _r, const __m128i& one)
+{
+    __m128i t0 = even_odd_uv(_l);
+    __m128i t1 = even_odd_uv(_c);
+    __m128i l = _mm_unpacklo_epi64(t0, t1);
+    __m128i c = _mm_unpackhi_epi64(t0, t1);
+#if defined(__SSSE3__)
+    __m128i r = _mm_alignr_epi8(_r, l, 2);
+#else
+    __m128i r = _mm_or_si128(_mm_srli_si128(l, 2), _mm_slli_si128(_r, 14));
+#endif
+    return red_by_2<EXACT>(l, c, r, one);
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_hv_uv(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m128i one = _mm_set1_epi8(1);
+    auto w2 = 2 * (width - 2);
+    auto w1 = w2 + 2;
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m128i left = red_by_2(
+            load<ALIGNED>(srcp), load<ALIGNED>(sb), load<ALIGNED>(sc), one);
+
+        for (size_t x = 0; x < width - 2; x += 16) {
+            __m128i center = red_by_2(
+                load<ALIGNED>(srcp + 2 * x + 16), load<ALIGNED>(sb + 2 * x + 16),
+                load<ALIGNED>(sc + 2 * x + 16), one);
+
+            __m128i right = red_by_2(
+                load<ALIGNED>(srcp + 2 * x + 32), load<ALIGNED>(sb + 2 * x + 32),
+                load<ALIGNED>(sc + 2 * x + 32), one);
+
+            center = red_by_2_h_uv(left, center, right, one);
+            store<STREAM>(dstp + x, center);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < 2; ++c) {
+                dstp[width - 2 + c] = (
+                    srcp[w2 + c] + 3 * srcp[w1 + c] +
+                    2 * sb[w2 + c] + 6 * sb[w1 + c] +
+                    sc[w2 + c] + 3 * sc[w1 + c] + 8) / 16;
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        __m128i s0 = load<ALIGNED>(srcp);
+        __m128i s1 = load<ALIGNED>(sb);
+        __m128i left = red_by_2(s0, s1, s1, one);
+
+        for (size_t x = 0; x < width - 2; x += 16) {
+            s0 = load<ALIGNED>(srcp + 2 * x + 16);
+            s1 = load<ALIGNED>(sb + 2 * x + 16);
+            __m128i center = red_by_2(s0, s1, s1, one);
+
+            s0 = load<ALIGNED>(srcp + 2 * x + 32);
+            s1 = load<ALIGNED>(sb + 2 * x + 32);
+            __m128i right = red_by_2(s0, s1, s1, one);
+
+            center = red_by_2_h_uv(left, center, right, one);
+            store<STREAM>(dstp + x, center);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < 2; ++c) {
+                dstp[width - 2 + c] = (
+                    srcp[w2 + c] + 3 * srcp[w1 + c] +
+                    3 * sb[w2 + c] + 9 * sb[w1 + c] + 8) / 16;
+            }
+        }
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM, bool EXACT = false>
+static void reduceby2_h_uv(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m128i one = _mm_set1_epi8(1);
+    auto w2 = 2 * (width - 2);
+    auto w1 = w2 + 2;
+
+    for (size_t y = 0; y < height; ++y) {
+        __m128i left = load<ALIGNED>(srcp);
+
+        for (size_t x = 0; x < width - 2; x += 16) {
+            __m128i center = load<ALIGNED>(srcp + 2 * x + 16);
+            __m128i right = load<ALIGNED>(srcp + 2 * x + 32);
+            center = red_by_2_h_uv<EXACT>(left, center, right, one);
+            store<STREAM>(dstp + x, center);
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < 2; ++c) {
+                dstp[width - 2 + c] = (srcp[w2 + c] + 3 * srcp[w1 + c] + 2) / 4;
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM, bool EXACT = false>
+static void reduceby2_v_uv(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey<ALIGNED, STREAM, EXACT>(srcp, dstp, width * 2, height, sstride, dstride);
+}
+
+
 // ReduceBy2 for RGB888
 #if defined(__SSSE3__)
 static void reduceby2_hv_rgb888(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
     const __m128i smask0 = _mm_setr_epi8(
@@ -373,16 +500,16 @@ static void reduceby2_hv_rgb888(
         auto sb = srcp + sstride;
         __m128i s0 = load<false>(srcp);
         __m128i s1 = load<false>(sb);
-        __m128i left = red_by_2(s0, s1, s1, one);
+        __m128i left = _mm_shuffle_epi8(red_by_2(s0, s1, s1, one), smask0);
 
         for (size_t x = 0; x < width - 2; x += 8) {
             s0 = load<false>(srcp + 3 * x + 12);
             s1 = load<false>(sb + 3 * x + 12);
-            __m128i center = red_by_2(s0, s1, s1, one);
+            __m128i center = _mm_shuffle_epi8(red_by_2(s0, s1, s1, one), smask0);
 
-            s0 = load<false>(srcp + 3 * x + 32);
-            s1 = load<false>(sb + 3 * x + 32);
-            __m128i right = red_by_2(s0, s1, s1, one);
+            s0 = load<false>(srcp + 3 * x + 24);
+            s1 = load<false>(sb + 3 * x + 24);
+            __m128i right = _mm_shuffle_epi8(red_by_2(s0, s1, s1, one), smask0);
 
             center = _mm_shuffle_epi8(
                 red_by_2_h_rgba(left, center, right, one), smask1);
@@ -401,9 +528,10 @@ static void reduceby2_hv_rgb888(
 }
 
 
+template <bool EXACT = false>
 static void reduceby2_h_rgb888(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     const __m128i one = _mm_set1_epi8(1);
     const __m128i smask0 = _mm_setr_epi8(
@@ -416,7 +544,7 @@ static void reduceby2_h_rgb888(
         for (size_t x = 0; x < width - 2; x += 8) {
             __m128i s1 = _mm_shuffle_epi8(load<false>(srcp + 3 * x + 12), smask0);
             __m128i s2 = _mm_shuffle_epi8(load<false>(srcp + 3 * x + 24), smask0);
-            __m128i ret = _mm_shuffle_epi8(red_by_2_h_rgba(s0, s1, s2, one), smask1);
+            __m128i ret = _mm_shuffle_epi8(red_by_2_h_rgba<EXACT>(s0, s1, s2, one), smask1);
             storeu(dstp + 3 * x / 2, ret);
             s0 = s2;
         }
@@ -431,20 +559,197 @@ static void reduceby2_h_rgb888(
 }
 #endif  // __SSSE3__
 
+template <bool EXACT = false>
 static void reduceby2_v_rgb888(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey<false, true, EXACT>(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+
+// ReduceBy2 for 8bit formats with exact rounding (REDUCE_BY_2_EXACT)
+// Sums are taken in 16bit, so the results are the same as C ones.
+// Only hv needs them. h and v are made by red_by_2<true>.
+
+// a + 2b + c of the lower and higher halves in 16bit.
+static F_INLINE void red_by_2_v_exact(
+    const __m128i& a, const __m128i& b, const __m128i& c, __m128i& lo, __m128i& hi)
 {
-    reduceby2_v_grey<false>(srcp, dstp, width * 3, height, sstride, dstride);
+    const __m128i zero = _mm_setzero_si128();
+    lo = _mm_add_epi16(
+        _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero)),
+        _mm_slli_epi16(_mm_unpacklo_epi8(b, zero), 1));
+    hi = _mm_add_epi16(
+        _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero)),
+        _mm_slli_epi16(_mm_unpackhi_epi8(b, zero), 1));
 }
 
+
+// (l + 2c + r + 8) / 16 of the pixel pairs in v0 and v1 (summed vertically),
+// where l, c are the pixels of a pair and r is the next one. v2 follows v1.
+// CH is the number of channels (GREY8: 1, UV88: 2, RGBA8888: 4).
+template <int CH>
+static F_INLINE __m128i red_by_2_h_exact(
+    const __m128i& v0, const __m128i& v1, const __m128i& v2, const __m128i& eight)
+{
+    __m128i l, c;
+    if (CH == 1) {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+        l = _mm_packs_epi32(_mm_and_si128(v0, mask), _mm_and_si128(v1, mask));
+        c = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+    } else {
+        __m128i t0 = CH == 2 ? _mm_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 2, 0)) : v0;
+        __m128i t1 = CH == 2 ? _mm_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 2, 0)) : v1;
+        l = _mm_unpacklo_epi64(t0, t1);
+        c = _mm_unpackhi_epi64(t0, t1);
+    }
+#if defined(__SSSE3__)
+    __m128i r = _mm_alignr_epi8(v2, l, 2 * CH);
+#else
+    __m128i r = _mm_or_si128(_mm_srli_si128(l, 2 * CH), _mm_slli_si128(v2, 16 - 2 * CH));
+#endif
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(l, r), _mm_slli_epi16(c, 1));
+    return _mm_srli_epi16(_mm_add_epi16(sum, eight), 4);
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_hv_exact(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m128i eight = _mm_set1_epi16(8);
+    auto w2 = (width - 2) * CH;
+    auto w1 = w2 + CH;
+    auto dl = (width / 2 - 1) * CH;
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m128i v0, v1, v2, v3, v4, v5;
+        red_by_2_v_exact(load<ALIGNED>(srcp), load<ALIGNED>(sb), load<ALIGNED>(sc), v0, v1);
+
+        for (size_t x = 0; x < w2; x += 32) {
+            red_by_2_v_exact(
+                load<ALIGNED>(srcp + x + 16), load<ALIGNED>(sb + x + 16),
+                load<ALIGNED>(sc + x + 16), v2, v3);
+            red_by_2_v_exact(
+                load<ALIGNED>(srcp + x + 32), load<ALIGNED>(sb + x + 32),
+                load<ALIGNED>(sc + x + 32), v4, v5);
+            __m128i ret = _mm_packus_epi16(
+                red_by_2_h_exact<CH>(v0, v1, v2, eight),
+                red_by_2_h_exact<CH>(v2, v3, v4, eight));
+            store<STREAM>(dstp + x / 2, ret);
+            v0 = v4;
+            v1 = v5;
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < CH; ++c) {
+                dstp[dl + c] = (
+                    srcp[w2 + c] + 3 * srcp[w1 + c] +
+                    2 * sb[w2 + c] + 6 * sb[w1 + c] +
+                    sc[w2 + c] + 3 * sc[w1 + c] + 8) / 16;
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        __m128i v0, v1, v2, v3, v4, v5;
+        // a + 3b is a + 2b + b.
+        __m128i b = load<ALIGNED>(sb);
+        red_by_2_v_exact(load<ALIGNED>(srcp), b, b, v0, v1);
+
+        for (size_t x = 0; x < w2; x += 32) {
+            b = load<ALIGNED>(sb + x + 16);
+            red_by_2_v_exact(load<ALIGNED>(srcp + x + 16), b, b, v2, v3);
+            b = load<ALIGNED>(sb + x + 32);
+            red_by_2_v_exact(load<ALIGNED>(srcp + x + 32), b, b, v4, v5);
+            __m128i ret = _mm_packus_epi16(
+                red_by_2_h_exact<CH>(v0, v1, v2, eight),
+                red_by_2_h_exact<CH>(v2, v3, v4, eight));
+            store<STREAM>(dstp + x / 2, ret);
+            v0 = v4;
+            v1 = v5;
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < CH; ++c) {
+                dstp[dl + c] = (
+                    srcp[w2 + c] + 3 * srcp[w1 + c] +
+                    3 * sb[w2 + c] + 9 * sb[w1 + c] + 8) / 16;
+            }
+        }
+    }
+}
+
+
+#if defined(__SSSE3__)
+// RGB888 is expanded to RGBA8888 as reduceby2_hv_rgb888().
+static F_INLINE void red_by_2_v_exact_rgb888(
+    const uint8_t* a, const uint8_t* b, const uint8_t* c, const __m128i& smask,
+    __m128i& lo, __m128i& hi)
+{
+    red_by_2_v_exact(
+        _mm_shuffle_epi8(load<false>(a), smask), _mm_shuffle_epi8(load<false>(b), smask),
+        _mm_shuffle_epi8(load<false>(c), smask), lo, hi);
+}
+
+
+static void reduceby2_hv_rgb888_exact(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m128i eight = _mm_set1_epi16(8);
+    const __m128i smask0 = _mm_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i smask1 = _mm_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    for (size_t y = 0; y < height - 1; y += 2) {
+        // The last row of even height is a + 3b.
+        auto sb = srcp + sstride;
+        auto sc = y + 2 < height ? sb + sstride : sb;
+        __m128i v0, v1, v2, v3, v4, v5;
+        red_by_2_v_exact_rgb888(srcp, sb, sc, smask0, v0, v1);
+
+        for (size_t x = 0; x < width - 2; x += 8) {
+            red_by_2_v_exact_rgb888(
+                srcp + 3 * x + 12, sb + 3 * x + 12, sc + 3 * x + 12, smask0, v2, v3);
+            red_by_2_v_exact_rgb888(
+                srcp + 3 * x + 24, sb + 3 * x + 24, sc + 3 * x + 24, smask0, v4, v5);
+            __m128i ret = _mm_packus_epi16(
+                red_by_2_h_exact<4>(v0, v1, v2, eight),
+                red_by_2_h_exact<4>(v2, v3, v4, eight));
+            storeu(dstp + 3 * x / 2, _mm_shuffle_epi8(ret, smask1));
+            v0 = v4;
+            v1 = v5;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGB24*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGB24*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGB24>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+#endif  // __SSSE3__
+
 #endif  // __SSE2__
 
 
 // ReduceBy2 for RGBA (no SIMD)
 static void reduceby2_hv_rgba_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height - 2; y += 2) {
         auto sa = reinterpret_cast<const RGBA*>(srcp);
@@ -490,7 +795,7 @@ static void reduceby2_hv_rgba_c(
 
 static void reduceby2_h_rgba_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height; ++y) {
         auto s = reinterpret_cast<const RGBA*>(srcp);
@@ -512,28 +817,27 @@ static void reduceby2_h_rgba_c(
 
 static void reduceby2_v_rgba_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
-    auto s = reinterpret_cast<const RGBA*>(srcp);
-    auto d = reinterpret_cast<RGBA*>(dstp);
-    auto ss = sstride / sizeof(RGBA);
-    auto ds = dstride / sizeof(RGBA);
-
     for (size_t y = 0; y < height - 2; y += 2) {
-        auto sb = s + ss;
-        auto sc = sb + ss;
+        auto sa = reinterpret_cast<const RGBA*>(srcp);
+        auto sb = reinterpret_cast<const RGBA*>(srcp + sstride);
+        auto sc = reinterpret_cast<const RGBA*>(srcp + 2 * sstride);
+        auto d = reinterpret_cast<RGBA*>(dstp);
         for (size_t x = 0; x < width; ++x) {
             d[x] = (
-                RGBAi(s[x], 1) + RGBAi(sb[x], 2) + RGBAi(sc[x], 1)).div4<RGBA>();
+                RGBAi(sa[x], 1) + RGBAi(sb[x], 2) + RGBAi(sc[x], 1)).div4<RGBA>();
         }
-        s += 2 * ss;
-        d += ds;
+        srcp += 2 * sstride;
+        dstp += dstride;
     }
 
     if ((height & 1) == 0) {
-        auto sb = s + ss;
+        auto sa = reinterpret_cast<const RGBA*>(srcp);
+        auto sb = reinterpret_cast<const RGBA*>(srcp + sstride);
+        auto d = reinterpret_cast<RGBA*>(dstp);
         for (size_t x = 0; x < width; ++x) {
-            d[x] = (RGBAi(s[x], 1) + RGBAi(sb[x], 3)).div4<RGBA>();
+            d[x] = (RGBAi(sa[x], 1) + RGBAi(sb[x], 3)).div4<RGBA>();
         }
     }
 }
@@ -542,7 +846,7 @@ static void reduceby2_v_rgba_c(
 // ReduceBy2 for GREY8 (no SIMD)
 static void reduceby2_hv_grey_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height - 2; y += 2) {
         auto sb = srcp + sstride;
@@ -555,17 +859,29 @@ static void reduceby2_hv_grey_c(
         if ((width & 1) == 0) {
             dstp[width / 2 - 1] = (srcp[width - 2] + srcp[width - 1] * 3
                 + 2 * sb[width - 2] + 6 * sb[width - 1] + sc[width - 2]
-                + sc[width - 1] + 8) / 16;
+                + sc[width - 1] * 3 + 8) / 16;
         }
         srcp += 2 * sstride;
         dstp += dstride;
     }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < width - 2; x += 2) {
+            dstp[x / 2] = (srcp[x] + 2 * srcp[x + 1] + srcp[x + 2]
+                         + 3 * sb[x] + 6 * sb[x + 1] + 3 * sb[x + 2] + 8) / 16;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (srcp[width - 2] + srcp[width - 1] * 3
+                + sb[width - 2] * 3 + sb[width - 1] * 9 + 8) / 16;
+        }
+    }
 }
 
 
 static void reduceby2_h_grey_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height; ++y) {
         for (size_t x = 0; x < width - 2; x += 2) {
@@ -582,12 +898,12 @@ static void reduceby2_h_grey_c(
 
 static void reduceby2_v_grey_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height - 2; y += 2) {
         for (size_t x = 0; x < width; ++x) {
             dstp[x] = (
-                srcp[x] + 2 * srcp[x + sstride] + srcp[x + 2 * sstride] + 2) / 4;
+                srcp[x] + 2 * (srcp + sstride)[x] + (srcp + 2 * sstride)[x] + 2) / 4;
         }
         srcp += 2 * sstride;
         dstp += dstride;
@@ -595,16 +911,97 @@ static void reduceby2_v_grey_c(
 
     if ((height & 1) == 0) {
         for (size_t x = 0; x < width; ++x) {
-            dstp[x] = (srcp[x] + 3 * srcp[x + sstride] + 2) / 4;
+            dstp[x] = (srcp[x] + 3 * (srcp + sstride)[x] + 2) / 4;
+        }
+    }
+}
+
+
+// ReduceBy2 for UV88 (no SIMD)
+static void reduceby2_hv_uv_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = 2 * (width - 2);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        for (size_t x = 0; x < w; x += 4) {
+            for (size_t c = 0; c < 2; ++c) {
+                auto p = x + c;
+                dstp[x / 2 + c] = (srcp[p] + 2 * srcp[p + 2] + srcp[p + 4]
+                    + 2 * sb[p] + 4 * sb[p + 2] + 2 * sb[p + 4]
+                    + sc[p] + 2 * sc[p + 2] + sc[p + 4] + 8) / 16;
+            }
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < 2; ++c) {
+                auto p = w + c;
+                dstp[width - 2 + c] = (srcp[p] + 3 * srcp[p + 2]
+                    + 2 * sb[p] + 6 * sb[p + 2] + sc[p] + 3 * sc[p + 2] + 8) / 16;
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < w; x += 4) {
+            for (size_t c = 0; c < 2; ++c) {
+                auto p = x + c;
+                dstp[x / 2 + c] = (srcp[p] + 2 * srcp[p + 2] + srcp[p + 4]
+                    + 3 * sb[p] + 6 * sb[p + 2] + 3 * sb[p + 4] + 8) / 16;
+            }
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < 2; ++c) {
+                auto p = w + c;
+                dstp[width - 2 + c] = (srcp[p] + 3 * srcp[p + 2]
+                    + 3 * sb[p] + 9 * sb[p + 2] + 8) / 16;
+            }
         }
     }
 }
 
 
+static void reduceby2_h_uv_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = 2 * (width - 2);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < w; x += 4) {
+            for (size_t c = 0; c < 2; ++c) {
+                auto p = x + c;
+                dstp[x / 2 + c] = (srcp[p] + 2 * srcp[p + 2] + srcp[p + 4] + 2) / 4;
+            }
+        }
+        if ((width & 1) == 0) {
+            for (size_t c = 0; c < 2; ++c) {
+                dstp[width - 2 + c] = (srcp[w + c] + 3 * srcp[w + 2 + c] + 2) / 4;
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void reduceby2_v_uv_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey_c(srcp, dstp, width * 2, height, sstride, dstride);
+}
+
+
 // ReduceBy2 for RGB888 (no SIMD)
 static void reduceby2_hv_rgb888_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height - 2; y += 2) {
         auto sa = reinterpret_cast<const RGB24*>(srcp);
@@ -653,7 +1050,7 @@ static void reduceby2_hv_rgb888_c(
 
 static void reduceby2_h_rgb888_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     for (size_t y = 0; y < height; ++y) {
         auto s = reinterpret_cast<const RGB24*>(srcp);
@@ -675,7 +1072,7 @@ static void reduceby2_h_rgb888_c(
 
 static void reduceby2_v_rgb888_c(
     const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
-    const size_t sstride, const size_t dstride) noexcept
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
 {
     reduceby2_v_grey_c(srcp, dstp, width * 3, height, sstride, dstride);
 }
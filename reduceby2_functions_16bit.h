@@ -0,0 +1,399 @@
+/*
+    reduceby2_functions_16bit.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef REDUCE_BY_2_FUNCTIONS_16BIT_H
+#define REDUCE_BY_2_FUNCTIONS_16BIT_H
+
+#include "rh_common.h"
+
+// Kernels for GREY16, RGB48 and RGBA64. CH is the number of channels.
+// Sums are taken in 32bit, so SIMD results are the same as C ones.
+
+
+// ReduceBy2 for 16bit formats (no SIMD)
+template <int CH>
+static void reduceby2_hv_16bit_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width - 2) * CH;
+    auto l = (width - 2) / 2 * CH;  // the last output pixel of even width.
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sa = reinterpret_cast<const uint16_t*>(srcp);
+        auto sb = reinterpret_cast<const uint16_t*>(srcp + sstride);
+        auto sc = reinterpret_cast<const uint16_t*>(srcp + 2 * sstride);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = x + c;
+                d[x / 2 + c] = static_cast<uint16_t>((
+                    sa[p] + 2 * sa[p + CH] + sa[p + 2 * CH] +
+                    2 * sb[p] + 4 * sb[p + CH] + 2 * sb[p + 2 * CH] +
+                    sc[p] + 2 * sc[p + CH] + sc[p + 2 * CH] + 8) / 16);
+            }
+        }
+        if ((width & 1) == 0) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = w + c;
+                d[l + c] = static_cast<uint16_t>((
+                    sa[p] + 3 * sa[p + CH] + 2 * sb[p] + 6 * sb[p + CH] +
+                    sc[p] + 3 * sc[p + CH] + 8) / 16);
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sa = reinterpret_cast<const uint16_t*>(srcp);
+        auto sb = reinterpret_cast<const uint16_t*>(srcp + sstride);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = x + c;
+                d[x / 2 + c] = static_cast<uint16_t>((
+                    sa[p] + 2 * sa[p + CH] + sa[p + 2 * CH] +
+                    3 * sb[p] + 6 * sb[p + CH] + 3 * sb[p + 2 * CH] + 8) / 16);
+            }
+        }
+        if ((width & 1) == 0) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = w + c;
+                d[l + c] = static_cast<uint16_t>((
+                    sa[p] + 3 * sa[p + CH] + 3 * sb[p] + 9 * sb[p + CH] + 8) / 16);
+            }
+        }
+    }
+}
+
+
+template <int CH>
+static void reduceby2_h_16bit_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width - 2) * CH;
+    auto l = (width - 2) / 2 * CH;
+
+    for (size_t y = 0; y < height; ++y) {
+        auto s = reinterpret_cast<const uint16_t*>(srcp);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = x + c;
+                d[x / 2 + c] = static_cast<uint16_t>(
+                    (s[p] + 2 * s[p + CH] + s[p + 2 * CH] + 2) / 4);
+            }
+        }
+        if ((width & 1) == 0) {
+            for (int c = 0; c < CH; ++c) {
+                d[l + c] = static_cast<uint16_t>((s[w + c] + 3 * s[w + CH + c] + 2) / 4);
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void reduceby2_v_16bit_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH;
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sa = reinterpret_cast<const uint16_t*>(srcp);
+        auto sb = reinterpret_cast<const uint16_t*>(srcp + sstride);
+        auto sc = reinterpret_cast<const uint16_t*>(srcp + 2 * sstride);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; ++x) {
+            d[x] = static_cast<uint16_t>((sa[x] + 2 * sb[x] + sc[x] + 2) / 4);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sa = reinterpret_cast<const uint16_t*>(srcp);
+        auto sb = reinterpret_cast<const uint16_t*>(srcp + sstride);
+        auto d = reinterpret_cast<uint16_t*>(dstp);
+        for (size_t x = 0; x < w; ++x) {
+            d[x] = static_cast<uint16_t>((sa[x] + 3 * sb[x] + 2) / 4);
+        }
+    }
+}
+
+
+#if defined(__SSE2__)
+
+// ReduceBy2 for GREY16 (CH = 1) and RGBA64 (CH = 4)
+// f and s are the first and second ones of pairs (summed vertically), and n is
+// f of the next vector.
+template <int CH>
+static F_INLINE __m128i red_by_2_h_16bit(
+    const __m128i& f, const __m128i& s, const __m128i& n)
+{
+    return _mm_add_epi32(_mm_add_epi32(f, next16<CH>(f, n)), _mm_slli_epi32(s, 1));
+}
+
+
+// a + 2b + c of the first and second ones of pairs.
+template <int CH>
+static F_INLINE void red_by_2_v_16bit(
+    const __m128i& a, const __m128i& b, const __m128i& c, __m128i& f, __m128i& s)
+{
+    f = _mm_add_epi32(
+        _mm_add_epi32(first16<CH>(a), first16<CH>(c)), _mm_slli_epi32(first16<CH>(b), 1));
+    s = _mm_add_epi32(
+        _mm_add_epi32(second16<CH>(a), second16<CH>(c)), _mm_slli_epi32(second16<CH>(b), 1));
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_hv_16bit(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    constexpr size_t bpp = CH * 2;
+    const __m128i eight = _mm_set1_epi32(8);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m128i f0, s0, f1, s1, f2, s2;
+        red_by_2_v_16bit<CH>(
+            load<ALIGNED>(srcp), load<ALIGNED>(sb), load<ALIGNED>(sc), f0, s0);
+
+        for (size_t x = 0; x < (width - 2) * bpp; x += 32) {
+            red_by_2_v_16bit<CH>(
+                load<ALIGNED>(srcp + x + 16), load<ALIGNED>(sb + x + 16),
+                load<ALIGNED>(sc + x + 16), f1, s1);
+            red_by_2_v_16bit<CH>(
+                load<ALIGNED>(srcp + x + 32), load<ALIGNED>(sb + x + 32),
+                load<ALIGNED>(sc + x + 32), f2, s2);
+            __m128i r0 = _mm_add_epi32(red_by_2_h_16bit<CH>(f0, s0, f1), eight);
+            __m128i r1 = _mm_add_epi32(red_by_2_h_16bit<CH>(f1, s1, f2), eight);
+            store<STREAM>(dstp + x / 2,
+                          pack_u32(_mm_srli_epi32(r0, 4), _mm_srli_epi32(r1, 4)));
+            f0 = f2;
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto sa = reinterpret_cast<const uint16_t*>(srcp) + (width - 2) * CH;
+            auto s1 = reinterpret_cast<const uint16_t*>(sb) + (width - 2) * CH;
+            auto s2 = reinterpret_cast<const uint16_t*>(sc) + (width - 2) * CH;
+            auto d = reinterpret_cast<uint16_t*>(dstp) + (width / 2 - 1) * CH;
+            for (int c = 0; c < CH; ++c) {
+                d[c] = static_cast<uint16_t>((
+                    sa[c] + 3 * sa[c + CH] + 2 * s1[c] + 6 * s1[c + CH] +
+                    s2[c] + 3 * s2[c + CH] + 8) / 16);
+            }
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        __m128i f0, s0, f1, s1, f2, s2;
+        // a + 3b is a + 2b + b.
+        __m128i b = load<ALIGNED>(sb);
+        red_by_2_v_16bit<CH>(load<ALIGNED>(srcp), b, b, f0, s0);
+
+        for (size_t x = 0; x < (width - 2) * bpp; x += 32) {
+            b = load<ALIGNED>(sb + x + 16);
+            red_by_2_v_16bit<CH>(load<ALIGNED>(srcp + x + 16), b, b, f1, s1);
+            b = load<ALIGNED>(sb + x + 32);
+            red_by_2_v_16bit<CH>(load<ALIGNED>(srcp + x + 32), b, b, f2, s2);
+            __m128i r0 = _mm_add_epi32(red_by_2_h_16bit<CH>(f0, s0, f1), eight);
+            __m128i r1 = _mm_add_epi32(red_by_2_h_16bit<CH>(f1, s1, f2), eight);
+            store<STREAM>(dstp + x / 2,
+                          pack_u32(_mm_srli_epi32(r0, 4), _mm_srli_epi32(r1, 4)));
+            f0 = f2;
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto sa = reinterpret_cast<const uint16_t*>(srcp) + (width - 2) * CH;
+            auto s1 = reinterpret_cast<const uint16_t*>(sb) + (width - 2) * CH;
+            auto d = reinterpret_cast<uint16_t*>(dstp) + (width / 2 - 1) * CH;
+            for (int c = 0; c < CH; ++c) {
+                d[c] = static_cast<uint16_t>((
+                    sa[c] + 3 * sa[c + CH] + 3 * s1[c] + 9 * s1[c + CH] + 8) / 16);
+            }
+        }
+    }
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_h_16bit(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    constexpr size_t bpp = CH * 2;
+    const __m128i two = _mm_set1_epi32(2);
+
+    for (size_t y = 0; y < height; ++y) {
+        __m128i v = load<ALIGNED>(srcp);
+        __m128i f0 = first16<CH>(v), s0 = second16<CH>(v);
+        for (size_t x = 0; x < (width - 2) * bpp; x += 32) {
+            v = load<ALIGNED>(srcp + x + 16);
+            __m128i f1 = first16<CH>(v), s1 = second16<CH>(v);
+            v = load<ALIGNED>(srcp + x + 32);
+            __m128i f2 = first16<CH>(v), s2 = second16<CH>(v);
+            __m128i r0 = _mm_add_epi32(red_by_2_h_16bit<CH>(f0, s0, f1), two);
+            __m128i r1 = _mm_add_epi32(red_by_2_h_16bit<CH>(f1, s1, f2), two);
+            store<STREAM>(dstp + x / 2,
+                          pack_u32(_mm_srli_epi32(r0, 2), _mm_srli_epi32(r1, 2)));
+            f0 = f2;
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto s = reinterpret_cast<const uint16_t*>(srcp) + (width - 2) * CH;
+            auto d = reinterpret_cast<uint16_t*>(dstp) + (width / 2 - 1) * CH;
+            for (int c = 0; c < CH; ++c) {
+                d[c] = static_cast<uint16_t>((s[c] + 3 * s[c + CH] + 2) / 4);
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// CH = 3 is also fine.
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_v_16bit(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH * 2;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi32(2);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m128i a = load<ALIGNED>(srcp + x);
+            __m128i b = load<ALIGNED>(srcp + x + sstride);
+            __m128i c = load<ALIGNED>(srcp + x + 2 * sstride);
+            __m128i lo = _mm_add_epi32(
+                _mm_add_epi32(_mm_unpacklo_epi16(a, zero), _mm_unpacklo_epi16(c, zero)),
+                _mm_slli_epi32(_mm_unpacklo_epi16(b, zero), 1));
+            __m128i hi = _mm_add_epi32(
+                _mm_add_epi32(_mm_unpackhi_epi16(a, zero), _mm_unpackhi_epi16(c, zero)),
+                _mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 1));
+            lo = _mm_srli_epi32(_mm_add_epi32(lo, two), 2);
+            hi = _mm_srli_epi32(_mm_add_epi32(hi, two), 2);
+            store<STREAM>(dstp + x, pack_u32(lo, hi));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m128i a = load<ALIGNED>(srcp + x);
+            __m128i b = load<ALIGNED>(srcp + x + sstride);
+            __m128i lo = _mm_unpacklo_epi16(b, zero);
+            __m128i hi = _mm_unpackhi_epi16(b, zero);
+            lo = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a, zero), lo),
+                               _mm_slli_epi32(lo, 1));
+            hi = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(a, zero), hi),
+                               _mm_slli_epi32(hi, 1));
+            lo = _mm_srli_epi32(_mm_add_epi32(lo, two), 2);
+            hi = _mm_srli_epi32(_mm_add_epi32(hi, two), 2);
+            store<STREAM>(dstp + x, pack_u32(lo, hi));
+        }
+    }
+}
+
+
+// ReduceBy2 for RGB48
+// Pixels are loaded one by one, and the last ones of each row are left to
+// the C kernel not to read beyond the row. The C kernel also overwrites the
+// junk element stored after the last pixel made here.
+static F_INLINE __m128i red_by_2_rgb48(const uint8_t* s)
+{
+    return _mm_add_epi32(
+        _mm_add_epi32(load_rgb48(s), load_rgb48(s + 12)), _mm_slli_epi32(load_rgb48(s + 6), 1));
+}
+
+
+static void reduceby2_hv_rgb48(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 3) / 2;
+    const __m128i eight = _mm_set1_epi32(8);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = s + sstride;
+        auto sc = sb + sstride;
+        for (size_t x = 0; x < n; ++x) {
+            __m128i t = _mm_add_epi32(
+                _mm_add_epi32(red_by_2_rgb48(s + 12 * x), red_by_2_rgb48(sc + 12 * x)),
+                _mm_slli_epi32(red_by_2_rgb48(sb + 12 * x), 1));
+            t = _mm_srli_epi32(_mm_add_epi32(t, eight), 4);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 6 * x), pack_u32(t, t));
+        }
+        s += 2 * sstride;
+        d += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = s + sstride;
+        for (size_t x = 0; x < n; ++x) {
+            __m128i b = red_by_2_rgb48(sb + 12 * x);
+            __m128i t = _mm_add_epi32(
+                _mm_add_epi32(red_by_2_rgb48(s + 12 * x), b), _mm_slli_epi32(b, 1));
+            t = _mm_srli_epi32(_mm_add_epi32(t, eight), 4);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 6 * x), pack_u32(t, t));
+        }
+    }
+    reduceby2_hv_16bit_c<3>(
+        srcp + 12 * n, dstp + 6 * n, width - 2 * n, height, sstride, dstride);
+}
+
+
+static void reduceby2_h_rgb48(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 3) / 2;
+    const __m128i two = _mm_set1_epi32(2);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < n; ++x) {
+            __m128i t = _mm_srli_epi32(_mm_add_epi32(red_by_2_rgb48(s + 12 * x), two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 6 * x), pack_u32(t, t));
+        }
+        s += sstride;
+        d += dstride;
+    }
+    reduceby2_h_16bit_c<3>(
+        srcp + 12 * n, dstp + 6 * n, width - 2 * n, height, sstride, dstride);
+}
+
+#endif // __SSE2__
+
+#endif // REDUCE_BY_2_FUNCTIONS_16BIT_H
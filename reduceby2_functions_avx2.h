@@ -0,0 +1,444 @@
+/*
+    reduceby2_functions_avx2.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef REDUCE_BY_2_FUNCTIONS_AVX2_H
+#define REDUCE_BY_2_FUNCTIONS_AVX2_H
+
+#include "rh_common.h"
+
+#if defined(__AVX2__)
+
+// ReduceBy2 helper (same rounding as red_by_2)
+static F_INLINE __m256i red_by_2_avx2(
+    const __m256i& s0, const __m256i& s1, const __m256i& s2, const __m256i& one)
+{
+    return _mm256_avg_epu8(
+        _mm256_avg_epu8(s0, s1), _mm256_subs_epu8(_mm256_avg_epu8(s2, s1), one));
+}
+
+
+// ReduceBy2 for RGBA
+static F_INLINE __m256i red_by_2_h_rgba_avx2(
+    const __m256i& _l, const __m256i& _c, const __m256i& _r, const __m256i& one)
+{
+    const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i t0 = _mm256_permutevar8x32_epi32(_l, idx);
+    __m256i t1 = _mm256_permutevar8x32_epi32(_c, idx);
+    __m256i l = _mm256_permute2x128_si256(t0, t1, 0x20);
+    __m256i c = _mm256_permute2x128_si256(t0, t1, 0x31);
+    __m256i r = _mm256_alignr_epi8(_mm256_permute2x128_si256(l, _r, 0x21), l, 4);
+    return red_by_2_avx2(l, c, r, one);
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_hv_rgba_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m256i left = red_by_2_avx2(
+            load256<ALIGNED>(srcp), load256<ALIGNED>(sb), load256<ALIGNED>(sc),
+            one);
+
+        for (size_t x = 0; x < width - 2; x += 16) {
+            __m256i center = red_by_2_avx2(
+                load256<ALIGNED>(srcp + 4 * x + 32),
+                load256<ALIGNED>(sb + 4 * x + 32),
+                load256<ALIGNED>(sc + 4 * x + 32), one);
+
+            __m256i right = red_by_2_avx2(
+                load256<ALIGNED>(srcp + 4 * x + 64),
+                load256<ALIGNED>(sb + 4 * x + 64),
+                load256<ALIGNED>(sc + 4 * x + 64), one);
+
+            center = red_by_2_h_rgba_avx2(left, center, right, one);
+            store256<STREAM>(dstp + 2 * x, center);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGBA*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGBA*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGBA*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGBA*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGBA>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto d = reinterpret_cast<RGBA*>(dstp);
+        auto sa = reinterpret_cast<const RGBA*>(srcp);
+        auto sb = reinterpret_cast<const RGBA*>(srcp + sstride);
+        for (size_t x = 0; x < width - 2; x += 2) {
+            d[x / 2] = (
+                RGBAi(sa[x], 1) + RGBAi(sa[x + 1], 2) + RGBAi(sa[x + 2], 1) +
+                RGBAi(sb[x], 3) + RGBAi(sb[x + 1], 6) + RGBAi(sb[x + 2], 3)
+                ).div16<RGBA>();
+
+        }
+        if ((width & 1) == 0) {
+            d[width / 2 - 1] = (
+                RGBAi(sa[width - 2], 1) + RGBAi(sa[width - 1], 3) +
+                RGBAi(sb[width - 2], 3) + RGBAi(sb[width - 1], 9)).div16<RGBA>();
+        }
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_h_rgba_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (size_t y = 0; y < height; ++y) {
+        __m256i s0 = load256<ALIGNED>(srcp);
+        for (size_t x = 0; x < width - 2; x += 16) {
+            __m256i s1 = load256<ALIGNED>(srcp + 4 * x + 32);
+            __m256i s2 = load256<ALIGNED>(srcp + 4 * x + 64);
+            __m256i ret = red_by_2_h_rgba_avx2(s0, s1, s2, one);
+            store256<STREAM>(dstp + 2 * x, ret);
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGBA*>(dstp) + width / 2 - 1;
+            auto s = reinterpret_cast<const RGBA*>(srcp) + width - 2;
+            *d = (RGBAi(s[0], 1) + RGBAi(s[1], 3)).div4<RGBA>();
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_v_rgba_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        for (size_t x = 0; x < width; x += 8) {
+            __m256i ret = red_by_2_avx2(
+                load256<ALIGNED>(srcp + 4 * x),
+                load256<ALIGNED>(srcp + 4 * x + sstride),
+                load256<ALIGNED>(srcp + 4 * x + sstride * 2), one);
+            store256<STREAM>(dstp + 4 * x, ret);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        for (size_t x = 0; x < width; x += 8) {
+            __m256i s0 = load256<ALIGNED>(srcp + 4 * x);
+            __m256i s1 = load256<ALIGNED>(srcp + 4 * x + sstride);
+            s1 = red_by_2_avx2(s0, s1, s1, one);
+            store256<STREAM>(dstp + 4 * x, s1);
+        }
+    }
+}
+
+
+// ReduceBy2 for GREY8
+static F_INLINE __m256i red_by_2_h_grey_avx2(
+    const __m256i& l0, const __m256i& l1, const __m256i& l2, const __m256i& mask,
+    const __m256i& one)
+{
+    __m256i l = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+        _mm256_and_si256(l0, mask), _mm256_and_si256(l1, mask)),
+        _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i m = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+        _mm256_srli_epi16(l0, 8), _mm256_srli_epi16(l1, 8)),
+        _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i r = _mm256_alignr_epi8(_mm256_permute2x128_si256(l, l2, 0x21), l, 1);
+    return red_by_2_avx2(l, m, r, one);
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_hv_grey_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m256i left = red_by_2_avx2(
+            load256<ALIGNED>(srcp), load256<ALIGNED>(sb), load256<ALIGNED>(sc),
+            one);
+
+        for (size_t x = 0; x < width - 2; x += 64) {
+            __m256i center = red_by_2_avx2(
+                load256<ALIGNED>(srcp + x + 32), load256<ALIGNED>(sb + x + 32),
+                load256<ALIGNED>(sc + x + 32), one);
+
+            __m256i right = red_by_2_avx2(
+                load256<ALIGNED>(srcp + x + 64), load256<ALIGNED>(sb + x + 64),
+                load256<ALIGNED>(sc + x + 64), one);
+
+            center = red_by_2_h_grey_avx2(left, center, right, mask, one);
+            store256<STREAM>(dstp + x / 2, center);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto w2 = width - 2;
+            auto w1 = width - 1;
+            dstp[width / 2 - 1] = (
+                srcp[w2] + 3 * srcp[w1] +
+                2 * sb[w2] + 6 * sb[w1] +
+                sc[w2] + 3 * sc[w1] + 8) / 16;
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        __m256i s0 = load256<ALIGNED>(srcp);
+        __m256i s1 = load256<ALIGNED>(sb);
+        __m256i left = red_by_2_avx2(s0, s1, s1, one);
+
+        for (size_t x = 0; x < width - 2; x += 64) {
+            s0 = load256<ALIGNED>(srcp + x + 32);
+            s1 = load256<ALIGNED>(sb + x + 32);
+            __m256i center = red_by_2_avx2(s0, s1, s1, one);
+
+            s0 = load256<ALIGNED>(srcp + x + 64);
+            s1 = load256<ALIGNED>(sb + x + 64);
+            __m256i right = red_by_2_avx2(s0, s1, s1, one);
+
+            center = red_by_2_h_grey_avx2(left, center, right, mask, one);
+            store256<STREAM>(dstp + x / 2, center);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (
+                srcp[width - 2] + srcp[width - 1] * 3 +
+                sb[width - 2] * 3 + sb[width - 1] * 9 + 8) / 16;
+        }
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_h_grey_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+
+    for (size_t y = 0; y < height; ++y) {
+        __m256i left = load256<ALIGNED>(srcp);
+
+        for (size_t x = 0; x < width - 2; x += 64) {
+            __m256i center = load256<ALIGNED>(srcp + x + 32);
+            __m256i right = load256<ALIGNED>(srcp + x + 64);
+            center = red_by_2_h_grey_avx2(left, center, right, mask, one);
+            store256<STREAM>(dstp + x / 2, center);
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (
+                srcp[width - 2] + srcp[width - 1] * 3 + 2) / 4;
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_v_grey_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        for (size_t x = 0; x < width; x += 32) {
+            __m256i ret = red_by_2_avx2(
+                load256<ALIGNED>(srcp + x),
+                load256<ALIGNED>(srcp + x + sstride),
+                load256<ALIGNED>(srcp + x + 2 * sstride), one);
+            store256<STREAM>(dstp + x, ret);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        for (size_t x = 0; x < width; x += 32) {
+            __m256i s0 = load256<ALIGNED>(srcp + x);
+            __m256i s1 = load256<ALIGNED>(srcp + x + sstride);
+            __m256i ret = red_by_2_avx2(s0, s1, s1, one);
+            store256<STREAM>(dstp + x, ret);
+        }
+    }
+}
+
+
+// ReduceBy2 for RGB888
+static void reduceby2_hv_rgb888_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i smask0 = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i smask1 = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pmask = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m256i left = _mm256_shuffle_epi8(
+            red_by_2_avx2(load_rgb888x2(srcp),
+                          load_rgb888x2(sb),
+                          load_rgb888x2(sc), one), smask0);
+
+        for (size_t x = 0; x < width - 2; x += 16) {
+            __m256i center = _mm256_shuffle_epi8(
+                red_by_2_avx2(load_rgb888x2(srcp + 3 * x + 24),
+                              load_rgb888x2(sb + 3 * x + 24),
+                              load_rgb888x2(sc + 3 * x + 24), one), smask0);
+            __m256i right = _mm256_shuffle_epi8(
+                red_by_2_avx2(load_rgb888x2(srcp + 3 * x + 48),
+                              load_rgb888x2(sb + 3 * x + 48),
+                              load_rgb888x2(sc + 3 * x + 48), one), smask0);
+
+            center = _mm256_shuffle_epi8(
+                red_by_2_h_rgba_avx2(left, center, right, one), smask1);
+            storeu256(dstp + 3 * x / 2,
+                      _mm256_permutevar8x32_epi32(center, pmask));
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGB24*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGB24*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGB24>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        __m256i s0 = load_rgb888x2(srcp);
+        __m256i s1 = load_rgb888x2(sb);
+        __m256i left = _mm256_shuffle_epi8(red_by_2_avx2(s0, s1, s1, one), smask0);
+
+        for (size_t x = 0; x < width - 2; x += 16) {
+            s0 = load_rgb888x2(srcp + 3 * x + 24);
+            s1 = load_rgb888x2(sb + 3 * x + 24);
+            __m256i center = _mm256_shuffle_epi8(
+                red_by_2_avx2(s0, s1, s1, one), smask0);
+
+            s0 = load_rgb888x2(srcp + 3 * x + 48);
+            s1 = load_rgb888x2(sb + 3 * x + 48);
+            __m256i right = _mm256_shuffle_epi8(
+                red_by_2_avx2(s0, s1, s1, one), smask0);
+
+            center = _mm256_shuffle_epi8(
+                red_by_2_h_rgba_avx2(left, center, right, one), smask1);
+            storeu256(dstp + 3 * x / 2,
+                      _mm256_permutevar8x32_epi32(center, pmask));
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto sc = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto sd = reinterpret_cast<const RGB24*>(srcp + sstride) + width - 2;
+            *d = (
+                RGBAi(sc[0], 1) + RGBAi(sc[1], 3) +
+                RGBAi(sd[0], 3) + RGBAi(sd[1], 9)).div16<RGB24>();
+        }
+    }
+}
+
+
+static void reduceby2_h_rgb888_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i smask0 = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i smask1 = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pmask = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    for (size_t y = 0; y < height; ++y) {
+        __m256i s0 = _mm256_shuffle_epi8(load_rgb888x2(srcp), smask0);
+        for (size_t x = 0; x < width - 2; x += 16) {
+            __m256i s1 = _mm256_shuffle_epi8(
+                load_rgb888x2(srcp + 3 * x + 24), smask0);
+            __m256i s2 = _mm256_shuffle_epi8(
+                load_rgb888x2(srcp + 3 * x + 48), smask0);
+            __m256i ret = _mm256_shuffle_epi8(
+                red_by_2_h_rgba_avx2(s0, s1, s2, one), smask1);
+            storeu256(dstp + 3 * x / 2, _mm256_permutevar8x32_epi32(ret, pmask));
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            *d = (RGBAi(s[0]) + RGBAi(s[1], 3)).div4<RGB24>();
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void reduceby2_v_rgb888_avx2(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey_avx2<false, true>(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+#endif // __AVX2__
+
+#endif // REDUCE_BY_2_FUNCTIONS_AVX2_H
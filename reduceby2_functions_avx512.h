@@ -0,0 +1,439 @@
+/*
+    reduceby2_functions_avx512.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef REDUCE_BY_2_FUNCTIONS_AVX512_H
+#define REDUCE_BY_2_FUNCTIONS_AVX512_H
+
+#include "rh_common.h"
+
+#if defined(__AVX512BW__) && defined(__AVX512VBMI__)
+
+// Row tails are processed with masked loads/stores, so these kernels never
+// touch memory beyond the rows.
+// dsize leaves out the last pixel of even width, which is written by scalar
+// code. Storing it over a streamed cache line would be very slow.
+
+// ReduceBy2 helper (same rounding as red_by_2)
+static F_INLINE __m512i red_by_2_avx512(
+    const __m512i& s0, const __m512i& s1, const __m512i& s2, const __m512i& one)
+{
+    return _mm512_avg_epu8(
+        _mm512_avg_epu8(s0, s1), _mm512_subs_epu8(_mm512_avg_epu8(s2, s1), one));
+}
+
+
+// ReduceBy2 for RGBA
+static F_INLINE __m512i red_by_2_h_rgba_avx512(
+    const __m512i& _l, const __m512i& _c, const __m512i& _r, const __m512i& one)
+{
+    const __m512i even = _mm512_setr_epi32(
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd = _mm512_setr_epi32(
+        1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    const __m512i next = _mm512_setr_epi32(
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+    __m512i l = _mm512_permutex2var_epi32(_l, even, _c);
+    __m512i c = _mm512_permutex2var_epi32(_l, odd, _c);
+    __m512i r = _mm512_permutex2var_epi32(l, next, _r);
+    return red_by_2_avx512(l, c, r, one);
+}
+
+
+template <bool STREAM>
+static void reduceby2_hv_rgba_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = width * 4;
+    const ptrdiff_t dsize = (width - 1) / 2 * 4;
+    const __m512i one = _mm512_set1_epi8(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m512i left = red_by_2_avx512(
+            load512(srcp, rowsize), load512(sb, rowsize), load512(sc, rowsize),
+            one);
+
+        for (size_t x = 0; x < width - 2; x += 32) {
+            const ptrdiff_t n = rowsize - 4 * x;
+            __m512i center = red_by_2_avx512(
+                load512(srcp + 4 * x + 64, n - 64),
+                load512(sb + 4 * x + 64, n - 64),
+                load512(sc + 4 * x + 64, n - 64), one);
+
+            __m512i right = red_by_2_avx512(
+                load512(srcp + 4 * x + 128, n - 128),
+                load512(sb + 4 * x + 128, n - 128),
+                load512(sc + 4 * x + 128, n - 128), one);
+
+            center = red_by_2_h_rgba_avx512(left, center, right, one);
+            store512<STREAM>(dstp + 2 * x, center, dsize - 2 * x);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGBA*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGBA*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGBA*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGBA*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGBA>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto d = reinterpret_cast<RGBA*>(dstp);
+        auto sa = reinterpret_cast<const RGBA*>(srcp);
+        auto sb = reinterpret_cast<const RGBA*>(srcp + sstride);
+        for (size_t x = 0; x < width - 2; x += 2) {
+            d[x / 2] = (
+                RGBAi(sa[x], 1) + RGBAi(sa[x + 1], 2) + RGBAi(sa[x + 2], 1) +
+                RGBAi(sb[x], 3) + RGBAi(sb[x + 1], 6) + RGBAi(sb[x + 2], 3)
+                ).div16<RGBA>();
+
+        }
+        if ((width & 1) == 0) {
+            d[width / 2 - 1] = (
+                RGBAi(sa[width - 2], 1) + RGBAi(sa[width - 1], 3) +
+                RGBAi(sb[width - 2], 3) + RGBAi(sb[width - 1], 9)).div16<RGBA>();
+        }
+    }
+}
+
+
+template <bool STREAM>
+static void reduceby2_h_rgba_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = width * 4;
+    const ptrdiff_t dsize = (width - 1) / 2 * 4;
+    const __m512i one = _mm512_set1_epi8(1);
+
+    for (size_t y = 0; y < height; ++y) {
+        __m512i s0 = load512(srcp, rowsize);
+        for (size_t x = 0; x < width - 2; x += 32) {
+            const ptrdiff_t n = rowsize - 4 * x;
+            __m512i s1 = load512(srcp + 4 * x + 64, n - 64);
+            __m512i s2 = load512(srcp + 4 * x + 128, n - 128);
+            __m512i ret = red_by_2_h_rgba_avx512(s0, s1, s2, one);
+            store512<STREAM>(dstp + 2 * x, ret, dsize - 2 * x);
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGBA*>(dstp) + width / 2 - 1;
+            auto s = reinterpret_cast<const RGBA*>(srcp) + width - 2;
+            *d = (RGBAi(s[0], 1) + RGBAi(s[1], 3)).div4<RGBA>();
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// ReduceBy2 for GREY8
+static F_INLINE __m512i red_by_2_h_grey_avx512(
+    const __m512i& l0, const __m512i& l1, const __m512i& l2,
+    const __m512i& even, const __m512i& odd, const __m512i& next,
+    const __m512i& one)
+{
+    __m512i l = _mm512_permutex2var_epi8(l0, even, l1);
+    __m512i m = _mm512_permutex2var_epi8(l0, odd, l1);
+    __m512i r = _mm512_permutex2var_epi8(l, next, l2);
+    return red_by_2_avx512(l, m, r, one);
+}
+
+
+template <bool STREAM>
+static void reduceby2_hv_grey_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t w = width;
+    const ptrdiff_t dsize = (width - 1) / 2;
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = load_idx(grey_even_idx);
+    const __m512i odd = load_idx(grey_odd_idx);
+    const __m512i next = load_idx(grey_next_idx);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        __m512i left = red_by_2_avx512(
+            load512(srcp, w), load512(sb, w), load512(sc, w), one);
+
+        for (ptrdiff_t x = 0; x < w - 2; x += 128) {
+            __m512i center = red_by_2_avx512(
+                load512(srcp + x + 64, w - x - 64),
+                load512(sb + x + 64, w - x - 64),
+                load512(sc + x + 64, w - x - 64), one);
+
+            __m512i right = red_by_2_avx512(
+                load512(srcp + x + 128, w - x - 128),
+                load512(sb + x + 128, w - x - 128),
+                load512(sc + x + 128, w - x - 128), one);
+
+            center = red_by_2_h_grey_avx512(
+                left, center, right, even, odd, next, one);
+            store512<STREAM>(dstp + x / 2, center, dsize - x / 2);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto w2 = width - 2;
+            auto w1 = width - 1;
+            dstp[width / 2 - 1] = (
+                srcp[w2] + 3 * srcp[w1] +
+                2 * sb[w2] + 6 * sb[w1] +
+                sc[w2] + 3 * sc[w1] + 8) / 16;
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        __m512i s0 = load512(srcp, w);
+        __m512i s1 = load512(sb, w);
+        __m512i left = red_by_2_avx512(s0, s1, s1, one);
+
+        for (ptrdiff_t x = 0; x < w - 2; x += 128) {
+            s0 = load512(srcp + x + 64, w - x - 64);
+            s1 = load512(sb + x + 64, w - x - 64);
+            __m512i center = red_by_2_avx512(s0, s1, s1, one);
+
+            s0 = load512(srcp + x + 128, w - x - 128);
+            s1 = load512(sb + x + 128, w - x - 128);
+            __m512i right = red_by_2_avx512(s0, s1, s1, one);
+
+            center = red_by_2_h_grey_avx512(
+                left, center, right, even, odd, next, one);
+            store512<STREAM>(dstp + x / 2, center, dsize - x / 2);
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (
+                srcp[width - 2] + srcp[width - 1] * 3 +
+                sb[width - 2] * 3 + sb[width - 1] * 9 + 8) / 16;
+        }
+    }
+}
+
+
+template <bool STREAM>
+static void reduceby2_h_grey_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t w = width;
+    const ptrdiff_t dsize = (width - 1) / 2;
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = load_idx(grey_even_idx);
+    const __m512i odd = load_idx(grey_odd_idx);
+    const __m512i next = load_idx(grey_next_idx);
+
+    for (size_t y = 0; y < height; ++y) {
+        __m512i left = load512(srcp, w);
+
+        for (ptrdiff_t x = 0; x < w - 2; x += 128) {
+            __m512i center = load512(srcp + x + 64, w - x - 64);
+            __m512i right = load512(srcp + x + 128, w - x - 128);
+            center = red_by_2_h_grey_avx512(
+                left, center, right, even, odd, next, one);
+            store512<STREAM>(dstp + x / 2, center, dsize - x / 2);
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (
+                srcp[width - 2] + srcp[width - 1] * 3 + 2) / 4;
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// width is the number of bytes in a row.
+template <bool STREAM>
+static void reduceby2_v_grey_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t w = width;
+    const __m512i one = _mm512_set1_epi8(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        for (ptrdiff_t x = 0; x < w; x += 64) {
+            __m512i ret = red_by_2_avx512(
+                load512(srcp + x, w - x),
+                load512(srcp + x + sstride, w - x),
+                load512(srcp + x + 2 * sstride, w - x), one);
+            store512<STREAM>(dstp + x, ret, w - x);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        for (ptrdiff_t x = 0; x < w; x += 64) {
+            __m512i s0 = load512(srcp + x, w - x);
+            __m512i s1 = load512(srcp + x + sstride, w - x);
+            store512<STREAM>(dstp + x, red_by_2_avx512(s0, s1, s1, one), w - x);
+        }
+    }
+}
+
+
+template <bool STREAM>
+static void reduceby2_v_rgba_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey_avx512<STREAM>(srcp, dstp, width * 4, height, sstride, dstride);
+}
+
+
+// ReduceBy2 for RGB888
+// 32 pixels are deinterleaved into even/odd/next RGBA pixels with vpermb.
+static F_INLINE __m512i red_by_2_h_rgb888_avx512(
+    const __m512i& s0, const __m512i& s1, const __m512i& even,
+    const __m512i& odd, const __m512i& next, const __m512i& pack,
+    const __m512i& one)
+{
+    __m512i ret = red_by_2_avx512(
+        _mm512_permutex2var_epi8(s0, even, s1),
+        _mm512_permutex2var_epi8(s0, odd, s1),
+        _mm512_permutex2var_epi8(s0, next, s1), one);
+    return _mm512_permutexvar_epi8(pack, ret);
+}
+
+
+static void reduceby2_hv_rgb888_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = width * 3;
+    const ptrdiff_t dsize = (width - 1) / 2 * 3;
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = load_idx(rgb888_even_idx);
+    const __m512i odd = load_idx(rgb888_odd_idx);
+    const __m512i next = load_idx(rgb888_next_idx);
+    const __m512i pack = load_idx(rgb888_pack_idx);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+
+        for (size_t x = 0; x < width - 2; x += 32) {
+            const ptrdiff_t n = rowsize - 3 * x;
+            __m512i s0 = red_by_2_avx512(
+                load512(srcp + 3 * x, n), load512(sb + 3 * x, n),
+                load512(sc + 3 * x, n), one);
+            __m512i s1 = red_by_2_avx512(
+                load512(srcp + 3 * x + 64, n - 64),
+                load512(sb + 3 * x + 64, n - 64),
+                load512(sc + 3 * x + 64, n - 64), one);
+            s0 = red_by_2_h_rgb888_avx512(s0, s1, even, odd, next, pack, one);
+            storeu512(dstp + 3 * x / 2, s0,
+                      std::min<ptrdiff_t>(dsize - 3 * x / 2, 48));
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGB24*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGB24*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGB24>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        for (size_t x = 0; x < width - 2; x += 32) {
+            const ptrdiff_t n = rowsize - 3 * x;
+            __m512i t = load512(sb + 3 * x, n);
+            __m512i s0 = red_by_2_avx512(load512(srcp + 3 * x, n), t, t, one);
+            t = load512(sb + 3 * x + 64, n - 64);
+            __m512i s1 = red_by_2_avx512(
+                load512(srcp + 3 * x + 64, n - 64), t, t, one);
+            s0 = red_by_2_h_rgb888_avx512(s0, s1, even, odd, next, pack, one);
+            storeu512(dstp + 3 * x / 2, s0,
+                      std::min<ptrdiff_t>(dsize - 3 * x / 2, 48));
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto sc = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto sd = reinterpret_cast<const RGB24*>(sb) + width - 2;
+            *d = (
+                RGBAi(sc[0], 1) + RGBAi(sc[1], 3) +
+                RGBAi(sd[0], 3) + RGBAi(sd[1], 9)).div16<RGB24>();
+        }
+    }
+}
+
+
+static void reduceby2_h_rgb888_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const ptrdiff_t rowsize = width * 3;
+    const ptrdiff_t dsize = (width - 1) / 2 * 3;
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i even = load_idx(rgb888_even_idx);
+    const __m512i odd = load_idx(rgb888_odd_idx);
+    const __m512i next = load_idx(rgb888_next_idx);
+    const __m512i pack = load_idx(rgb888_pack_idx);
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width - 2; x += 32) {
+            const ptrdiff_t n = rowsize - 3 * x;
+            __m512i ret = red_by_2_h_rgb888_avx512(
+                load512(srcp + 3 * x, n), load512(srcp + 3 * x + 64, n - 64),
+                even, odd, next, pack, one);
+            storeu512(dstp + 3 * x / 2, ret,
+                      std::min<ptrdiff_t>(dsize - 3 * x / 2, 48));
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            *d = (RGBAi(s[0]) + RGBAi(s[1], 3)).div4<RGB24>();
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void reduceby2_v_rgb888_avx512(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey_avx512<true>(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+#endif // __AVX512BW__ && __AVX512VBMI__
+
+#endif // REDUCE_BY_2_FUNCTIONS_AVX512_H
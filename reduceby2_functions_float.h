@@ -0,0 +1,345 @@
+/*
+    reduceby2_functions_float.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef REDUCE_BY_2_FUNCTIONS_FLOAT_H
+#define REDUCE_BY_2_FUNCTIONS_FLOAT_H
+
+#include "rh_common.h"
+
+// Kernels for GREYF32, RGBF32 and RGBAF32. CH is the number of channels.
+// Columns are reduced first and the sums are taken in the same order in C and
+// SIMD, so the results are the same.
+
+
+// a + 2b + c, and a + 3b for the last one of even size.
+static F_INLINE float red_by_2_f(const float a, const float b, const float c)
+{
+    return (a + c) + 2.0f * b;
+}
+
+static F_INLINE float red_by_2_last_f(const float a, const float b)
+{
+    return a + 3.0f * b;
+}
+
+
+// ReduceBy2 for float formats (no SIMD)
+// Makes an output row from the rows sa, sb and sc (or sa and sb for the last
+// row of even height).
+template <int CH, bool LAST>
+static F_INLINE void reduceby2_row_float_c(
+    const float* sa, const float* sb, const float* sc, float* d, const size_t width) noexcept
+{
+    auto col = [=](const size_t p) {
+        return LAST ? red_by_2_last_f(sa[p], sb[p]) : red_by_2_f(sa[p], sb[p], sc[p]);
+    };
+    auto w = (width - 2) * CH;
+
+    for (size_t x = 0; x < w; x += 2 * CH) {
+        for (int c = 0; c < CH; ++c) {
+            auto p = x + c;
+            d[x / 2 + c] = red_by_2_f(col(p), col(p + CH), col(p + 2 * CH)) * 0.0625f;
+        }
+    }
+    if ((width & 1) == 0) {
+        for (int c = 0; c < CH; ++c) {
+            auto p = w + c;
+            d[w / 2 + c] = red_by_2_last_f(col(p), col(p + CH)) * 0.0625f;
+        }
+    }
+}
+
+
+template <int CH>
+static void reduceby2_hv_float_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < height - 2; y += 2) {
+        reduceby2_row_float_c<CH, false>(
+            reinterpret_cast<const float*>(srcp),
+            reinterpret_cast<const float*>(srcp + sstride),
+            reinterpret_cast<const float*>(srcp + 2 * sstride),
+            reinterpret_cast<float*>(dstp), width);
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        reduceby2_row_float_c<CH, true>(
+            reinterpret_cast<const float*>(srcp),
+            reinterpret_cast<const float*>(srcp + sstride), nullptr,
+            reinterpret_cast<float*>(dstp), width);
+    }
+}
+
+
+template <int CH>
+static void reduceby2_h_float_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = (width - 2) * CH;
+
+    for (size_t y = 0; y < height; ++y) {
+        auto s = reinterpret_cast<const float*>(srcp);
+        auto d = reinterpret_cast<float*>(dstp);
+        for (size_t x = 0; x < w; x += 2 * CH) {
+            for (int c = 0; c < CH; ++c) {
+                auto p = x + c;
+                d[x / 2 + c] = red_by_2_f(s[p], s[p + CH], s[p + 2 * CH]) * 0.25f;
+            }
+        }
+        if ((width & 1) == 0) {
+            for (int c = 0; c < CH; ++c) {
+                d[w / 2 + c] = red_by_2_last_f(s[w + c], s[w + CH + c]) * 0.25f;
+            }
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <int CH>
+static void reduceby2_v_float_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH;
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sa = reinterpret_cast<const float*>(srcp);
+        auto sb = reinterpret_cast<const float*>(srcp + sstride);
+        auto sc = reinterpret_cast<const float*>(srcp + 2 * sstride);
+        auto d = reinterpret_cast<float*>(dstp);
+        for (size_t x = 0; x < w; ++x) {
+            d[x] = red_by_2_f(sa[x], sb[x], sc[x]) * 0.25f;
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sa = reinterpret_cast<const float*>(srcp);
+        auto sb = reinterpret_cast<const float*>(srcp + sstride);
+        auto d = reinterpret_cast<float*>(dstp);
+        for (size_t x = 0; x < w; ++x) {
+            d[x] = red_by_2_last_f(sa[x], sb[x]) * 0.25f;
+        }
+    }
+}
+
+
+#if defined(__SSE2__)
+
+static F_INLINE __m128 red_by_2_ps(const __m128& a, const __m128& b, const __m128& c)
+{
+    return _mm_add_ps(_mm_add_ps(a, c), _mm_add_ps(b, b));
+}
+
+static F_INLINE __m128 red_by_2_last_ps(const __m128& a, const __m128& b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(b, _mm_set1_ps(3.0f)));
+}
+
+
+// Columns of rows [0, 3), or [0, 2) for the last row of even height.
+template <bool ALIGNED, bool LAST>
+static F_INLINE __m128 red_by_2_col_ps(const uint8_t* s, const ptrdiff_t sstride)
+{
+    __m128 a = load_ps<ALIGNED>(s);
+    __m128 b = load_ps<ALIGNED>(s + sstride);
+    return LAST ? red_by_2_last_ps(a, b)
+        : red_by_2_ps(a, b, load_ps<ALIGNED>(s + 2 * sstride));
+}
+
+
+// ReduceBy2 for GREYF32 (CH = 1) and RGBAF32 (CH = 4)
+// The last output pixel of even width is left to the C kernel.
+template <int CH, bool ALIGNED, bool STREAM, bool LAST>
+static F_INLINE void reduceby2_row_float(
+    const uint8_t* s, uint8_t* d, const size_t width, const ptrdiff_t sstride) noexcept
+{
+    constexpr size_t bpp = CH * 4;
+    const __m128 sixteenth = _mm_set1_ps(0.0625f);
+
+    __m128 a = red_by_2_col_ps<ALIGNED, LAST>(s, sstride);
+    __m128 b = red_by_2_col_ps<ALIGNED, LAST>(s + 16, sstride);
+    __m128 f0 = first_ps<CH>(a, b), s0 = second_ps<CH>(a, b);
+
+    for (size_t x = 0; x < (width - 2) * bpp; x += 32) {
+        a = red_by_2_col_ps<ALIGNED, LAST>(s + x + 32, sstride);
+        b = red_by_2_col_ps<ALIGNED, LAST>(s + x + 48, sstride);
+        __m128 f1 = first_ps<CH>(a, b), s1 = second_ps<CH>(a, b);
+        __m128 r = red_by_2_ps(f0, s0, next_ps<CH>(f0, f1));
+        store_ps<STREAM>(d + x / 2, _mm_mul_ps(r, sixteenth));
+        f0 = f1;
+        s0 = s1;
+    }
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_hv_float(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    constexpr size_t bpp = CH * 4;
+    auto s = srcp;
+    auto d = dstp;
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        reduceby2_row_float<CH, ALIGNED, STREAM, false>(s, d, width, sstride);
+        s += 2 * sstride;
+        d += dstride;
+    }
+    if ((height & 1) == 0) {
+        reduceby2_row_float<CH, ALIGNED, STREAM, true>(s, d, width, sstride);
+    }
+    if ((width & 1) == 0) {
+        reduceby2_hv_float_c<CH>(srcp + (width - 2) * bpp, dstp + (width / 2 - 1) * bpp,
+                                 2, height, sstride, dstride);
+    }
+}
+
+
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_h_float(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    constexpr size_t bpp = CH * 4;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    auto s = srcp;
+    auto d = dstp;
+
+    for (size_t y = 0; y < height; ++y) {
+        __m128 a = load_ps<ALIGNED>(s);
+        __m128 b = load_ps<ALIGNED>(s + 16);
+        __m128 f0 = first_ps<CH>(a, b), s0 = second_ps<CH>(a, b);
+
+        for (size_t x = 0; x < (width - 2) * bpp; x += 32) {
+            a = load_ps<ALIGNED>(s + x + 32);
+            b = load_ps<ALIGNED>(s + x + 48);
+            __m128 f1 = first_ps<CH>(a, b), s1 = second_ps<CH>(a, b);
+            __m128 r = red_by_2_ps(f0, s0, next_ps<CH>(f0, f1));
+            store_ps<STREAM>(d + x / 2, _mm_mul_ps(r, quarter));
+            f0 = f1;
+            s0 = s1;
+        }
+        s += sstride;
+        d += dstride;
+    }
+    if ((width & 1) == 0) {
+        reduceby2_h_float_c<CH>(srcp + (width - 2) * bpp, dstp + (width / 2 - 1) * bpp,
+                                2, height, sstride, dstride);
+    }
+}
+
+
+// CH = 3 is also fine.
+template <int CH, bool ALIGNED, bool STREAM>
+static void reduceby2_v_float(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto w = width * CH * 4;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m128 r = red_by_2_col_ps<ALIGNED, false>(srcp + x, sstride);
+            store_ps<STREAM>(dstp + x, _mm_mul_ps(r, quarter));
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        for (size_t x = 0; x < w; x += 16) {
+            __m128 r = red_by_2_col_ps<ALIGNED, true>(srcp + x, sstride);
+            store_ps<STREAM>(dstp + x, _mm_mul_ps(r, quarter));
+        }
+    }
+}
+
+
+// ReduceBy2 for RGBF32
+// Pixels are loaded one by one as bilinear_hv_rgbf32().
+template <bool LAST>
+static F_INLINE void reduceby2_row_rgbf32(
+    const uint8_t* s, uint8_t* d, const size_t n, const ptrdiff_t sstride) noexcept
+{
+    const __m128 sixteenth = _mm_set1_ps(0.0625f);
+
+    for (size_t x = 0; x < n; ++x) {
+        __m128 r = red_by_2_ps(
+            red_by_2_col_ps<false, LAST>(s + 24 * x, sstride),
+            red_by_2_col_ps<false, LAST>(s + 24 * x + 12, sstride),
+            red_by_2_col_ps<false, LAST>(s + 24 * x + 24, sstride));
+        _mm_storeu_ps(reinterpret_cast<float*>(d + 12 * x), _mm_mul_ps(r, sixteenth));
+    }
+}
+
+
+static void reduceby2_hv_rgbf32(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 3) / 2;
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height - 2; y += 2) {
+        reduceby2_row_rgbf32<false>(s, d, n, sstride);
+        s += 2 * sstride;
+        d += dstride;
+    }
+    if ((height & 1) == 0) {
+        reduceby2_row_rgbf32<true>(s, d, n, sstride);
+    }
+    reduceby2_hv_float_c<3>(
+        srcp + 24 * n, dstp + 12 * n, width - 2 * n, height, sstride, dstride);
+}
+
+
+static void reduceby2_h_rgbf32(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t n = (width - 3) / 2;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < n; ++x) {
+            __m128 r = red_by_2_ps(
+                load_ps<false>(s + 24 * x), load_ps<false>(s + 24 * x + 12),
+                load_ps<false>(s + 24 * x + 24));
+            _mm_storeu_ps(reinterpret_cast<float*>(d + 12 * x), _mm_mul_ps(r, quarter));
+        }
+        s += sstride;
+        d += dstride;
+    }
+    reduceby2_h_float_c<3>(
+        srcp + 24 * n, dstp + 12 * n, width - 2 * n, height, sstride, dstride);
+}
+
+#endif // __SSE2__
+
+#endif // REDUCE_BY_2_FUNCTIONS_FLOAT_H
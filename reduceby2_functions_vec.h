@@ -0,0 +1,373 @@
+/*
+    reduceby2_functions_vec.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef REDUCE_BY_2_FUNCTIONS_VEC_H
+#define REDUCE_BY_2_FUNCTIONS_VEC_H
+
+#include "rh_common.h"
+
+#if defined(RH_VECTOR_EXT)
+
+// These are the same as the SSE2/SSSE3 kernels, written with generic vectors.
+
+// ReduceBy2 helper (same rounding as red_by_2)
+static F_INLINE vu8x16 red_by_2_vec(
+    const vu8x16& s0, const vu8x16& s1, const vu8x16& s2, const vu8x16& one)
+{
+    return avgv(avgv(s0, s1), subsv(avgv(s2, s1), one));
+}
+
+
+// ReduceBy2 for RGBA
+static F_INLINE vu8x16 red_by_2_h_rgba_vec(
+    const vu8x16& _l, const vu8x16& _c, const vu8x16& _r, const vu8x16& one)
+{
+    vu8x16 l = RH_SHUFFLE(_l, _c,
+        0, 1, 2, 3, 8, 9, 10, 11, 16, 17, 18, 19, 24, 25, 26, 27);
+    vu8x16 c = RH_SHUFFLE(_l, _c,
+        4, 5, 6, 7, 12, 13, 14, 15, 20, 21, 22, 23, 28, 29, 30, 31);
+    vu8x16 r = RH_SHUFFLE(l, _r,
+        4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19);
+    return red_by_2_vec(l, c, r, one);
+}
+
+
+static void reduceby2_hv_rgba_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        vu8x16 left = red_by_2_vec(loadv(srcp), loadv(sb), loadv(sc), one);
+
+        for (size_t x = 0; x < width - 2; x += 8) {
+            vu8x16 center = red_by_2_vec(
+                loadv(srcp + 4 * x + 16), loadv(sb + 4 * x + 16),
+                loadv(sc + 4 * x + 16), one);
+
+            vu8x16 right = red_by_2_vec(
+                loadv(srcp + 4 * x + 32), loadv(sb + 4 * x + 32),
+                loadv(sc + 4 * x + 32), one);
+
+            storev(dstp + 2 * x, red_by_2_h_rgba_vec(left, center, right, one));
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGBA*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGBA*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGBA*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGBA*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGBA>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto d = reinterpret_cast<RGBA*>(dstp);
+        auto sa = reinterpret_cast<const RGBA*>(srcp);
+        auto sb = reinterpret_cast<const RGBA*>(srcp + sstride);
+        for (size_t x = 0; x < width - 2; x += 2) {
+            d[x / 2] = (
+                RGBAi(sa[x], 1) + RGBAi(sa[x + 1], 2) + RGBAi(sa[x + 2], 1) +
+                RGBAi(sb[x], 3) + RGBAi(sb[x + 1], 6) + RGBAi(sb[x + 2], 3)
+                ).div16<RGBA>();
+
+        }
+        if ((width & 1) == 0) {
+            d[width / 2 - 1] = (
+                RGBAi(sa[width - 2], 1) + RGBAi(sa[width - 1], 3) +
+                RGBAi(sb[width - 2], 3) + RGBAi(sb[width - 1], 9)).div16<RGBA>();
+        }
+    }
+}
+
+
+static void reduceby2_h_rgba_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height; ++y) {
+        vu8x16 s0 = loadv(srcp);
+        for (size_t x = 0; x < width - 2; x += 8) {
+            vu8x16 s1 = loadv(srcp + 4 * x + 16);
+            vu8x16 s2 = loadv(srcp + 4 * x + 32);
+            storev(dstp + 2 * x, red_by_2_h_rgba_vec(s0, s1, s2, one));
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGBA*>(dstp) + width / 2 - 1;
+            auto s = reinterpret_cast<const RGBA*>(srcp) + width - 2;
+            *d = (RGBAi(s[0], 1) + RGBAi(s[1], 3)).div4<RGBA>();
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// width is the number of bytes in a row.
+static void reduceby2_v_grey_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        for (size_t x = 0; x < width; x += 16) {
+            vu8x16 ret = red_by_2_vec(
+                loadv(srcp + x), loadv(srcp + x + sstride),
+                loadv(srcp + x + 2 * sstride), one);
+            storev(dstp + x, ret);
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        for (size_t x = 0; x < width; x += 16) {
+            vu8x16 s0 = loadv(srcp + x);
+            vu8x16 s1 = loadv(srcp + x + sstride);
+            storev(dstp + x, red_by_2_vec(s0, s1, s1, one));
+        }
+    }
+}
+
+
+static void reduceby2_v_rgba_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey_vec(srcp, dstp, width * 4, height, sstride, dstride);
+}
+
+
+// ReduceBy2 for GREY8
+static F_INLINE vu8x16 red_by_2_h_grey_vec(
+    const vu8x16& l0, const vu8x16& l1, const vu8x16& l2, const vu8x16& one)
+{
+    vu8x16 l = RH_SHUFFLE(l0, l1,
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    vu8x16 m = RH_SHUFFLE(l0, l1,
+        1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    vu8x16 r = RH_SHUFFLE(l, l2,
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+    return red_by_2_vec(l, m, r, one);
+}
+
+
+static void reduceby2_hv_grey_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        vu8x16 left = red_by_2_vec(loadv(srcp), loadv(sb), loadv(sc), one);
+
+        for (size_t x = 0; x < width - 2; x += 32) {
+            vu8x16 center = red_by_2_vec(
+                loadv(srcp + x + 16), loadv(sb + x + 16), loadv(sc + x + 16), one);
+
+            vu8x16 right = red_by_2_vec(
+                loadv(srcp + x + 32), loadv(sb + x + 32), loadv(sc + x + 32), one);
+
+            storev(dstp + x / 2, red_by_2_h_grey_vec(left, center, right, one));
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto w2 = width - 2;
+            auto w1 = width - 1;
+            dstp[width / 2 - 1] = (
+                srcp[w2] + 3 * srcp[w1] +
+                2 * sb[w2] + 6 * sb[w1] +
+                sc[w2] + 3 * sc[w1] + 8) / 16;
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        vu8x16 s0 = loadv(srcp);
+        vu8x16 s1 = loadv(sb);
+        vu8x16 left = red_by_2_vec(s0, s1, s1, one);
+
+        for (size_t x = 0; x < width - 2; x += 32) {
+            s0 = loadv(srcp + x + 16);
+            s1 = loadv(sb + x + 16);
+            vu8x16 center = red_by_2_vec(s0, s1, s1, one);
+
+            s0 = loadv(srcp + x + 32);
+            s1 = loadv(sb + x + 32);
+            vu8x16 right = red_by_2_vec(s0, s1, s1, one);
+
+            storev(dstp + x / 2, red_by_2_h_grey_vec(left, center, right, one));
+
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (
+                srcp[width - 2] + srcp[width - 1] * 3 +
+                sb[width - 2] * 3 + sb[width - 1] * 9 + 8) / 16;
+        }
+    }
+}
+
+
+static void reduceby2_h_grey_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height; ++y) {
+        vu8x16 left = loadv(srcp);
+
+        for (size_t x = 0; x < width - 2; x += 32) {
+            vu8x16 center = loadv(srcp + x + 16);
+            vu8x16 right = loadv(srcp + x + 32);
+            storev(dstp + x / 2, red_by_2_h_grey_vec(left, center, right, one));
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            dstp[width / 2 - 1] = (
+                srcp[width - 2] + srcp[width - 1] * 3 + 2) / 4;
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+// ReduceBy2 for RGB888
+static void reduceby2_hv_rgb888_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height - 2; y += 2) {
+        auto sb = srcp + sstride;
+        auto sc = sb + sstride;
+        vu8x16 left = expand_rgb888_vec(
+            red_by_2_vec(loadv(srcp), loadv(sb), loadv(sc), one));
+
+        for (size_t x = 0; x < width - 2; x += 8) {
+            vu8x16 center = expand_rgb888_vec(red_by_2_vec(
+                loadv(srcp + 3 * x + 12), loadv(sb + 3 * x + 12),
+                loadv(sc + 3 * x + 12), one));
+            vu8x16 right = expand_rgb888_vec(red_by_2_vec(
+                loadv(srcp + 3 * x + 24), loadv(sb + 3 * x + 24),
+                loadv(sc + 3 * x + 24), one));
+
+            center = red_by_2_h_rgba_vec(left, center, right, one);
+            storev(dstp + 3 * x / 2, pack_rgb888_vec(center));
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s0 = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto s1 = reinterpret_cast<const RGB24*>(sb) + width - 2;
+            auto s2 = reinterpret_cast<const RGB24*>(sc) + width - 2;
+            *d = (
+                RGBAi(s0[0], 1) + RGBAi(s0[1], 3) +
+                RGBAi(s1[0], 2) + RGBAi(s1[1], 6) +
+                RGBAi(s2[0], 1) + RGBAi(s2[1], 3)).div16<RGB24>();
+        }
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+
+    if ((height & 1) == 0) {
+        auto sb = srcp + sstride;
+        vu8x16 s0 = loadv(srcp);
+        vu8x16 s1 = loadv(sb);
+        vu8x16 left = expand_rgb888_vec(red_by_2_vec(s0, s1, s1, one));
+
+        for (size_t x = 0; x < width - 2; x += 8) {
+            s0 = loadv(srcp + 3 * x + 12);
+            s1 = loadv(sb + 3 * x + 12);
+            vu8x16 center = expand_rgb888_vec(red_by_2_vec(s0, s1, s1, one));
+
+            s0 = loadv(srcp + 3 * x + 24);
+            s1 = loadv(sb + 3 * x + 24);
+            vu8x16 right = expand_rgb888_vec(red_by_2_vec(s0, s1, s1, one));
+
+            center = red_by_2_h_rgba_vec(left, center, right, one);
+            storev(dstp + 3 * x / 2, pack_rgb888_vec(center));
+            left = right;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto sc = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            auto sd = reinterpret_cast<const RGB24*>(sb) + width - 2;
+            *d = (
+                RGBAi(sc[0], 1) + RGBAi(sc[1], 3) +
+                RGBAi(sd[0], 3) + RGBAi(sd[1], 9)).div16<RGB24>();
+        }
+    }
+}
+
+
+static void reduceby2_h_rgb888_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const vu8x16 one = setv(1);
+
+    for (size_t y = 0; y < height; ++y) {
+        vu8x16 s0 = expand_rgb888_vec(loadv(srcp));
+        for (size_t x = 0; x < width - 2; x += 8) {
+            vu8x16 s1 = expand_rgb888_vec(loadv(srcp + 3 * x + 12));
+            vu8x16 s2 = expand_rgb888_vec(loadv(srcp + 3 * x + 24));
+            vu8x16 ret = red_by_2_h_rgba_vec(s0, s1, s2, one);
+            storev(dstp + 3 * x / 2, pack_rgb888_vec(ret));
+            s0 = s2;
+        }
+        if ((width & 1) == 0) {
+            auto d = reinterpret_cast<RGB24*>(dstp) + width / 2 - 1;
+            auto s = reinterpret_cast<const RGB24*>(srcp) + width - 2;
+            *d = (RGBAi(s[0]) + RGBAi(s[1], 3)).div4<RGB24>();
+        }
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+static void reduceby2_v_rgb888_vec(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    reduceby2_v_grey_vec(srcp, dstp, width * 3, height, sstride, dstride);
+}
+
+#endif // RH_VECTOR_EXT
+
+#endif // REDUCE_BY_2_FUNCTIONS_VEC_H
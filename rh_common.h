@@ -16,6 +16,7 @@
 #ifndef RH_COMMON_H
 #define RH_COMMON_H
 
+#include <cstddef>
 #include <cstdint>
 #include <algorithm>
 
@@ -25,10 +26,16 @@
         #pragma warning(disable: 4505)
         #define __SSE2__
         #define __SSSE3__
+        #if defined(__AVX512BW__)
+            // MSVC has no switch for VBMI, /arch:AVX512 is taken as enough.
+            #define __AVX512VBMI__
+        #endif
     #endif
 #endif
 
-#if defined(__SSSE3__)
+#if defined(__AVX2__) || defined(__AVX512BW__)
+    #include <immintrin.h>
+#elif defined(__SSSE3__)
     #include <tmmintrin.h>
 #elif defined(__SSE2__)
     #include <emmintrin.h>
@@ -42,6 +49,77 @@
     #define F_INLINE __forceinline
 #endif
 
+// Generic vectors of GCC/clang are used instead of SSE2 on other CPUs.
+// Define RESIZE_HALF_FORCE_VECTOR to use them on x86 too.
+#if defined(__GNUC__) && (!defined(__SSE2__) || defined(RESIZE_HALF_FORCE_VECTOR))
+    #define RH_VECTOR_EXT
+    #include <cstring>
+#endif
+
+
+enum ProcType : int {
+    PROC_HV,
+    PROC_H,
+    PROC_V,
+};
+
+enum : int {
+    UNALIGNED_IMAGE = 0,
+    ALIGNED_IMAGE = (1 << 16),
+    CACHED_STORE = (1 << 17),   // dst is read again soon, do not stream to it.
+};
+
+// Interleaved U and V of NV12 (2 bytes per pixel). This is not a format of
+// ResizeHalf::FMT, but is used for the flag of the chroma plane.
+enum : int {
+    UV88 = 0x80 | 2,
+};
+
+
+typedef void (*proc_func_t)(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride);
+
+// Returns nullptr if the kernels were not built or flag is not supported.
+proc_func_t get_proc_avx2(const int pt, const int flag) noexcept;
+proc_func_t get_proc_avx512(const int pt, const int flag) noexcept;
+proc_func_t get_proc_vec(const int pt, const int flag) noexcept;
+
+
+// Returns the size of the largest cache from the deterministic cache parameters
+// of cpuid(regs, leaf, subleaf), or 0. Leaf 4 is used on Intel. AMD reports
+// leaf 4 too, but with no caches, so 0x8000001D is tried then.
+template <typename F>
+static inline size_t cache_size_from_cpuid(F cpuid) noexcept
+{
+    int regs[4] = {};
+    cpuid(regs, 0, 0);
+    const int max_leaf = regs[0];
+    cpuid(regs, static_cast<int>(0x80000000), 0);
+    const unsigned max_ext = static_cast<unsigned>(regs[0]);
+
+    auto largest = [&](const int leaf) {
+        size_t size = 0;
+        for (int i = 0; i < 16; ++i) {
+            cpuid(regs, leaf, i);
+            if ((regs[0] & 0x1F) == 0) {
+                break;
+            }
+            const size_t ways = ((static_cast<unsigned>(regs[1]) >> 22) & 0x3FF) + 1;
+            const size_t partitions = ((regs[1] >> 12) & 0x3FF) + 1;
+            const size_t line = (regs[1] & 0xFFF) + 1;
+            const size_t sets = static_cast<unsigned>(regs[2]) + 1u;
+            size = std::max(size, ways * partitions * line * sets);
+        }
+        return size;
+    };
+    size_t size = max_leaf >= 4 ? largest(4) : 0;
+    if (size == 0 && max_ext >= 0x8000001Du) {
+        size = largest(static_cast<int>(0x8000001D));
+    }
+    return size;
+}
+
 
 struct RGB24 {
     uint8_t r, g, b;
@@ -127,7 +205,309 @@ static F_INLINE void storeu(void* d, const __m128i& v)
 {
     _mm_storeu_si128(reinterpret_cast<__m128i*>(d), v);
 }
+
+// Streams to aligned d, or stores through the cache if the data is read soon.
+template <bool STREAM>
+static F_INLINE void store(void* d, const __m128i& v)
+{
+    if (STREAM) {
+        stream(d, v);
+    } else {
+        _mm_store_si128(reinterpret_cast<__m128i*>(d), v);
+    }
+}
+
+// Helpers for 16bit formats. Samples (CH = 1) or pixels (CH = 4) in a vector are
+// taken in pairs, and the first or second ones of the pairs are widened to 32bit.
+template <int CH>
+static F_INLINE __m128i first16(const __m128i& v)
+{
+    if (CH == 1) {
+        return _mm_srli_epi32(_mm_slli_epi32(v, 16), 16);
+    } else {
+        return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+    }
+}
+
+template <int CH>
+static F_INLINE __m128i second16(const __m128i& v)
+{
+    if (CH == 1) {
+        return _mm_srli_epi32(v, 16);
+    } else {
+        return _mm_unpackhi_epi16(v, _mm_setzero_si128());
+    }
+}
+
+// The first ones of the pairs next to those of f. n is first16() of the next vector.
+template <int CH>
+static F_INLINE __m128i next16(const __m128i& f, const __m128i& n)
+{
+    if (CH == 1) {
+        return _mm_or_si128(_mm_srli_si128(f, 4), _mm_slli_si128(n, 12));
+    } else {
+        return n;
+    }
+}
+
+// Packs 32bit integers in [0, 65535] to 16bit (_mm_packus_epi32 is SSE4.1).
+static F_INLINE __m128i pack_u32(const __m128i& a, const __m128i& b)
+{
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    return _mm_xor_si128(
+        _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias)),
+        _mm_set1_epi16(-0x8000));
+}
+
+// Loads a pixel of RGB48 to 32bit. The 4th element is junk.
+static F_INLINE __m128i load_rgb48(const uint8_t* s)
+{
+    return _mm_unpacklo_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s)), _mm_setzero_si128());
+}
+
+// Moves the even UV pairs to the lower half and the odd ones to the upper half.
+static F_INLINE __m128i even_odd_uv(const __m128i& v)
+{
+    __m128i t = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+    t = _mm_shufflehi_epi16(t, _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm_shuffle_epi32(t, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Helpers for float formats.
+template <bool ALIGNED>
+static F_INLINE __m128 load_ps(const uint8_t* s)
+{
+    auto p = reinterpret_cast<const float*>(s);
+    return ALIGNED ? _mm_load_ps(p) : _mm_loadu_ps(p);
+}
+
+template <bool STREAM>
+static F_INLINE void store_ps(uint8_t* d, const __m128& v)
+{
+    auto p = reinterpret_cast<float*>(d);
+    if (STREAM) {
+        _mm_stream_ps(p, v);
+    } else {
+        _mm_store_ps(p, v);
+    }
+}
+
+// Samples (CH = 1) or pixels (CH = 4) of two vectors are taken in pairs, and
+// the first or second ones of the pairs are returned.
+template <int CH>
+static F_INLINE __m128 first_ps(const __m128& a, const __m128& b)
+{
+    return CH == 1 ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)) : a;
+}
+
+template <int CH>
+static F_INLINE __m128 second_ps(const __m128& a, const __m128& b)
+{
+    return CH == 1 ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)) : b;
+}
+
+// The first ones of the pairs next to those of f. n is first_ps() of the next vectors.
+template <int CH>
+static F_INLINE __m128 next_ps(const __m128& f, const __m128& n)
+{
+    if (CH == 1) {
+        return _mm_castsi128_ps(_mm_or_si128(
+            _mm_srli_si128(_mm_castps_si128(f), 4), _mm_slli_si128(_mm_castps_si128(n), 12)));
+    } else {
+        return n;
+    }
+}
 #endif
 
+#if defined(__AVX2__)
+template <bool ALIGNED>
+static F_INLINE __m256i load256(const uint8_t* _s)
+{
+    auto s = reinterpret_cast<const __m256i*>(_s);
+    if (ALIGNED) {
+        return _mm256_load_si256(s);
+    } else {
+        return _mm256_loadu_si256(s);
+    }
+}
+
+// Loads 4 pixels of RGB888 into each 128bit lane.
+static F_INLINE __m256i load_rgb888x2(const uint8_t* s)
+{
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(load<false>(s)), load<false>(s + 12), 1);
+}
+
+static F_INLINE void stream256(void* d, const __m256i& v)
+{
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(d), v);
+}
+
+static F_INLINE void storeu256(void* d, const __m256i& v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d), v);
+}
+
+template <bool STREAM>
+static F_INLINE void store256(void* d, const __m256i& v)
+{
+    if (STREAM) {
+        stream256(d, v);
+    } else {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(d), v);
+    }
+}
+#endif
+
+#if defined(RH_VECTOR_EXT)
+typedef uint8_t vu8x16 __attribute__((vector_size(16)));
+
+#if defined(__clang__)
+    #define RH_SHUFFLE(a, b, ...) __builtin_shufflevector(a, b, __VA_ARGS__)
+#else
+    #define RH_SHUFFLE(a, b, ...) __builtin_shuffle(a, b, vu8x16{__VA_ARGS__})
+#endif
+
+static F_INLINE vu8x16 loadv(const uint8_t* s)
+{
+    vu8x16 v;
+    std::memcpy(&v, s, sizeof(v));
+    return v;
+}
+
+static F_INLINE void storev(uint8_t* d, const vu8x16& v)
+{
+    std::memcpy(d, &v, sizeof(v));
+}
+
+static F_INLINE vu8x16 setv(const uint8_t x)
+{
+    return vu8x16{} + x;
+}
+
+// Same as _mm_avg_epu8.
+static F_INLINE vu8x16 avgv(const vu8x16& a, const vu8x16& b)
+{
+    return (a | b) - ((a ^ b) >> 1);
+}
+
+// Same as _mm_subs_epu8.
+static F_INLINE vu8x16 subsv(const vu8x16& a, const vu8x16& b)
+{
+    return (a > b ? a : b) - b;
+}
+
+// Expands 4 pixels of RGB888 to RGBA (A is junk), and packs them back.
+static F_INLINE vu8x16 expand_rgb888_vec(const vu8x16& v)
+{
+    return RH_SHUFFLE(v, v, 0, 1, 2, 2, 3, 4, 5, 5, 6, 7, 8, 8, 9, 10, 11, 11);
+}
+
+static F_INLINE vu8x16 pack_rgb888_vec(const vu8x16& v)
+{
+    return RH_SHUFFLE(v, v, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 15, 15, 15, 15);
+}
+#endif
+
+#if defined(__AVX512BW__) && defined(__AVX512VBMI__)
+// Mask of the first n bytes of a vector. n may be out of [0, 64].
+static F_INLINE __mmask64 tail_mask(const ptrdiff_t n)
+{
+    return n >= 64 ? ~0ULL : n <= 0 ? 0 : (1ULL << n) - 1;
+}
+
+// Loads at most n bytes. The rest is zero and never touched in memory.
+static F_INLINE __m512i load512(const uint8_t* s, const ptrdiff_t n)
+{
+    if (n >= 64) {
+        return _mm512_loadu_si512(s);
+    }
+    return _mm512_maskz_loadu_epi8(tail_mask(n), s);
+}
+
+// Stores at most n bytes. d must be aligned to 64 bytes when n >= 64.
+static F_INLINE void stream512(uint8_t* d, const __m512i& v, const ptrdiff_t n)
+{
+    if (n >= 64) {
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d), v);
+    } else {
+        _mm512_mask_storeu_epi8(d, tail_mask(n), v);
+    }
+}
+
+static F_INLINE void storeu512(uint8_t* d, const __m512i& v, const ptrdiff_t n)
+{
+    _mm512_mask_storeu_epi8(d, tail_mask(n), v);
+}
+
+template <bool STREAM>
+static F_INLINE void store512(uint8_t* d, const __m512i& v, const ptrdiff_t n)
+{
+    if (STREAM) {
+        stream512(d, v, n);
+    } else {
+        storeu512(d, v, n);
+    }
+}
+
+static F_INLINE __m512i load_idx(const uint8_t* idx)
+{
+    return _mm512_load_si512(idx);
+}
+
+// vpermb indices of even/odd bytes of two vectors and of one byte ahead.
+alignas(64) static const uint8_t grey_even_idx[64] = {
+    0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30,
+    32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62,
+    64, 66, 68, 70, 72, 74, 76, 78, 80, 82, 84, 86, 88, 90, 92, 94,
+    96, 98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126,
+};
+
+alignas(64) static const uint8_t grey_odd_idx[64] = {
+    1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31,
+    33, 35, 37, 39, 41, 43, 45, 47, 49, 51, 53, 55, 57, 59, 61, 63,
+    65, 67, 69, 71, 73, 75, 77, 79, 81, 83, 85, 87, 89, 91, 93, 95,
+    97, 99, 101, 103, 105, 107, 109, 111, 113, 115, 117, 119, 121, 123, 125, 127,
+};
+
+alignas(64) static const uint8_t grey_next_idx[64] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+    33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+    49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64,
+};
+
+// vpermb indices of even/odd/next pixels of RGB888 as RGBA (A is junk),
+// and of packing 16 pixels of RGBA back to RGB888.
+alignas(64) static const uint8_t rgb888_even_idx[64] = {
+    0, 1, 2, 2, 6, 7, 8, 8, 12, 13, 14, 14, 18, 19, 20, 20,
+    24, 25, 26, 26, 30, 31, 32, 32, 36, 37, 38, 38, 42, 43, 44, 44,
+    48, 49, 50, 50, 54, 55, 56, 56, 60, 61, 62, 62, 66, 67, 68, 68,
+    72, 73, 74, 74, 78, 79, 80, 80, 84, 85, 86, 86, 90, 91, 92, 92,
+};
+
+alignas(64) static const uint8_t rgb888_odd_idx[64] = {
+    3, 4, 5, 5, 9, 10, 11, 11, 15, 16, 17, 17, 21, 22, 23, 23,
+    27, 28, 29, 29, 33, 34, 35, 35, 39, 40, 41, 41, 45, 46, 47, 47,
+    51, 52, 53, 53, 57, 58, 59, 59, 63, 64, 65, 65, 69, 70, 71, 71,
+    75, 76, 77, 77, 81, 82, 83, 83, 87, 88, 89, 89, 93, 94, 95, 95,
+};
+
+alignas(64) static const uint8_t rgb888_next_idx[64] = {
+    6, 7, 8, 8, 12, 13, 14, 14, 18, 19, 20, 20, 24, 25, 26, 26,
+    30, 31, 32, 32, 36, 37, 38, 38, 42, 43, 44, 44, 48, 49, 50, 50,
+    54, 55, 56, 56, 60, 61, 62, 62, 66, 67, 68, 68, 72, 73, 74, 74,
+    78, 79, 80, 80, 84, 85, 86, 86, 90, 91, 92, 92, 96, 97, 98, 98,
+};
+
+alignas(64) static const uint8_t rgb888_pack_idx[64] = {
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 16, 17, 18, 20,
+    21, 22, 24, 25, 26, 28, 29, 30, 32, 33, 34, 36, 37, 38, 40, 41,
+    42, 44, 45, 46, 48, 49, 50, 52, 53, 54, 56, 57, 58, 60, 61, 62,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
 #endif
 
+#endif
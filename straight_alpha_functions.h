@@ -0,0 +1,346 @@
+/*
+    straight_alpha_functions.h
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+
+#ifndef STRAIGHT_ALPHA_FUNCTIONS_H
+#define STRAIGHT_ALPHA_FUNCTIONS_H
+
+#include "rh_common.h"
+
+// Kernels for RGBA8888_STRAIGHT (both methods).
+// Colors are premultiplied by alpha, reduced, and divided by the reduced alpha
+// in one pass. The sums are exact integers, and the division is done in float
+// in the same way in C and SIMD, so the results are the same.
+
+
+// Source rows (or columns) of the output i of n ones, and their weights.
+struct StraightTaps {
+    size_t pos;
+    int n;
+    int w[3];
+    int shift;      // log2 of the sum of weights.
+};
+
+
+static F_INLINE StraightTaps
+straight_taps(const bool bilinear, const bool reduce, const size_t n, const size_t i)
+{
+    if (!reduce) {
+        return StraightTaps{i, 1, {1, 0, 0}, 0};
+    }
+    if (bilinear) {
+        return StraightTaps{2 * i, 2, {1, 1, 0}, 1};
+    }
+    if (2 * i + 2 < n) {
+        return StraightTaps{2 * i, 3, {1, 2, 1}, 2};
+    }
+    return StraightTaps{2 * i, 2, {1, 3, 0}, 2};
+}
+
+
+// c is the weighted sum of color * alpha, and a is that of alpha.
+static F_INLINE uint8_t unpremul_c(const int c, const int a)
+{
+    if (a == 0) {
+        return 0;
+    }
+    return static_cast<uint8_t>(
+        static_cast<int>(static_cast<float>(c) / static_cast<float>(a) + 0.5f));
+}
+
+
+// Straight alpha (no SIMD)
+template <bool BILINEAR, int PT>
+static void straight_alpha_c(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    const size_t ow = PT == PROC_V ? width : width / 2;
+    const size_t oh = PT == PROC_H ? height : height / 2;
+
+    for (size_t y = 0; y < oh; ++y) {
+        auto ty = straight_taps(BILINEAR, PT != PROC_H, height, y);
+        auto d = reinterpret_cast<RGBA*>(dstp + static_cast<ptrdiff_t>(y) * dstride);
+        for (size_t x = 0; x < ow; ++x) {
+            auto tx = straight_taps(BILINEAR, PT != PROC_V, width, x);
+            int r = 0, g = 0, b = 0, a = 0;
+            for (int i = 0; i < ty.n; ++i) {
+                auto s = reinterpret_cast<const RGBA*>(srcp + static_cast<ptrdiff_t>(ty.pos + i) * sstride) + tx.pos;
+                for (int j = 0; j < tx.n; ++j) {
+                    int wa = ty.w[i] * tx.w[j] * s[j].a;
+                    r += wa * s[j].r;
+                    g += wa * s[j].g;
+                    b += wa * s[j].b;
+                    a += wa;
+                }
+            }
+            const int shift = ty.shift + tx.shift;
+            d[x] = RGBA{unpremul_c(r, a), unpremul_c(g, a), unpremul_c(b, a),
+                        static_cast<uint8_t>((a + ((1 << shift) >> 1)) >> shift)};
+        }
+    }
+}
+
+
+#if defined(__SSE2__)
+
+// Weights of rows summed before the horizontal reduction.
+enum : int {
+    ROWS_1,     // one row.
+    ROWS_11,    // 1-1 (bilinear).
+    ROWS_121,   // 1-2-1 (reduce-by-2).
+    ROWS_13,    // 1-3 (the last row of even height of reduce-by-2).
+};
+
+static constexpr int rows_shift(const int rows)
+{
+    return rows == ROWS_1 ? 0 : rows == ROWS_11 ? 1 : 2;
+}
+
+
+// Premultiplies 4 pixels at s and widens them to 32bit: [r*a, g*a, b*a, a] each.
+// The products fit in 16bit.
+template <bool ALIGNED>
+static F_INLINE void premul_rgba(const uint8_t* s, __m128i* p)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i one = _mm_set_epi16(1, 0, 0, 0, 1, 0, 0, 0);
+
+    __m128i v = load<ALIGNED>(s);
+    for (int i = 0; i < 2; ++i) {
+        __m128i x = i == 0 ? _mm_unpacklo_epi8(v, zero) : _mm_unpackhi_epi8(v, zero);
+        __m128i a = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+        x = _mm_mullo_epi16(x, _mm_or_si128(_mm_and_si128(a, rgb), one));
+        p[2 * i] = _mm_unpacklo_epi16(x, zero);
+        p[2 * i + 1] = _mm_unpackhi_epi16(x, zero);
+    }
+}
+
+
+// Premultiplied 4 pixels at s summed over the rows of ROWS.
+template <int ROWS, bool ALIGNED>
+static F_INLINE void straight_cols(const uint8_t* s, const ptrdiff_t sstride, __m128i* p)
+{
+    premul_rgba<ALIGNED>(s, p);
+    if (ROWS == ROWS_1) {
+        return;
+    }
+    __m128i q[4], r[4];
+    premul_rgba<ALIGNED>(s + sstride, q);
+    if (ROWS == ROWS_121) {
+        premul_rgba<ALIGNED>(s + 2 * sstride, r);
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (ROWS == ROWS_11) {
+            p[i] = _mm_add_epi32(p[i], q[i]);
+        } else if (ROWS == ROWS_121) {
+            p[i] = _mm_add_epi32(_mm_add_epi32(p[i], r[i]), _mm_slli_epi32(q[i], 1));
+        } else {
+            p[i] = _mm_add_epi32(_mm_add_epi32(p[i], q[i]), _mm_slli_epi32(q[i], 1));
+        }
+    }
+}
+
+
+static F_INLINE __m128i sum_121(const __m128i& a, const __m128i& b, const __m128i& c)
+{
+    return _mm_add_epi32(_mm_add_epi32(a, c), _mm_slli_epi32(b, 1));
+}
+
+
+// Divides the colors of a pixel of sums by its alpha, and rounds the alpha
+// whose weights total 1 << SHIFT. Colors are 0 if the alpha is 0.
+template <int SHIFT>
+static F_INLINE __m128i unpremul_rgba(const __m128i& s)
+{
+    const __m128i amask = _mm_set_epi32(-1, 0, 0, 0);
+    __m128i a = _mm_shuffle_epi32(s, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 q = _mm_add_ps(
+        _mm_div_ps(_mm_cvtepi32_ps(s), _mm_cvtepi32_ps(a)), _mm_set1_ps(0.5f));
+    __m128i c = _mm_and_si128(
+        _mm_cvttps_epi32(q), _mm_cmpgt_epi32(a, _mm_setzero_si128()));
+    __m128i alpha = _mm_srli_epi32(
+        _mm_add_epi32(s, _mm_set1_epi32((1 << SHIFT) >> 1)), SHIFT);
+    return _mm_or_si128(_mm_andnot_si128(amask, c), _mm_and_si128(amask, alpha));
+}
+
+
+static F_INLINE __m128i pack_rgba(const __m128i* o)
+{
+    return _mm_packus_epi16(_mm_packs_epi32(o[0], o[1]), _mm_packs_epi32(o[2], o[3]));
+}
+
+
+// Output rows made from the source rows at s.
+template <int ROWS, bool ALIGNED, bool STREAM>
+static F_INLINE void reduceby2_row_straight(
+    const uint8_t* s, uint8_t* d, const size_t width, const ptrdiff_t sstride) noexcept
+{
+    constexpr int shift = rows_shift(ROWS) + 2;
+    __m128i l[4], c[4], r[4], o[4];
+
+    straight_cols<ROWS, ALIGNED>(s, sstride, l);
+    for (size_t x = 0; x < width - 2; x += 8) {
+        straight_cols<ROWS, ALIGNED>(s + 4 * x + 16, sstride, c);
+        straight_cols<ROWS, ALIGNED>(s + 4 * x + 32, sstride, r);
+        o[0] = unpremul_rgba<shift>(sum_121(l[0], l[1], l[2]));
+        o[1] = unpremul_rgba<shift>(sum_121(l[2], l[3], c[0]));
+        o[2] = unpremul_rgba<shift>(sum_121(c[0], c[1], c[2]));
+        o[3] = unpremul_rgba<shift>(sum_121(c[2], c[3], r[0]));
+        store<STREAM>(d + 2 * x, pack_rgba(o));
+        std::copy(r, r + 4, l);
+    }
+}
+
+
+template <int ROWS, bool ALIGNED, bool STREAM>
+static F_INLINE void bilinear_row_straight(
+    const uint8_t* s, uint8_t* d, const size_t width, const ptrdiff_t sstride) noexcept
+{
+    constexpr int shift = rows_shift(ROWS) + 1;
+    __m128i l[4], c[4], o[4];
+
+    for (size_t x = 0; x < (width & ~1); x += 8) {
+        straight_cols<ROWS, ALIGNED>(s + 4 * x, sstride, l);
+        straight_cols<ROWS, ALIGNED>(s + 4 * x + 16, sstride, c);
+        o[0] = unpremul_rgba<shift>(_mm_add_epi32(l[0], l[1]));
+        o[1] = unpremul_rgba<shift>(_mm_add_epi32(l[2], l[3]));
+        o[2] = unpremul_rgba<shift>(_mm_add_epi32(c[0], c[1]));
+        o[3] = unpremul_rgba<shift>(_mm_add_epi32(c[2], c[3]));
+        store<STREAM>(d + 2 * x, pack_rgba(o));
+    }
+}
+
+
+template <int ROWS, bool ALIGNED, bool STREAM>
+static F_INLINE void vertical_row_straight(
+    const uint8_t* s, uint8_t* d, const size_t width, const ptrdiff_t sstride) noexcept
+{
+    constexpr int shift = rows_shift(ROWS);
+    __m128i p[4];
+
+    for (size_t x = 0; x < width; x += 4) {
+        straight_cols<ROWS, ALIGNED>(s + 4 * x, sstride, p);
+        for (int i = 0; i < 4; ++i) {
+            p[i] = unpremul_rgba<shift>(p[i]);
+        }
+        store<STREAM>(d + 4 * x, pack_rgba(p));
+    }
+}
+
+
+// ReduceBy2 for RGBA8888_STRAIGHT
+// The last output pixel of even width is left to the C kernel.
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_hv_straight(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height - 2; y += 2) {
+        reduceby2_row_straight<ROWS_121, ALIGNED, STREAM>(s, d, width, sstride);
+        s += 2 * sstride;
+        d += dstride;
+    }
+    if ((height & 1) == 0) {
+        reduceby2_row_straight<ROWS_13, ALIGNED, STREAM>(s, d, width, sstride);
+    }
+    if ((width & 1) == 0) {
+        straight_alpha_c<false, PROC_HV>(
+            srcp + 4 * (width - 2), dstp + 2 * (width - 2), 2, height, sstride, dstride);
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_h_straight(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    auto s = srcp;
+    auto d = dstp;
+    for (size_t y = 0; y < height; ++y) {
+        reduceby2_row_straight<ROWS_1, ALIGNED, STREAM>(s, d, width, sstride);
+        s += sstride;
+        d += dstride;
+    }
+    if ((width & 1) == 0) {
+        straight_alpha_c<false, PROC_H>(
+            srcp + 4 * (width - 2), dstp + 2 * (width - 2), 2, height, sstride, dstride);
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void reduceby2_v_straight(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < height - 2; y += 2) {
+        vertical_row_straight<ROWS_121, ALIGNED, STREAM>(srcp, dstp, width, sstride);
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+    if ((height & 1) == 0) {
+        vertical_row_straight<ROWS_13, ALIGNED, STREAM>(srcp, dstp, width, sstride);
+    }
+}
+
+
+// Bilinear Resize for RGBA8888_STRAIGHT
+template <bool ALIGNED, bool STREAM>
+static void bilinear_hv_straight(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < (height & ~1); y += 2) {
+        bilinear_row_straight<ROWS_11, ALIGNED, STREAM>(srcp, dstp, width, sstride);
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_h_straight(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < height; ++y) {
+        bilinear_row_straight<ROWS_1, ALIGNED, STREAM>(srcp, dstp, width, sstride);
+        srcp += sstride;
+        dstp += dstride;
+    }
+}
+
+
+template <bool ALIGNED, bool STREAM>
+static void bilinear_v_straight(
+    const uint8_t* srcp, uint8_t* dstp, const size_t width, const size_t height,
+    const ptrdiff_t sstride, const ptrdiff_t dstride) noexcept
+{
+    for (size_t y = 0; y < (height & ~1); y += 2) {
+        vertical_row_straight<ROWS_11, ALIGNED, STREAM>(srcp, dstp, width, sstride);
+        srcp += 2 * sstride;
+        dstp += dstride;
+    }
+}
+
+#endif // __SSE2__
+
+#endif // STRAIGHT_ALPHA_FUNCTIONS_H
@@ -0,0 +1,326 @@
+/*
+    test_cli.cpp
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+// Tests of the resizehalf command, of which the path is the argument. Files
+// are made in a temporary directory. Returns 1 if any check fails.
+// POSIX only.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+static int failures = 0;
+
+#define CHECK(cond, what) do { \
+    if (!(cond)) { \
+        ++failures; \
+        if (failures <= 20) { \
+            std::printf("%s:%d: %s: %s\n", __FILE__, __LINE__, #cond, \
+                        std::string(what).c_str()); \
+        } \
+    } \
+} while (0)
+
+
+static std::string cli;
+static std::string dir;
+
+
+// Pixels of rows of bpp bytes, top first and without padding.
+struct Picture {
+    size_t width;
+    size_t height;
+    size_t bpp;
+    std::vector<uint8_t> pixels;
+};
+
+
+static void put_le(std::vector<uint8_t>& v, const uint32_t x, const int bytes)
+{
+    for (int i = 0; i < bytes; ++i) {
+        v.push_back(static_cast<uint8_t>(x >> (8 * i)));
+    }
+}
+
+
+static uint32_t le32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+
+static void save(const std::string& path, const std::vector<uint8_t>& v)
+{
+    std::ofstream f(path, std::ios::binary);
+    f.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(v.size()));
+}
+
+
+static std::vector<uint8_t> load(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f),
+                                std::istreambuf_iterator<char>());
+}
+
+
+static std::vector<uint8_t> ppm_of(const Picture& pic)
+{
+    const std::string h = "P6\n" + std::to_string(pic.width) + " "
+        + std::to_string(pic.height) + "\n255\n";
+    std::vector<uint8_t> v(h.begin(), h.end());
+    v.insert(v.end(), pic.pixels.begin(), pic.pixels.end());
+    return v;
+}
+
+
+// A 24bit or 32bit BMP of the same samples (in the same order) as the PPM.
+static std::vector<uint8_t> bmp_of(const Picture& pic, const bool top_down=false)
+{
+    const size_t rowsize = pic.width * pic.bpp, stride = (rowsize + 3) & ~static_cast<size_t>(3);
+    std::vector<uint8_t> v = {'B', 'M'};
+    put_le(v, static_cast<uint32_t>(54 + stride * pic.height), 4);
+    put_le(v, 0, 4);
+    put_le(v, 54, 4);
+    put_le(v, 40, 4);
+    put_le(v, static_cast<uint32_t>(pic.width), 4);
+    put_le(v, top_down ? static_cast<uint32_t>(-static_cast<int64_t>(pic.height))
+                       : static_cast<uint32_t>(pic.height), 4);
+    put_le(v, 1, 2);
+    put_le(v, static_cast<uint32_t>(pic.bpp * 8), 2);
+    put_le(v, 0, 4);
+    put_le(v, static_cast<uint32_t>(stride * pic.height), 4);
+    put_le(v, 2835, 4);
+    put_le(v, 2835, 4);
+    put_le(v, 0, 4);
+    put_le(v, 0, 4);
+    for (size_t i = 0; i < pic.height; ++i) {
+        auto row = pic.pixels.begin() + (top_down ? i : pic.height - 1 - i) * rowsize;
+        v.insert(v.end(), row, row + rowsize);
+        v.insert(v.end(), stride - rowsize, 0);
+    }
+    return v;
+}
+
+
+// Reads a PPM written by the command. Returns an empty picture if it fails.
+static Picture read_ppm(const std::string& path)
+{
+    Picture pic = {0, 0, 3, {}};
+    auto v = load(path);
+    unsigned w = 0, h = 0;
+    int n = 0;
+    std::string s(v.begin(), v.end());
+    if (std::sscanf(s.c_str(), "P6\n%u %u\n255\n%n", &w, &h, &n) != 2 || n == 0
+            || v.size() != n + static_cast<size_t>(w) * h * 3) {
+        return pic;
+    }
+    pic.width = w;
+    pic.height = h;
+    pic.pixels.assign(v.begin() + n, v.end());
+    return pic;
+}
+
+
+// Reads a 24bit BMP written by the command, in the order of the PPM.
+static Picture read_bmp(const std::string& path)
+{
+    Picture pic = {0, 0, 3, {}};
+    auto v = load(path);
+    if (v.size() < 54 || v[0] != 'B' || v[1] != 'M') {
+        return pic;
+    }
+    const size_t offset = le32(v.data() + 10);
+    const size_t w = le32(v.data() + 18);
+    const int32_t ht = static_cast<int32_t>(le32(v.data() + 22));
+    const size_t h = ht < 0 ? static_cast<size_t>(-ht) : static_cast<size_t>(ht);
+    const size_t rowsize = w * 3, stride = (rowsize + 3) & ~static_cast<size_t>(3);
+    if (v.size() != offset + stride * h || le32(v.data() + 2) != v.size()) {
+        return pic;
+    }
+    pic.width = w;
+    pic.height = h;
+    for (size_t y = 0; y < h; ++y) {
+        auto row = v.begin() + offset + (ht < 0 ? y : h - 1 - y) * stride;
+        pic.pixels.insert(pic.pixels.end(), row, row + rowsize);
+    }
+    return pic;
+}
+
+
+static Picture noise(const size_t width, const size_t height, const size_t bpp)
+{
+    Picture pic = {width, height, bpp, {}};
+    uint32_t seed = static_cast<uint32_t>(width * height);
+    for (size_t i = 0; i < width * height * bpp; ++i) {
+        seed = seed * 1103515245 + 12345;
+        pic.pixels.push_back(static_cast<uint8_t>(seed >> 16));
+    }
+    return pic;
+}
+
+
+static int run(const std::string& args)
+{
+    const std::string cmd = "\"" + cli + "\" --quiet " + args + " >/dev/null 2>&1";
+    const int st = std::system(cmd.c_str());
+    return st == -1 || !WIFEXITED(st) ? -1 : WEXITSTATUS(st);
+}
+
+
+// A bottom-up BMP gives the same pixels as the PPM of the same picture, of
+// which the odd height makes the orientation matter.
+static void test_bottom_up()
+{
+    const Picture pic = noise(75, 67, 3);
+    save(dir + "/a.ppm", ppm_of(pic));
+    save(dir + "/a.bmp", bmp_of(pic));
+
+    const char* options[] = {
+        "--mode bilinear", "--mode reduce", "--mode exact", "--mmap", "--levels 2",
+        "--levels 2 --mmap",
+    };
+    int i = 0;
+    for (auto o : options) {
+        const std::string out = dir + "/out" + std::to_string(i++);
+        mkdir(out.c_str(), 0755);
+        const bool levels = std::string(o).find("levels") != std::string::npos;
+        CHECK(run("-o " + out + " " + o + " " + dir + "/a.ppm " + dir + "/a.bmp") == 0, o);
+        for (int k = 1; k <= (levels ? 2 : 1); ++k) {
+            const std::string name = levels ? "/a." + std::to_string(k) : "/a";
+            const Picture p = read_ppm(out + name + ".ppm");
+            const Picture b = read_bmp(out + name + ".bmp");
+            CHECK(p.width == pic.width >> k && p.height == pic.height >> k, o);
+            CHECK(b.width == p.width && b.height == p.height && b.pixels == p.pixels, o);
+        }
+    }
+}
+
+
+// Outputs written by pwrite() are the same files as through mappings (small
+// images have fewer levels), also when the rows of the buffer are written as
+// they are, as those of 128 bytes of the PGM and the 32bit BMP.
+static void test_pwrite()
+{
+    const Picture grey = noise(256, 34, 1);
+    const std::string h = "P5\n256 34\n255\n";
+    std::vector<uint8_t> pgm(h.begin(), h.end());
+    pgm.insert(pgm.end(), grey.pixels.begin(), grey.pixels.end());
+    save(dir + "/g.pgm", pgm);
+    save(dir + "/c.bmp", bmp_of(noise(64, 40, 4), true));
+    save(dir + "/d.bmp", bmp_of(noise(42, 30, 3)));
+    save(dir + "/e.ppm", ppm_of(noise(51, 33, 3)));
+
+    for (const char* levels : {"1", "3"}) {
+        const std::string a = dir + "/pw" + levels, b = dir + "/mm" + levels;
+        mkdir(a.c_str(), 0755);
+        mkdir(b.c_str(), 0755);
+        const std::string in = " --levels " + std::string(levels) + " " + dir + "/g.pgm "
+            + dir + "/c.bmp " + dir + "/d.bmp " + dir + "/e.ppm";
+        CHECK(run("-o " + a + in) == 0, levels);
+        CHECK(run("-o " + b + " --mmap" + in) == 0, levels);
+        for (const char* name : {"g", "c", "d", "e"}) {
+            const char* ext = *name == 'g' ? ".pgm" : *name == 'e' ? ".ppm" : ".bmp";
+            for (int k = 1; k <= std::atoi(levels); ++k) {
+                const std::string f = std::string("/") + name
+                    + (*levels == '1' ? "" : "." + std::to_string(k)) + ext;
+                const auto x = load(a + f);
+                CHECK((k > 1 || !x.empty()) && x == load(b + f), f);
+            }
+        }
+    }
+}
+
+
+// Invalid options stop the command before it writes anything.
+static void test_options()
+{
+    save(dir + "/m.ppm", ppm_of(noise(32, 32, 3)));
+    const std::string out = dir + "/opt";
+    mkdir(out.c_str(), 0755);
+    CHECK(run("-o " + out + " --mode bicubic " + dir + "/m.ppm") == 2, "mode");
+    CHECK(run("-o " + out + " --mode " + dir + "/m.ppm") == 2, "mode");
+    CHECK(load(out + "/m.ppm").empty(), "mode");
+    CHECK(run("-o " + out + " --mode exact " + dir + "/m.ppm") == 0, "mode");
+}
+
+
+// Inputs of the same name in other directories fail instead of overwriting
+// the output of the first, and an input without an extension has levels.
+static void test_output_names()
+{
+    const std::string a = dir + "/na", b = dir + "/nb", out = dir + "/names";
+    mkdir(a.c_str(), 0755);
+    mkdir(b.c_str(), 0755);
+    mkdir(out.c_str(), 0755);
+    const Picture p = noise(64, 48, 3), q = noise(40, 40, 3);
+    save(a + "/x.ppm", ppm_of(p));
+    save(b + "/x.ppm", ppm_of(q));
+    CHECK(run("-o " + out + " " + a + "/x.ppm " + b + "/x.ppm") == 1, "same name");
+    const Picture x = read_ppm(out + "/x.ppm");
+    CHECK(x.width == p.width / 2 && x.height == p.height / 2, "same name");
+
+    save(a + "/noext", ppm_of(p));
+    CHECK(run("-o " + out + " --levels 2 " + a + "/noext") == 0, "no extension");
+    CHECK(read_ppm(out + "/noext.1").width == p.width / 2, "no extension");
+    CHECK(read_ppm(out + "/noext.2").width == p.width / 4, "no extension");
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: test_cli PATH_OF_RESIZEHALF\n");
+        return 2;
+    }
+    cli = argv[1];
+    char tmpl[] = "/tmp/resizehalf_cli_XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    dir = tmpl;
+
+    struct {
+        const char* name;
+        void (*func)();
+    } tests[] = {
+        {"bottom_up", test_bottom_up},
+        {"pwrite", test_pwrite},
+        {"options", test_options},
+        {"output_names", test_output_names},
+    };
+
+    for (auto& t : tests) {
+        const int before = failures;
+        t.func();
+        std::printf("%-20s %s\n", t.name, failures == before ? "ok" : "FAILED");
+    }
+    std::system(("rm -rf \"" + dir + "\"").c_str());
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1036 @@
+/*
+    test_resizehalf.cpp
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+// Unit tests. Results of SIMD kernels are compared with C ones, and the
+// other functions with resizeHV(). Returns 1 if any check fails.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ResizeHalf.h"
+#include "rh_common.h"
+
+
+static int failures = 0;
+
+#define CHECK(cond, what) do { \
+    if (!(cond)) { \
+        ++failures; \
+        if (failures <= 20) { \
+            std::printf("%s:%d: %s: %s\n", __FILE__, __LINE__, #cond, \
+                        std::string(what).c_str()); \
+        } \
+    } \
+} while (0)
+
+
+static const ResizeHalf::FMT formats[] = {
+    ResizeHalf::GREY8, ResizeHalf::RGB888, ResizeHalf::RGBA8888,
+    ResizeHalf::GREY16, ResizeHalf::RGB48, ResizeHalf::RGBA64,
+    ResizeHalf::GREYF32, ResizeHalf::RGBF32, ResizeHalf::RGBAF32,
+    ResizeHalf::RGBA8888_STRAIGHT,
+};
+
+static const ResizeHalf::MODE modes[] = {
+    ResizeHalf::BILINEAR, ResizeHalf::REDUCE_BY_2, ResizeHalf::REDUCE_BY_2_EXACT,
+};
+
+enum PT { HV, H, V };
+
+static const size_t sizes[][2] = {
+    {16, 16}, {17, 23}, {61, 40}, {130, 67}, {256, 19},
+};
+
+
+static size_t bpp_of(const int fmt) { return fmt & 0x3F; }
+
+// Bytes of a sample: the unit of alignment of the image.
+static size_t elem_of(const int fmt)
+{
+    return fmt & 0x40 ? 4 : fmt == ResizeHalf::GREY16 || fmt == ResizeHalf::RGB48
+        || fmt == ResizeHalf::RGBA64 ? 2 : 1;
+}
+
+static std::string name_of(const int fmt, const int mode, const int pt)
+{
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "format 0x%x mode 0x%x pt %d", fmt, mode, pt);
+    return buf;
+}
+
+
+// An image in a buffer of its own. An aligned image starts at a multiple of
+// 64 bytes. An unaligned one ends at the end of the buffer, so that reading
+// or writing after it is detected by AddressSanitizer.
+struct Image {
+    std::vector<uint8_t> mem;
+    uint8_t* p;
+    size_t width;
+    size_t height;
+    size_t stride;
+
+    Image(const int fmt, const size_t w, const size_t h, const bool aligned) :
+        width(w), height(h)
+    {
+        const size_t rowsize = w * bpp_of(fmt);
+        stride = aligned ? (rowsize + 63) & ~static_cast<size_t>(63) : rowsize;
+        const size_t size = stride * (h - 1) + rowsize;
+        if (aligned) {
+            mem.resize(size + 64);
+            p = mem.data();
+            while (reinterpret_cast<uintptr_t>(p) & 63) {
+                ++p;
+            }
+        } else {
+            mem.resize(size + 64 + elem_of(fmt));
+            p = mem.data() + 64 + elem_of(fmt);
+        }
+    }
+
+    void fill(const int fmt, unsigned seed)
+    {
+        for (size_t y = 0; y < height; ++y) {
+            uint8_t* row = p + y * stride;
+            const size_t n = width * bpp_of(fmt);
+            if (fmt & 0x40) {
+                for (size_t i = 0; i < n; i += 4) {
+                    seed = seed * 1103515245u + 12345u;
+                    float v = static_cast<float>((seed >> 8) & 0xFFFF) / 65535.0f;
+                    std::memcpy(row + i, &v, 4);
+                }
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    seed = seed * 1103515245u + 12345u;
+                    row[i] = static_cast<uint8_t>(seed >> 16);
+                }
+            }
+        }
+    }
+};
+
+
+// A copy of img with the rows in reverse order. Its top row is the last one
+// in memory, at top(), and the next row is at -stride.
+static Image flipped(const int fmt, const Image& img, const bool aligned)
+{
+    Image f(fmt, img.width, img.height, aligned);
+    for (size_t y = 0; y < img.height; ++y) {
+        std::memcpy(f.p + (img.height - 1 - y) * f.stride, img.p + y * img.stride,
+                    img.width * bpp_of(fmt));
+    }
+    return f;
+}
+
+static uint8_t* top(Image& img) { return img.p + (img.height - 1) * img.stride; }
+
+
+static void resize(ResizeHalf& r, const int pt, uint8_t* dstp, const Image& src,
+                   const size_t ds)
+{
+    if (pt == HV) {
+        r.resizeHV(dstp, src.p, src.width, src.height, ds, src.stride);
+    } else if (pt == H) {
+        r.resizeHorizontal(dstp, src.p, src.width, src.height, ds, src.stride);
+    } else {
+        r.resizeVertical(dstp, src.p, src.width, src.height, ds, src.stride);
+    }
+}
+
+
+// Returns the largest difference of samples of a and b, or -1 if they differ
+// and are not of 8bit.
+static int compare(const int fmt, const uint8_t* a, const ptrdiff_t as, const uint8_t* b,
+                   const ptrdiff_t bs, const size_t rowsize, const size_t height)
+{
+    int diff = 0;
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t* ra = a + static_cast<ptrdiff_t>(y) * as;
+        const uint8_t* rb = b + static_cast<ptrdiff_t>(y) * bs;
+        if (std::memcmp(ra, rb, rowsize) == 0) {
+            continue;
+        }
+        if (elem_of(fmt) != 1) {
+            return -1;
+        }
+        for (size_t x = 0; x < rowsize; ++x) {
+            diff = std::max(diff, std::abs(ra[x] - rb[x]));
+        }
+    }
+    return diff;
+}
+
+
+// SIMD kernels give the same results as C ones, except 8bit formats (but
+// straight alpha) of fast modes, which may differ by 1.
+static void test_simd_matches_c()
+{
+    const int best = ResizeHalf::getSupportedSimd();
+    for (auto fmt : formats) for (auto mode : modes) for (int pt = HV; pt <= V; ++pt) {
+        const bool fast = elem_of(fmt) == 1 && fmt != ResizeHalf::RGBA8888_STRAIGHT
+            && mode != ResizeHalf::REDUCE_BY_2_EXACT;
+        const int tolerance = fast ? 1 : 0;
+        for (auto& sz : sizes) for (int aligned = 0; aligned < 2; ++aligned) {
+            Image src(fmt, sz[0], sz[1], aligned != 0);
+            src.fill(fmt, static_cast<unsigned>(sz[0] * 31 + sz[1]));
+            const size_t ow = pt == V ? sz[0] : sz[0] / 2;
+            const size_t oh = pt == H ? sz[1] : sz[1] / 2;
+
+            Image ref(fmt, ow, oh, aligned != 0);
+            ResizeHalf c(fmt, mode);
+            c.setSimd(ResizeHalf::SIMD_NONE);
+            resize(c, pt, ref.p, src, ref.stride);
+
+            for (int simd = ResizeHalf::SIMD_SSE; simd <= best; ++simd) {
+                Image dst(fmt, ow, oh, aligned != 0);
+                ResizeHalf r(fmt, mode);
+                r.setSimd(static_cast<ResizeHalf::SIMD>(simd));
+                resize(r, pt, dst.p, src, dst.stride);
+                int d = compare(fmt, dst.p, dst.stride, ref.p, ref.stride,
+                                ow * bpp_of(fmt), oh);
+                char what[128];
+                std::snprintf(what, sizeof(what), "%s simd %d %zux%zu aligned %d diff %d",
+                              name_of(fmt, mode, pt).c_str(), simd, sz[0], sz[1],
+                              aligned, d);
+                CHECK(d >= 0 && d <= tolerance, what);
+            }
+        }
+    }
+}
+
+
+// The result is left in the intermediate buffer if dstp is nullptr.
+static void test_intermediate_buffer()
+{
+    for (auto fmt : formats) for (int pt = HV; pt <= V; ++pt) {
+        Image src(fmt, 61, 40, false);
+        src.fill(fmt, 7);
+        ResizeHalf r(fmt);
+        const size_t ow = pt == V ? 61 : 30, oh = pt == H ? 40 : 20;
+        Image dst(fmt, ow, oh, false);
+        resize(r, pt, dst.p, src, dst.stride);
+        resize(r, pt, nullptr, src, 0);
+        CHECK(r.getWidth() == ow && r.getHeight() == oh
+              && r.getRowsize() == ow * bpp_of(fmt), name_of(fmt, 0, pt));
+        CHECK(compare(fmt, r.data(), r.getStride(), dst.p, dst.stride,
+                      r.getRowsize(), oh) == 0, name_of(fmt, 0, pt));
+    }
+}
+
+
+// Bands processed on threads give the same results as one thread.
+static void test_threads()
+{
+    for (auto fmt : formats) for (auto mode : modes) for (int pt = HV; pt <= V; ++pt) {
+        Image src(fmt, 70, 203, false);
+        src.fill(fmt, 3);
+        ResizeHalf r(fmt, mode);
+        const size_t ow = pt == V ? 70 : 35, oh = pt == H ? 203 : 101;
+        Image a(fmt, ow, oh, false), b(fmt, ow, oh, false);
+        resize(r, pt, a.p, src, a.stride);
+        r.setThreads(4);
+        resize(r, pt, b.p, src, b.stride);
+        CHECK(compare(fmt, a.p, a.stride, b.p, b.stride, ow * bpp_of(fmt), oh) == 0,
+              name_of(fmt, mode, pt));
+    }
+}
+
+
+// Store policies give the same results.
+static void test_store_policy()
+{
+    CHECK(ResizeHalf::getCacheSize() > 0, "cache size");
+    for (auto fmt : formats) for (int pt = HV; pt <= V; ++pt) {
+        Image src(fmt, 130, 67, true);
+        src.fill(fmt, 29);
+        const size_t ow = pt == V ? 130 : 65, oh = pt == H ? 67 : 33;
+        Image ref(fmt, ow, oh, true);
+        ResizeHalf r(fmt);
+        r.setStorePolicy(ResizeHalf::STORE_STREAM);
+        resize(r, pt, ref.p, src, ref.stride);
+        for (int store = ResizeHalf::STORE_AUTO; store <= ResizeHalf::STORE_CACHED; ++store) {
+            Image dst(fmt, ow, oh, true);
+            r.setStorePolicy(static_cast<ResizeHalf::STORE>(store));
+            resize(r, pt, dst.p, src, dst.stride);
+            CHECK(compare(fmt, dst.p, dst.stride, ref.p, ref.stride, ow * bpp_of(fmt), oh) == 0,
+                  name_of(fmt, store, pt));
+        }
+    }
+}
+
+
+// CPUID of a CPU with the caches of sizes at the leaves 4 and 0x8000001D.
+// Each cache is of 16 ways and lines of 64 bytes.
+struct MockCpuid {
+    int max_leaf;
+    unsigned max_ext;
+    std::vector<size_t> leaf4;
+    std::vector<size_t> leaf8000001d;
+
+    void operator()(int regs[4], const int leaf, const int sub) const
+    {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+        const auto& caches = leaf == 4 ? leaf4 : leaf8000001d;
+        if (leaf == 0) {
+            regs[0] = max_leaf;
+        } else if (leaf == static_cast<int>(0x80000000)) {
+            regs[0] = static_cast<int>(max_ext);
+        } else if ((leaf == 4 || leaf == static_cast<int>(0x8000001D))
+                   && static_cast<size_t>(sub) < caches.size()) {
+            regs[0] = 3 | ((sub + 1) << 5);     // unified cache of level sub + 1.
+            regs[1] = (15 << 22) | 63;
+            regs[2] = static_cast<int>(caches[sub] / (16 * 64) - 1);
+        }
+    }
+};
+
+
+// The largest cache is found at leaf 4, or at 0x8000001D if leaf 4 has none.
+static void test_cache_size()
+{
+    const MockCpuid intel = {0x16, 0x80000008u, {32 << 10, 1 << 20, 30 << 20}, {}};
+    const MockCpuid amd = {0x10, 0x80000021u, {}, {32 << 10, 512 << 10, 32 << 20}};
+    const MockCpuid old = {2, 0x80000008u, {}, {}};
+    CHECK(cache_size_from_cpuid(intel) == 30u << 20, "intel");
+    CHECK(cache_size_from_cpuid(amd) == 32u << 20, "amd");
+    CHECK(cache_size_from_cpuid(old) == 0, "old");
+}
+
+
+// Vertical strips give the same results as whole rows. Rows of 192 output
+// pixels are aligned without padding, so vectors stored after the last strip
+// would be in the next row.
+static void test_tiles()
+{
+    const int best = ResizeHalf::getSupportedSimd();
+    for (auto fmt : formats) for (auto mode : modes) for (int pt = HV; pt <= V; ++pt) {
+        const size_t widths[] = {333, pt == V ? 192u : 384u};
+        for (auto sw : widths) for (int aligned = 0; aligned < 2; ++aligned) {
+            Image src(fmt, sw, 41, aligned != 0);
+            src.fill(fmt, 23);
+            const size_t ow = pt == V ? sw : sw / 2, oh = pt == H ? 41 : 20;
+            for (int simd = ResizeHalf::SIMD_NONE; simd <= best; ++simd) {
+                ResizeHalf r(fmt, mode);
+                r.setSimd(static_cast<ResizeHalf::SIMD>(simd));
+                Image a(fmt, ow, oh, aligned != 0), b(fmt, ow, oh, aligned != 0);
+                resize(r, pt, a.p, src, a.stride);
+                r.setTileWidth(64);
+                r.setThreads(2);
+                resize(r, pt, b.p, src, b.stride);
+                CHECK(compare(fmt, a.p, a.stride, b.p, b.stride, ow * bpp_of(fmt), oh) == 0,
+                      name_of(fmt, mode, pt));
+            }
+        }
+    }
+}
+
+
+// resizeHV() times times into the intermediate buffer.
+static std::vector<uint8_t> repeat_hv(ResizeHalf& r, const int fmt, const Image& src,
+                                      const int times)
+{
+    std::vector<uint8_t> cur(src.p, src.p + src.stride * (src.height - 1)
+                             + src.width * bpp_of(fmt));
+    size_t w = src.width, h = src.height, s = src.stride;
+    for (int i = 0; i < times; ++i) {
+        r.resizeHV(nullptr, cur.data(), w, h, 0, s);
+        w /= 2;
+        h /= 2;
+        s = w * bpp_of(fmt);
+        std::vector<uint8_t> next(s * h);
+        for (size_t y = 0; y < h; ++y) {
+            std::memcpy(next.data() + y * s, r.data() + y * r.getStride(), s);
+        }
+        cur.swap(next);
+    }
+    return cur;
+}
+
+
+static void test_cascade()
+{
+    for (auto fmt : formats) for (auto mode : modes) for (int times = 2; times <= 3; ++times) {
+        Image src(fmt, 300, 181, false);
+        src.fill(fmt, 11);
+        ResizeHalf r(fmt, mode);
+        auto ref = repeat_hv(r, fmt, src, times);
+        const size_t w = 300 >> times, h = 181 >> times;
+        Image dst(fmt, w, h, false);
+        for (size_t threads = 1; threads <= 3; threads += 2) {
+            r.setThreads(threads);
+            if (times == 2) {
+                r.resizeQuarter(dst.p, src.p, 300, 181, dst.stride, src.stride);
+            } else {
+                r.resizeEighth(dst.p, src.p, 300, 181, dst.stride, src.stride);
+            }
+            CHECK(compare(fmt, dst.p, dst.stride, ref.data(), w * bpp_of(fmt),
+                          w * bpp_of(fmt), h) == 0, name_of(fmt, mode, times));
+        }
+    }
+}
+
+
+static void test_pyramid()
+{
+    for (auto fmt : formats) {
+        Image src(fmt, 203, 150, false);
+        src.fill(fmt, 5);
+        ResizeHalf r(fmt);
+        auto levels = r.buildPyramid(nullptr, src.p, 203, 150, src.stride, 4);
+        // the last one is 12x9, as 6x4 would be made from a level smaller than 16x16.
+        CHECK(levels.size() == 4, name_of(fmt, 0, 0));
+        const size_t size = levels.back().offset + levels.back().stride * levels.back().height;
+        std::vector<uint8_t> pyramid(r.data(), r.data() + size);
+        for (size_t k = 0; k < levels.size(); ++k) {
+            auto ref = repeat_hv(r, fmt, src, static_cast<int>(k + 1));
+            const auto& l = levels[k];
+            CHECK(l.width == 203u >> (k + 1) && l.height == 150u >> (k + 1),
+                  name_of(fmt, 0, static_cast<int>(k)));
+            CHECK(compare(fmt, pyramid.data() + l.offset, l.stride, ref.data(),
+                          l.width * bpp_of(fmt), l.width * bpp_of(fmt), l.height) == 0,
+                  name_of(fmt, 0, static_cast<int>(k)));
+        }
+    }
+
+    // Odd heights of BILINEAR, on one thread and on threads. On one thread, the
+    // first level is made in chunks, and a chunk ends when only the last source
+    // row of the third level is missing: its last row must wait for that one.
+    const auto fmt = ResizeHalf::RGBA8888;
+    for (auto mode : modes) for (size_t threads = 1; threads <= 3; threads += 2) {
+        Image src(fmt, 1000, 263, false);
+        src.fill(fmt, 19);
+        ResizeHalf r(fmt, mode);
+        r.setThreads(threads);
+        auto levels = r.buildPyramid(nullptr, src.p, 1000, 263, src.stride, 16);
+        // the last one is 62x16.
+        CHECK(levels.size() == 4, name_of(fmt, mode, 0));
+        const size_t size = levels.back().offset + levels.back().stride * levels.back().height;
+        std::vector<uint8_t> pyramid(r.data(), r.data() + size);
+        for (size_t k = 0; k < levels.size(); ++k) {
+            auto ref = repeat_hv(r, fmt, src, static_cast<int>(k + 1));
+            const auto& l = levels[k];
+            CHECK(compare(fmt, pyramid.data() + l.offset, l.stride, ref.data(),
+                          l.width * bpp_of(fmt), l.width * bpp_of(fmt), l.height) == 0,
+                  name_of(fmt, mode, static_cast<int>(k)));
+        }
+    }
+}
+
+
+static void test_push_rows()
+{
+    for (auto fmt : formats) for (auto mode : modes) {
+        Image src(fmt, 90, 77, false);
+        src.fill(fmt, 13);
+        ResizeHalf r(fmt, mode);
+        auto ref = repeat_hv(r, fmt, src, 1);
+        const size_t rowsize = 45 * bpp_of(fmt);
+        std::vector<uint8_t> out(rowsize * 38, 0);
+        size_t rows = 0;
+        r.beginRows(90, 77, [&](const uint8_t* row, size_t y) {
+            std::memcpy(out.data() + y * rowsize, row, rowsize);
+            ++rows;
+        });
+        // pushed by 1, 2 and 5 rows.
+        size_t y = 0;
+        for (size_t n = 1; y < 77; n = n % 5 + 1) {
+            n = std::min(n, 77 - y);
+            r.pushRows(src.p + y * src.stride, n, src.stride);
+            y += n;
+        }
+        CHECK(rows == 38 && r.getPushedRows() == 77, name_of(fmt, mode, 0));
+        CHECK(compare(fmt, out.data(), rowsize, ref.data(), rowsize, rowsize, 38) == 0,
+              name_of(fmt, mode, 0));
+    }
+}
+
+
+// Images of negative strides (bu) are read and written bottom-up.
+static void test_batch()
+{
+    for (auto fmt : formats) for (int bu = 0; bu < 2; ++bu) {
+        std::vector<Image> srcs, bus, dsts;
+        srcs.reserve(sizeof(sizes) / sizeof(sizes[0]));
+        bus.reserve(sizeof(sizes) / sizeof(sizes[0]));
+        dsts.reserve(sizeof(sizes) / sizeof(sizes[0]));
+        for (auto& sz : sizes) {
+            srcs.emplace_back(fmt, sz[0], sz[1], false);
+            srcs.back().fill(fmt, static_cast<unsigned>(sz[0]));
+            bus.push_back(flipped(fmt, srcs.back(), false));
+            dsts.emplace_back(fmt, sz[0] / 2, sz[1] / 2, sz[0] % 2 == 0);
+        }
+        std::vector<ResizeHalf::BatchItem> items;
+        for (size_t i = 0; i < srcs.size(); ++i) {
+            const ptrdiff_t ds = static_cast<ptrdiff_t>(dsts[i].stride);
+            const ptrdiff_t ss = static_cast<ptrdiff_t>(srcs[i].stride);
+            items.push_back(ResizeHalf::BatchItem{
+                bu ? top(dsts[i]) : dsts[i].p, bu ? top(bus[i]) : srcs[i].p,
+                srcs[i].width, srcs[i].height, bu ? -ds : ds, bu ? -ss : ss, nullptr});
+        }
+        items.push_back(ResizeHalf::BatchItem{dsts[0].p, srcs[0].p, 8, 8, 0, 0, nullptr});
+
+        ResizeHalf r(fmt);
+        r.setThreads(2);
+        CHECK(r.resizeBatch(items.data(), items.size()) == 1, name_of(fmt, 0, 0));
+        CHECK(items.back().error != nullptr, name_of(fmt, 0, 0));
+        for (size_t i = 0; i < srcs.size(); ++i) {
+            auto ref = repeat_hv(r, fmt, srcs[i], 1);
+            const size_t rowsize = dsts[i].width * bpp_of(fmt);
+            CHECK(items[i].error == nullptr, name_of(fmt, 0, static_cast<int>(i)));
+            const ptrdiff_t ds = static_cast<ptrdiff_t>(dsts[i].stride);
+            CHECK(compare(fmt, bu ? top(dsts[i]) : dsts[i].p, bu ? -ds : ds, ref.data(),
+                          rowsize, rowsize, dsts[i].height) == 0,
+                  name_of(fmt, bu, static_cast<int>(i)));
+        }
+    }
+}
+
+
+// Planes of resizeYUV() are the same as resizing them one by one. The planes
+// of negative strides (bu) are read and written bottom-up.
+static void test_yuv()
+{
+    const size_t w = 132, h = 100;
+    for (auto mode : modes) for (int layout = ResizeHalf::I420; layout <= ResizeHalf::NV12;
+                                 ++layout) for (int bu = 0; bu < 2; ++bu) {
+        const int n = layout == ResizeHalf::I420 ? 3 : 2;
+        std::vector<Image> srcs, bus, dsts;
+        srcs.reserve(n);
+        bus.reserve(n);
+        dsts.reserve(n);
+        const uint8_t* sp[3];
+        uint8_t* dp[3];
+        ptrdiff_t ss[3], ds[3];
+        for (int i = 0; i < n; ++i) {
+            const size_t pw = i == 0 ? w : layout == ResizeHalf::NV12 ? w : w / 2;
+            srcs.emplace_back(ResizeHalf::GREY8, pw, i == 0 ? h : h / 2, false);
+            srcs.back().fill(ResizeHalf::GREY8, static_cast<unsigned>(i + 1));
+            bus.push_back(flipped(ResizeHalf::GREY8, srcs.back(), false));
+            dsts.emplace_back(ResizeHalf::GREY8, pw / 2, srcs.back().height / 2, false);
+        }
+        for (int i = 0; i < n; ++i) {
+            sp[i] = bu ? top(bus[i]) : srcs[i].p;
+            dp[i] = bu ? top(dsts[i]) : dsts[i].p;
+            ss[i] = static_cast<ptrdiff_t>(srcs[i].stride) * (bu ? -1 : 1);
+            ds[i] = static_cast<ptrdiff_t>(dsts[i].stride) * (bu ? -1 : 1);
+        }
+        ResizeHalf r(ResizeHalf::GREY8, mode);
+        r.resizeYUV(static_cast<ResizeHalf::YUV>(layout), dp, sp, w, h, ds, ss);
+
+        for (int i = 0; i < n; ++i) {
+            const bool uv = layout == ResizeHalf::NV12 && i == 1;
+            ResizeHalf c(ResizeHalf::GREY8, mode);
+            c.setSimd(ResizeHalf::SIMD_NONE);
+            std::vector<uint8_t> ref;
+            if (uv) {
+                // reduce U and V apart.
+                const size_t cw = w / 2, chh = h / 2;
+                ref.resize(cw / 2 * 2 * (chh / 2));
+                for (int k = 0; k < 2; ++k) {
+                    Image plane(ResizeHalf::GREY8, cw, chh, false);
+                    for (size_t y = 0; y < chh; ++y) {
+                        for (size_t x = 0; x < cw; ++x) {
+                            plane.p[y * plane.stride + x] = srcs[i].p[y * srcs[i].stride + 2 * x + k];
+                        }
+                    }
+                    c.resizeHV(nullptr, plane.p, cw, chh, 0, plane.stride);
+                    for (size_t y = 0; y < chh / 2; ++y) {
+                        for (size_t x = 0; x < cw / 2; ++x) {
+                            ref[y * cw + 2 * x + k] = c.data()[y * c.getStride() + x];
+                        }
+                    }
+                }
+            } else {
+                ref = repeat_hv(c, ResizeHalf::GREY8, srcs[i], 1);
+            }
+            const size_t rowsize = dsts[i].width;
+            int d = compare(ResizeHalf::GREY8, dp[i], ds[i], ref.data(), rowsize,
+                            rowsize, dsts[i].height);
+            const int tolerance = mode == ResizeHalf::REDUCE_BY_2_EXACT ? 0 : 1;
+            CHECK(d >= 0 && d <= tolerance, name_of(layout, mode, i));
+        }
+    }
+}
+
+
+// Conversions are the same as resizing and converting by C.
+static void test_conversion()
+{
+    const ResizeHalf::FMT fmts[] = {ResizeHalf::RGB888, ResizeHalf::RGBA8888};
+    for (auto fmt : fmts) for (int conv = 1; conv <= 3; ++conv) for (int pt = HV; pt <= V; ++pt) {
+        if (conv == ResizeHalf::CONV_RGBA && fmt != ResizeHalf::RGB888) {
+            continue;
+        }
+        const size_t ch = bpp_of(fmt);
+        const size_t ob = conv == ResizeHalf::CONV_RGBA ? 4 : conv == ResizeHalf::CONV_GREY ? 1 : ch;
+        for (auto& sz : sizes) {
+            Image src(fmt, sz[0], sz[1], false);
+            src.fill(fmt, 17);
+            const size_t ow = pt == V ? sz[0] : sz[0] / 2;
+            const size_t oh = pt == H ? sz[1] : sz[1] / 2;
+            ResizeHalf r(fmt, ResizeHalf::REDUCE_BY_2_EXACT);
+            Image plain(fmt, ow, oh, false);
+            resize(r, pt, plain.p, src, plain.stride);
+
+            std::vector<uint8_t> ref(ow * ob * oh);
+            for (size_t y = 0; y < oh; ++y) {
+                for (size_t x = 0; x < ow; ++x) {
+                    const uint8_t* s = plain.p + y * plain.stride + x * ch;
+                    uint8_t* d = ref.data() + (y * ow + x) * ob;
+                    if (conv == ResizeHalf::CONV_RGBA) {
+                        d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 255;
+                    } else if (conv == ResizeHalf::CONV_GREY) {
+                        d[0] = static_cast<uint8_t>((77 * s[0] + 150 * s[1] + 29 * s[2] + 128) >> 8);
+                    } else {
+                        std::memcpy(d, s, ch);
+                        std::swap(d[0], d[2]);
+                    }
+                }
+            }
+
+            r.setConversion(static_cast<ResizeHalf::CONV>(conv));
+            r.setThreads(2);
+            std::vector<uint8_t> dst(ow * ob * oh);
+            resize(r, pt, dst.data(), src, ow * ob);
+            CHECK(dst == ref, name_of(fmt, conv, pt));
+        }
+    }
+}
+
+
+static bool throws(const std::function<void()>& f)
+{
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+
+// Reducing in place gives the same results as to another buffer, with
+// dst_stride of src_stride or the default one.
+static void test_in_place()
+{
+    const int simds[] = {ResizeHalf::SIMD_NONE, ResizeHalf::getSupportedSimd()};
+    for (auto fmt : formats) for (auto mode : modes) for (int pt = HV; pt <= V; ++pt) {
+        for (auto simd : simds) for (int aligned = 0; aligned < 2; ++aligned) {
+            Image src(fmt, 130, 67, aligned != 0);
+            src.fill(fmt, 37);
+            const size_t ow = pt == V ? 130 : 65, oh = pt == H ? 67 : 33;
+            const size_t rowsize = ow * bpp_of(fmt);
+            ResizeHalf r(fmt, mode);
+            r.setSimd(static_cast<ResizeHalf::SIMD>(simd));
+            r.setThreads(4);
+            Image ref(fmt, ow, oh, aligned != 0);
+            resize(r, pt, ref.p, src, ref.stride);
+            // the default dst_stride of V may be larger than src_stride.
+            for (int packed = 0; packed < (pt == V ? 1 : 2); ++packed) {
+                Image img = src;
+                img.p = img.mem.data() + (src.p - src.mem.data());
+                const size_t ds = packed ? 0 : img.stride;
+                resize(r, pt, img.p, img, ds);
+                CHECK(compare(fmt, img.p, packed ? (rowsize + 3) & ~size_t(3) : ds,
+                              ref.p, ref.stride, rowsize, oh) == 0,
+                      name_of(fmt, mode, pt));
+            }
+        }
+    }
+
+    Image src(ResizeHalf::RGB888, 61, 40, false);
+    src.fill(ResizeHalf::RGB888, 41);
+    ResizeHalf r(ResizeHalf::RGB888);
+    r.setConversion(ResizeHalf::CONV_GREY);
+    std::vector<uint8_t> ref(30 * 20);
+    r.resizeHV(ref.data(), src.p, 61, 40, 30, src.stride);
+    r.resizeHV(src.p, src.p, 61, 40, 30, src.stride);
+    CHECK(compare(ResizeHalf::GREY8, src.p, 30, ref.data(), 30, 30, 20) == 0, "conversion");
+    r.setConversion(ResizeHalf::CONV_RGBA);
+    CHECK(throws([&] { r.resizeVertical(src.p, src.p, 61, 40, 0, src.stride); }), "dst_stride");
+}
+
+
+// Bottom-up images of negative strides give the same results as top-down ones,
+// as sources, as destinations and in place.
+static void test_negative_stride()
+{
+    const int simds[] = {ResizeHalf::SIMD_NONE, ResizeHalf::getSupportedSimd()};
+    for (auto fmt : formats) for (auto mode : modes) for (int pt = HV; pt <= V; ++pt) {
+        for (auto simd : simds) for (int aligned = 0; aligned < 2; ++aligned) {
+            Image src(fmt, 130, 67, aligned != 0);
+            src.fill(fmt, 43);
+            const size_t ow = pt == V ? 130 : 65, oh = pt == H ? 67 : 33;
+            const size_t rowsize = ow * bpp_of(fmt);
+            ResizeHalf r(fmt, mode);
+            r.setSimd(static_cast<ResizeHalf::SIMD>(simd));
+            Image ref(fmt, ow, oh, aligned != 0);
+            resize(r, pt, ref.p, src, ref.stride);
+
+            Image bu = flipped(fmt, src, aligned != 0);
+            const ptrdiff_t bs = -static_cast<ptrdiff_t>(bu.stride);
+            auto run = [&](uint8_t* d, const ptrdiff_t ds, const uint8_t* s, const ptrdiff_t ss) {
+                if (pt == HV) {
+                    r.resizeHV(d, s, 130, 67, ds, ss);
+                } else if (pt == H) {
+                    r.resizeHorizontal(d, s, 130, 67, ds, ss);
+                } else {
+                    r.resizeVertical(d, s, 130, 67, ds, ss);
+                }
+            };
+            // source, destination and both bottom-up, on 1 and 2 threads and
+            // in vertical strips.
+            for (int neg = 1; neg <= 3; ++neg) for (int threads = 1; threads <= 2; ++threads) {
+                r.setThreads(static_cast<size_t>(threads));
+                r.setTileWidth(threads == 2 ? 64 : 0);
+                Image dst(fmt, ow, oh, aligned != 0);
+                const ptrdiff_t ds = neg & 2 ? -static_cast<ptrdiff_t>(dst.stride) : dst.stride;
+                uint8_t* d = neg & 2 ? top(dst) : dst.p;
+                run(d, ds, neg & 1 ? top(bu) : src.p, neg & 1 ? bs : src.stride);
+                char what[128];
+                std::snprintf(what, sizeof(what), "%s simd %d aligned %d neg %d threads %d",
+                              name_of(fmt, mode, pt).c_str(), simd, aligned, neg, threads);
+                CHECK(compare(fmt, d, ds, ref.p, ref.stride, rowsize, oh) == 0, what);
+            }
+
+            r.setThreads(1);
+            r.setTileWidth(0);
+            Image img = bu;
+            img.p = img.mem.data() + (bu.p - bu.mem.data());
+            run(top(img), bs, top(img), bs);
+            CHECK(compare(fmt, top(img), bs, ref.p, ref.stride, rowsize, oh) == 0,
+                  name_of(fmt, mode, pt) + " in place");
+        }
+    }
+
+    // conversion, quarter, pyramid and rows pushed from a bottom-up source.
+    const auto fmt = ResizeHalf::RGB888;
+    Image src(fmt, 203, 150, false);
+    src.fill(fmt, 47);
+    Image bu = flipped(fmt, src, false);
+    const ptrdiff_t bs = -static_cast<ptrdiff_t>(bu.stride);
+    ResizeHalf r(fmt);
+
+    r.setConversion(ResizeHalf::CONV_GREY);
+    std::vector<uint8_t> grey(101 * 75), bu_grey(101 * 75);
+    r.resizeHV(grey.data(), src.p, 203, 150, 101, src.stride);
+    r.resizeHV(bu_grey.data() + 101 * 74, top(bu), 203, 150, -101, bs);
+    CHECK(compare(ResizeHalf::GREY8, bu_grey.data() + 101 * 74, -101, grey.data(), 101,
+                  101, 75) == 0, "conversion");
+    r.setConversion(ResizeHalf::CONV_NONE);
+
+    auto ref = repeat_hv(r, fmt, src, 2);
+    Image dst(fmt, 50, 37, false);
+    r.setThreads(3);
+    r.resizeQuarter(top(dst), top(bu), 203, 150, -static_cast<ptrdiff_t>(dst.stride), bs);
+    CHECK(compare(fmt, top(dst), -static_cast<ptrdiff_t>(dst.stride), ref.data(), 150,
+                  150, 37) == 0, "quarter");
+    r.setThreads(1);
+
+    auto levels = r.buildPyramid(nullptr, top(bu), 203, 150, bs, 4);
+    const size_t size = levels.back().offset + levels.back().stride * levels.back().height;
+    std::vector<uint8_t> pyramid(r.data(), r.data() + size);
+    for (size_t k = 0; k < levels.size(); ++k) {
+        auto lref = repeat_hv(r, fmt, src, static_cast<int>(k + 1));
+        const auto& l = levels[k];
+        CHECK(compare(fmt, pyramid.data() + l.offset, l.stride, lref.data(), l.width * 3,
+                      l.width * 3, l.height) == 0, "pyramid");
+    }
+
+    ref = repeat_hv(r, fmt, src, 1);
+    std::vector<uint8_t> out(303 * 75);
+    r.beginRows(203, 150, [&](const uint8_t* row, size_t y) {
+        std::memcpy(out.data() + y * 303, row, 303);
+    });
+    r.pushRows(top(bu), 150, bs);
+    CHECK(compare(fmt, out.data(), 303, ref.data(), 303, 303, 75) == 0, "push_rows");
+
+    CHECK(throws([&] { r.resizeHV(nullptr, top(bu), 203, 150, 0, -600); }), "src_stride");
+    CHECK(throws([&] { r.resizeHV(top(bu), top(bu), 203, 150, 609, bs); }), "in place");
+}
+
+
+// resizeROI() gives the same results as resizeHV() of a crop starting at
+// (cx, cy) of the same parity, which has the pixels after roi, and 16x16 at
+// least.
+static void test_roi()
+{
+    const size_t sw = 203, sh = 150;
+    const struct {
+        ResizeHalf::Rect roi;
+        size_t cx, cy;
+    } cases[] = {
+        {{0, 0, 203, 150}, 0, 0},
+        {{5, 7, 100, 61}, 5, 7},
+        {{64, 32, 128, 64}, 64, 32},
+        {{130, 100, 73, 50}, 130, 100},
+        {{3, 9, 6, 5}, 3, 9},
+        {{199, 146, 4, 4}, 187, 134},
+    };
+    const int simds[] = {ResizeHalf::SIMD_NONE, ResizeHalf::getSupportedSimd()};
+    for (auto fmt : formats) for (auto mode : modes) for (auto simd : simds) {
+        for (int aligned = 0; aligned < 2; ++aligned) {
+            const size_t bpp = bpp_of(fmt);
+            const size_t extra = mode == ResizeHalf::BILINEAR ? 0 : 1;
+            Image src(fmt, sw, sh, aligned != 0);
+            src.fill(fmt, 53);
+            ResizeHalf r(fmt, mode), c(fmt, mode);
+            r.setSimd(static_cast<ResizeHalf::SIMD>(simd));
+            c.setSimd(static_cast<ResizeHalf::SIMD>(simd));
+            for (auto& t : cases) {
+                const auto& roi = t.roi;
+                const size_t ow = roi.width / 2, oh = roi.height / 2;
+                const size_t cw = std::min(sw, std::max(t.cx + 16, roi.x + 2 * ow + extra)) - t.cx;
+                const size_t ch = std::min(sh, std::max(t.cy + 16, roi.y + 2 * oh + extra)) - t.cy;
+                Image crop(fmt, cw, ch, false);
+                for (size_t y = 0; y < ch; ++y) {
+                    std::memcpy(crop.p + y * crop.stride,
+                                src.p + (t.cy + y) * src.stride + t.cx * bpp, cw * bpp);
+                }
+                c.resizeHV(nullptr, crop.p, cw, ch, 0, crop.stride);
+                const uint8_t* ref = c.data() + (roi.y - t.cy) / 2 * c.getStride()
+                    + (roi.x - t.cx) / 2 * bpp;
+
+                char what[128];
+                std::snprintf(what, sizeof(what), "%s simd %d aligned %d roi %zu,%zu",
+                              name_of(fmt, mode, 0).c_str(), simd, aligned, roi.x, roi.y);
+                for (int out = 0; out < 3; ++out) {
+                    r.setThreads(out == 2 ? 3 : 1);
+                    r.setTileWidth(out == 2 ? 64 : 0);
+                    Image dst(fmt, ow, oh, out == 0);
+                    r.resizeROI(out < 2 ? dst.p : nullptr, src.p, sw, sh, roi,
+                                dst.stride, src.stride);
+                    const uint8_t* d = out < 2 ? dst.p : r.data();
+                    const size_t ds = out < 2 ? dst.stride : r.getStride();
+                    CHECK(r.getWidth() == ow && r.getHeight() == oh, what);
+                    CHECK(compare(fmt, d, ds, ref, c.getStride(), ow * bpp, oh) == 0, what);
+                }
+            }
+        }
+    }
+
+    const auto fmt = ResizeHalf::RGBA8888;
+    Image src(fmt, sw, sh, true);
+    src.fill(fmt, 59);
+    Image bu = flipped(fmt, src, true);
+    ResizeHalf r(fmt);
+    const ResizeHalf::Rect roi = {9, 20, 90, 70};
+    Image a(fmt, 45, 35, true), b(fmt, 45, 35, true);
+    r.resizeROI(a.p, src.p, sw, sh, roi, a.stride, src.stride);
+    r.resizeROI(b.p, top(bu), sw, sh, roi, b.stride, -static_cast<ptrdiff_t>(bu.stride));
+    CHECK(compare(fmt, a.p, a.stride, b.p, b.stride, 45 * 4, 35) == 0, "bottom-up");
+
+    CHECK(throws([&] { r.resizeROI(a.p, src.p, sw, sh, {200, 0, 4, 4}); }), "roi");
+    CHECK(throws([&] { r.resizeROI(a.p, src.p, sw, sh, {0, 0, 1, 4}); }), "roi");
+    CHECK(throws([&] { r.resizeROI(a.p, src.p, sw, sh, {0, 0, 8, 8}, 8); }), "dst_stride");
+
+    // no region of 16 columns from an odd one in 16 has the last column, so the
+    // result is compared with the same image at the bottom-right of 32x32.
+    const ResizeHalf::Rect smalls[] = {
+        {1, 0, 8, 16}, {13, 3, 3, 12}, {0, 0, 16, 16}, {5, 13, 10, 3},
+    };
+    for (auto f : formats) for (auto mode : modes) {
+        const size_t bpp = bpp_of(f);
+        Image big(f, 32, 32, true);
+        big.fill(f, 61);
+        ResizeHalf s16(f, mode), s32(f, mode);
+        for (auto& t : smalls) {
+            const size_t ow = t.width / 2, oh = t.height / 2;
+            Image d16(f, ow, oh, false), d32(f, ow, oh, false);
+            const std::string what = name_of(f, mode, static_cast<int>(t.x));
+            CHECK(!throws([&] {
+                s16.resizeROI(d16.p, big.p + 16 * big.stride + 16 * bpp, 16, 16, t,
+                              d16.stride, big.stride);
+            }), what);
+            s32.resizeROI(d32.p, big.p, 32, 32, {t.x + 16, t.y + 16, t.width, t.height},
+                          d32.stride, big.stride);
+            CHECK(compare(f, d16.p, d16.stride, d32.p, d32.stride, ow * bpp, oh) == 0, what);
+            s16.resizeROI(nullptr, big.p + 16 * big.stride + 16 * bpp, 16, 16, t, 0,
+                          big.stride);
+            CHECK(s16.getWidth() == ow && s16.getHeight() == oh, what);
+            CHECK(compare(f, s16.data(), s16.getStride(), d32.p, d32.stride, ow * bpp,
+                          oh) == 0, what);
+        }
+    }
+}
+
+
+// Counts the buffers allocated and not freed.
+struct CountingAllocator : ResizeHalf::Allocator {
+    ResizeHalf::BufferPool pool;
+    std::atomic<int> live;
+
+    CountingAllocator() : live(0) {}
+
+    void* allocate(const size_t size, const size_t alignment) noexcept override
+    {
+        void* p = pool.allocate(size, alignment);
+        live += p ? 1 : 0;
+        return p;
+    }
+
+    void deallocate(void* p, const size_t size) noexcept override
+    {
+        --live;
+        pool.deallocate(p, size);
+    }
+};
+
+
+// Buffers are allocated and freed by the allocator set, and instances are
+// moved with their buffers.
+static void test_allocator()
+{
+    auto counter = std::make_shared<CountingAllocator>();
+    const ResizeHalf::FMT fmt = ResizeHalf::RGB888;
+    Image src(fmt, 130, 67, false);
+    src.fill(fmt, 43);
+    Image ref(fmt, 65, 33, false);
+    {
+        ResizeHalf r(fmt);
+        resize(r, HV, ref.p, src, ref.stride);
+
+        std::vector<ResizeHalf> rs;
+        for (int i = 0; i < 3; ++i) {
+            rs.emplace_back(fmt);
+            rs.back().setAllocator(counter);
+            rs.back().setThreads(2);
+        }
+        for (auto& x : rs) {
+            resize(x, HV, nullptr, src, 0);
+            x.resizeQuarter(nullptr, src.p, 130, 67, 0, src.stride);
+            x.resizeHV(nullptr, src.p, 130, 67, 0, src.stride);
+        }
+        CHECK(counter->live == 3, "intermediate buffers");
+        ResizeHalf moved(std::move(rs[0]));
+        rs[1] = std::move(moved);
+        CHECK(rs[0].data() == nullptr && moved.data() == nullptr, "moved");
+        CHECK(compare(fmt, rs[1].data(), rs[1].getStride(), ref.p, ref.stride, 65 * 3, 33) == 0,
+              "moved");
+        CHECK(counter->live == 2, "move assignment");
+        rs[2].releaseBuffer();
+        CHECK(rs[2].data() == nullptr && counter->live == 1, "releaseBuffer");
+        rs[2].beginRows(130, 67, [](const uint8_t*, size_t) {});
+        CHECK(counter->live == 2, "beginRows");
+    }
+    CHECK(counter->live == 0, "destructor");
+    CHECK(counter->pool.getPooledBytes() > 0, "pool");
+    counter->pool.trim();
+    CHECK(counter->pool.getPooledBytes() == 0, "trim");
+
+    ResizeHalf::BufferPool small(8192);
+    void* p = small.allocate(5000, 64);
+    CHECK(p && (reinterpret_cast<uintptr_t>(p) & 63) == 0, "pool alignment");
+    small.deallocate(p, 5000);
+    CHECK(small.getPooledBytes() == 5120 && small.allocate(5100, 16) == p, "pool reuse");
+    small.deallocate(p, 5100);
+    small.deallocate(small.allocate(100000, 64), 100000);
+    CHECK(small.getPooledBytes() == 5120, "max_pooled");
+}
+
+
+// PageAllocator gives writable buffers of any size, of each kind of pages.
+// The intermediate buffer of 3MB is mapped.
+static void test_page_allocator()
+{
+    const ResizeHalf::FMT fmt = ResizeHalf::RGBA8888;
+    Image src(fmt, 2000, 1500, true);
+    src.fill(fmt, 47);
+    Image ref(fmt, 1000, 750, true);
+    ResizeHalf r(fmt);
+    resize(r, HV, ref.p, src, ref.stride);
+    for (int pages = 0; pages <= 2; ++pages) {
+        auto a = std::make_shared<ResizeHalf::PageAllocator>(
+            static_cast<ResizeHalf::PageAllocator::PAGES>(pages), pages != 1);
+        const size_t sizes[] = {100, (2 << 20) - 1, (2 << 20) + 5};
+        for (auto size : sizes) {
+            auto p = static_cast<uint8_t*>(a->allocate(size, 64));
+            CHECK(p && (reinterpret_cast<uintptr_t>(p) & 63) == 0, "allocate");
+            if (p) {
+                std::memset(p, pages, size);
+                a->deallocate(p, size);
+            }
+        }
+        r.setAllocator(a);
+        r.resizeHV(nullptr, src.p, src.width, src.height, 0, src.stride);
+        CHECK(compare(fmt, r.data(), r.getStride(), ref.p, ref.stride, 1000 * 4, 750) == 0,
+              "pages " + std::to_string(pages));
+    }
+}
+
+
+static void test_errors()
+{
+    std::vector<uint8_t> buf(64 * 64 * 4);
+    ResizeHalf r(ResizeHalf::RGBA8888);
+    CHECK(throws([&] { r.resizeHV(buf.data(), buf.data(), 15, 32); }), "too small");
+    CHECK(throws([&] { r.resizeHV(buf.data(), nullptr, 32, 32); }), "null src");
+    CHECK(throws([&] { r.resizeHV(buf.data(), buf.data(), 32, 32, 0, 64); }), "src_stride");
+    CHECK(throws([&] { r.resizeHV(buf.data(), buf.data(), 32, 32, 32, 0); }), "dst_stride");
+    CHECK(throws([&] { r.resizeQuarter(buf.data(), buf.data(), 30, 32); }), "quarter");
+    CHECK(!throws([&] { r.resizeQuarter(buf.data(), buf.data(), 64, 64); }), "quarter");
+    r.setConversion(ResizeHalf::CONV_RGBA);
+    CHECK(throws([&] { r.resizeHV(buf.data(), buf.data(), 32, 32); }), "conversion");
+    r.setConversion(ResizeHalf::CONV_GREY);
+    CHECK(!throws([&] { r.resizeHV(buf.data(), buf.data(), 32, 32); }), "conversion");
+    CHECK(throws([&] { r.resizeQuarter(buf.data(), buf.data(), 64, 64); }), "conversion");
+}
+
+
+int main()
+{
+    struct {
+        const char* name;
+        void (*func)();
+    } tests[] = {
+        {"simd_matches_c", test_simd_matches_c},
+        {"intermediate_buffer", test_intermediate_buffer},
+        {"threads", test_threads},
+        {"tiles", test_tiles},
+        {"store_policy", test_store_policy},
+        {"cache_size", test_cache_size},
+        {"cascade", test_cascade},
+        {"pyramid", test_pyramid},
+        {"push_rows", test_push_rows},
+        {"batch", test_batch},
+        {"yuv", test_yuv},
+        {"conversion", test_conversion},
+        {"in_place", test_in_place},
+        {"negative_stride", test_negative_stride},
+        {"roi", test_roi},
+        {"allocator", test_allocator},
+        {"page_allocator", test_page_allocator},
+        {"errors", test_errors},
+    };
+
+    std::printf("SIMD: %d\n", ResizeHalf::getSupportedSimd());
+    for (auto& t : tests) {
+        const int before = failures;
+        t.func();
+        std::printf("%-20s %s\n", t.name, failures == before ? "ok" : "FAILED");
+    }
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,616 @@
+/*
+    resizehalf_cli.cpp
+
+    This file is a part of ResizeHalf.
+
+    Copyright (c) 2017-2019 OKA Motofumi <chikuzen.mo at gmail dot com>
+    All Rights Reserved
+
+    This program is free software. It comes without any warranty, to
+    the extent permitted by applicable law. You can redistribute it
+    and/or modify it under the terms of the Do What the Fuck You Want
+    to Public License, Version 2, as published by Sam Hocevar. See
+    http://www.wtfpl.net/ for more details.
+*/
+
+// resizehalf: reduces PGM (P5), PPM (P6) and BMP (24/32bit) files to halves.
+//
+// usage: resizehalf [options] -o DIR INPUT...
+//   INPUT           a file, or a directory of which the .pgm, .ppm and .bmp files
+//                   are processed (not recursively).
+//   -o DIR          output directory. Outputs have the names of the inputs, and
+//                   the inputs of a name already taken by another one fail.
+//   --list FILE     also process the files listed in FILE, one per line.
+//   --levels N      write N levels of the pyramid (default 1). Level k is
+//                   NAME.k.EXT (or NAME.k without EXT) if N > 1.
+//   --mode M        bilinear, reduce (default) or exact.
+//   -j N            number of worker threads, each on its own files (default 1,
+//                   0: the number of CPU threads).
+//   --mmap          write outputs through mappings instead of pwrite(). The
+//                   pixels after the headers are not aligned, so the rows are
+//                   still copied from the buffer of ResizeHalf, and page faults
+//                   of shared mappings are often slower than pwrite().
+//   --quiet         do not print each file.
+//
+// PGM and PPM are GREY8 and RGB888 of maxval 255. BMP are RGB888 (24bit) or
+// RGBA8888 (32bit) of BI_RGB or BI_BITFIELDS, and their headers are copied to
+// the outputs with the new sizes. Bottom-up BMP are reduced from the top row
+// with a negative stride, and written bottom-up as they are stored.
+// Inputs are mapped and read in place. Outputs are reduced to the buffer of
+// ResizeHalf and written with pwrite(), straight from the buffer if its rows
+// are those of the file and otherwise by 1MiB, or through mappings.
+// The throughput is of the input files.
+// POSIX only.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ResizeHalf.h"
+
+
+struct Options {
+    std::string out_dir;
+    std::vector<std::string> inputs;
+    size_t levels = 1;
+    int mode = ResizeHalf::REDUCE_BY_2;
+    size_t jobs = 1;
+    bool mmap = false;
+    bool quiet = false;
+};
+
+
+// An image in a file: pixels start at offset, and the first row in memory
+// is at the top unless it is a bottom-up BMP.
+struct Header {
+    enum Kind { PGM, PPM, BMP } kind;
+    ResizeHalf::FMT format;
+    size_t width;
+    size_t height;
+    size_t stride;
+    size_t offset;
+    bool bottom_up;
+};
+
+
+static size_t bpp_of(const int fmt) { return fmt & 0x3F; }
+
+
+static std::string lower(std::string s)
+{
+    for (auto& c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+
+static std::string extension(const std::string& path)
+{
+    auto slash = path.find_last_of('/');
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return "";
+    }
+    return lower(path.substr(dot));
+}
+
+
+static bool is_image(const std::string& path)
+{
+    auto e = extension(path);
+    return e == ".pgm" || e == ".ppm" || e == ".bmp";
+}
+
+
+// Reads an unsigned number of a PNM header after whitespace and comments.
+static size_t pnm_number(const uint8_t* p, const size_t size, size_t& pos)
+{
+    for (;;) {
+        while (pos < size && std::isspace(p[pos])) {
+            ++pos;
+        }
+        if (pos < size && p[pos] == '#') {
+            while (pos < size && p[pos] != '\n') {
+                ++pos;
+            }
+            continue;
+        }
+        break;
+    }
+    if (pos >= size || !std::isdigit(p[pos])) {
+        throw std::runtime_error("invalid PNM header.");
+    }
+    size_t v = 0;
+    while (pos < size && std::isdigit(p[pos])) {
+        v = v * 10 + (p[pos++] - '0');
+        if (v > (1u << 30)) {
+            throw std::runtime_error("invalid PNM header.");
+        }
+    }
+    return v;
+}
+
+
+static uint32_t le32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+
+static void put_le32(uint8_t* p, const uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+
+static Header parse_header(const uint8_t* p, const size_t size)
+{
+    Header h;
+    if (size >= 2 && p[0] == 'P' && (p[1] == '5' || p[1] == '6')) {
+        h.kind = p[1] == '5' ? Header::PGM : Header::PPM;
+        h.format = p[1] == '5' ? ResizeHalf::GREY8 : ResizeHalf::RGB888;
+        size_t pos = 2;
+        h.width = pnm_number(p, size, pos);
+        h.height = pnm_number(p, size, pos);
+        if (pnm_number(p, size, pos) != 255) {
+            throw std::runtime_error("only maxval 255 is supported.");
+        }
+        if (pos >= size || !std::isspace(p[pos])) {
+            throw std::runtime_error("invalid PNM header.");
+        }
+        h.offset = pos + 1;
+        h.stride = h.width * bpp_of(h.format);
+        h.bottom_up = false;
+    } else if (size >= 54 && p[0] == 'B' && p[1] == 'M') {
+        h.kind = Header::BMP;
+        const int32_t w = static_cast<int32_t>(le32(p + 18));
+        const int32_t ht = static_cast<int32_t>(le32(p + 22));
+        const unsigned bits = p[28] | (p[29] << 8);
+        const uint32_t compression = le32(p + 30);
+        if (le32(p + 14) < 40 || w <= 0 || ht == 0 || ht == INT32_MIN) {
+            throw std::runtime_error("invalid BMP header.");
+        }
+        if (bits == 24 && compression == 0) {
+            h.format = ResizeHalf::RGB888;
+        } else if (bits == 32 && (compression == 0 || compression == 3)) {
+            h.format = ResizeHalf::RGBA8888;
+        } else {
+            throw std::runtime_error("only 24bit and 32bit uncompressed BMP are supported.");
+        }
+        h.width = static_cast<size_t>(w);
+        h.height = static_cast<size_t>(ht < 0 ? -static_cast<int64_t>(ht) : ht);
+        h.offset = le32(p + 10);
+        h.stride = (h.width * bpp_of(h.format) + 3) & ~static_cast<size_t>(3);
+        h.bottom_up = ht > 0;
+    } else {
+        throw std::runtime_error("unknown file format.");
+    }
+    if (h.width == 0 || h.height == 0 || h.offset > size
+            || (size - h.offset) / h.height < h.stride) {
+        throw std::runtime_error("file is truncated.");
+    }
+    return h;
+}
+
+
+// A file mapped read-only, or read-write for size bytes.
+class Mapping {
+    void* addr;
+    size_t len;
+
+public:
+    Mapping() : addr(MAP_FAILED), len(0) {}
+    ~Mapping()
+    {
+        if (addr != MAP_FAILED) {
+            munmap(addr, len);
+        }
+    }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    void map(const int fd, const size_t size, const bool writable)
+    {
+        len = size;
+        addr = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error(std::string("mmap: ") + std::strerror(errno));
+        }
+    }
+
+    uint8_t* data() const { return static_cast<uint8_t*>(addr); }
+};
+
+
+// Closes the file descriptor at the end of the scope.
+struct File {
+    int fd;
+    explicit File(const int f) : fd(f) {}
+    ~File()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+};
+
+
+// Header of the output of w x h from the input.
+static std::vector<uint8_t> make_header(const Header& in, const uint8_t* src,
+                                        const size_t w, const size_t h, size_t& stride)
+{
+    if (in.kind != Header::BMP) {
+        char buf[64];
+        int n = std::snprintf(buf, sizeof(buf), "P%c\n%zu %zu\n255\n",
+                              in.kind == Header::PGM ? '5' : '6', w, h);
+        stride = w * bpp_of(in.format);
+        return std::vector<uint8_t>(buf, buf + n);
+    }
+    // the header and the palette or masks of the input, with the new sizes.
+    std::vector<uint8_t> hdr(src, src + in.offset);
+    stride = (w * bpp_of(in.format) + 3) & ~static_cast<size_t>(3);
+    put_le32(hdr.data() + 2, static_cast<uint32_t>(in.offset + stride * h));
+    put_le32(hdr.data() + 18, static_cast<uint32_t>(w));
+    put_le32(hdr.data() + 22, in.bottom_up ? static_cast<uint32_t>(h)
+                                           : static_cast<uint32_t>(-static_cast<int64_t>(h)));
+    put_le32(hdr.data() + 34, static_cast<uint32_t>(stride * h));
+    return hdr;
+}
+
+
+static void write_all(const int fd, const uint8_t* p, size_t n, off_t pos)
+{
+    while (n > 0) {
+        ssize_t r = pwrite(fd, p, n, pos);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            throw std::runtime_error(std::string("pwrite: ") + std::strerror(errno));
+        }
+        p += r;
+        n -= static_cast<size_t>(r);
+        pos += r;
+    }
+}
+
+
+// Whether the bytes after rowsize in the rows of image are zero, as the
+// padding of the files.
+static bool zero_padding(const uint8_t* image, const size_t istride, const size_t rowsize,
+                         const size_t h)
+{
+    for (size_t y = 0; y < h; ++y) {
+        const uint8_t* p = image + y * istride;
+        if (std::any_of(p + rowsize, p + istride, [](uint8_t c) { return c != 0; })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Writes an image of w x h to path, with the header made from the input file
+// src. If r is given, it reduces srcp (the top row) of sstride to the output.
+// Otherwise the rows are copied from image of istride. The rows are stored in
+// the order of the input.
+static void write_image(const std::string& path, const Header& in, const uint8_t* src,
+                        const size_t w, const size_t h, const Options& opt,
+                        const uint8_t* srcp, const ptrdiff_t sstride,
+                        ResizeHalf* r, const uint8_t* image, size_t istride)
+{
+    size_t stride;
+    auto hdr = make_header(in, src, w, h, stride);
+    const size_t size = hdr.size() + stride * h;
+    const size_t rowsize = w * bpp_of(in.format);
+
+    File f(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644));
+    if (f.fd < 0) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+
+    if (!opt.mmap) {
+        // reduce to the intermediate buffer, unless it is there already.
+        if (r) {
+            r->resizeHV(nullptr, srcp, in.width, in.height, 0, sstride);
+            image = r->data();
+            istride = r->getStride();
+        }
+        write_all(f.fd, hdr.data(), hdr.size(), 0);
+        if (!in.bottom_up && istride == stride && zero_padding(image, istride, rowsize, h)) {
+            write_all(f.fd, image, stride * h, static_cast<off_t>(hdr.size()));
+            return;
+        }
+        // rows are staged by 1MiB with the padding of the file. It stays zero.
+        const size_t batch = std::max<size_t>((1 << 20) / stride, 1);
+        std::vector<uint8_t> rows(stride * std::min(batch, h), 0);
+        for (size_t y = 0; y < h; y += batch) {
+            const size_t n = std::min(batch, h - y);
+            for (size_t i = 0; i < n; ++i) {
+                const size_t row = in.bottom_up ? h - 1 - (y + i) : y + i;
+                std::memcpy(rows.data() + i * stride, image + row * istride, rowsize);
+            }
+            write_all(f.fd, rows.data(), stride * n,
+                      static_cast<off_t>(hdr.size() + y * stride));
+        }
+        return;
+    }
+
+    if (ftruncate(f.fd, static_cast<off_t>(size)) != 0) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+    Mapping m;
+    m.map(f.fd, size, true);
+    std::memcpy(m.data(), hdr.data(), hdr.size());
+    // the top row, as srcp. It is not aligned after the header, so resizeHV()
+    // reduces to its buffer and copies the rows.
+    uint8_t* dstp = m.data() + hdr.size() + (in.bottom_up ? (h - 1) * stride : 0);
+    const ptrdiff_t dstride = in.bottom_up ? -static_cast<ptrdiff_t>(stride)
+                                           : static_cast<ptrdiff_t>(stride);
+    if (r) {
+        r->resizeHV(dstp, srcp, in.width, in.height, dstride, sstride);
+    } else {
+        for (size_t y = 0; y < h; ++y) {
+            std::memcpy(dstp + static_cast<ptrdiff_t>(y) * dstride, image + y * istride,
+                        rowsize);
+        }
+    }
+}
+
+
+// Output path of level k (from 1) of levels.
+static std::string output_path(const std::string& dir, const std::string& input,
+                               const size_t k, const size_t levels)
+{
+    auto slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    if (levels > 1) {
+        auto dot = std::min(name.find_last_of('.'), name.size());
+        name = name.substr(0, dot) + "." + std::to_string(k) + name.substr(dot);
+    }
+    return dir + "/" + name;
+}
+
+
+// Reduces a file. Returns the number of levels written.
+static size_t process_file(ResizeHalf& r, const std::string& path, const Options& opt,
+                           size_t& in_bytes)
+{
+    File f(open(path.c_str(), O_RDONLY));
+    struct stat st;
+    if (f.fd < 0 || fstat(f.fd, &st) != 0) {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        throw std::runtime_error("file is empty.");
+    }
+    Mapping m;
+    m.map(f.fd, size, false);
+    madvise(m.data(), size, MADV_SEQUENTIAL);
+    in_bytes = size;
+
+    const Header h = parse_header(m.data(), size);
+    if (h.width < 16 || h.height < 16) {
+        throw std::runtime_error("source image is too small.");
+    }
+    r.setFormat(h.format);
+    const uint8_t* srcp = m.data() + h.offset + (h.bottom_up ? (h.height - 1) * h.stride : 0);
+    const ptrdiff_t sstride = h.bottom_up ? -static_cast<ptrdiff_t>(h.stride)
+                                          : static_cast<ptrdiff_t>(h.stride);
+
+    if (opt.levels == 1) {
+        write_image(output_path(opt.out_dir, path, 1, 1), h, m.data(), h.width / 2,
+                    h.height / 2, opt, srcp, sstride, &r, nullptr, 0);
+        return 1;
+    }
+
+    const size_t min_size = std::max<size_t>(std::min(h.width, h.height) >> opt.levels, 1);
+    auto levels = r.buildPyramid(nullptr, srcp, h.width, h.height, sstride, min_size);
+    const size_t n = std::min(levels.size(), opt.levels);
+    for (size_t k = 0; k < n; ++k) {
+        const auto& l = levels[k];
+        write_image(output_path(opt.out_dir, path, k + 1, opt.levels), h, m.data(),
+                    l.width, l.height, opt, nullptr, 0, nullptr, r.data() + l.offset,
+                    l.stride);
+    }
+    return n;
+}
+
+
+// Appends the images in a directory, or the path itself.
+static void collect(const std::string& path, std::vector<std::string>& files)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        DIR* d = opendir(path.c_str());
+        if (!d) {
+            std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(errno));
+            return;
+        }
+        std::vector<std::string> names;
+        while (dirent* e = readdir(d)) {
+            std::string child = path + "/" + e->d_name;
+            struct stat cs;
+            if (is_image(child) && stat(child.c_str(), &cs) == 0 && S_ISREG(cs.st_mode)) {
+                names.push_back(child);
+            }
+        }
+        closedir(d);
+        std::sort(names.begin(), names.end());
+        files.insert(files.end(), names.begin(), names.end());
+    } else {
+        files.push_back(path);
+    }
+}
+
+
+static bool parse(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (a == "-o" && has_value) {
+            opt.out_dir = argv[++i];
+        } else if (a == "--list" && has_value) {
+            std::ifstream list(argv[++i]);
+            if (!list) {
+                std::fprintf(stderr, "cannot open %s\n", argv[i]);
+                return false;
+            }
+            for (std::string line; std::getline(list, line);) {
+                if (!line.empty()) {
+                    opt.inputs.push_back(line);
+                }
+            }
+        } else if (a == "--levels" && has_value) {
+            opt.levels = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (a == "--mode" && has_value) {
+            std::string v = argv[++i];
+            if (v == "bilinear") {
+                opt.mode = ResizeHalf::BILINEAR;
+            } else if (v == "reduce") {
+                opt.mode = ResizeHalf::REDUCE_BY_2;
+            } else if (v == "exact") {
+                opt.mode = ResizeHalf::REDUCE_BY_2_EXACT;
+            } else {
+                std::fprintf(stderr, "unknown mode: %s\n", v.c_str());
+                return false;
+            }
+        } else if (a == "-j" && has_value) {
+            opt.jobs = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (a == "--mmap") {
+            opt.mmap = true;
+        } else if (a == "--quiet") {
+            opt.quiet = true;
+        } else if (!a.empty() && a[0] == '-') {
+            std::fprintf(stderr, "unknown option: %s\n", a.c_str());
+            return false;
+        } else {
+            opt.inputs.push_back(a);
+        }
+    }
+    if (opt.out_dir.empty() || opt.inputs.empty() || opt.levels == 0) {
+        std::fprintf(stderr, "usage: resizehalf [options] -o DIR INPUT...\n");
+        return false;
+    }
+    if (opt.jobs == 0) {
+        opt.jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        return 2;
+    }
+    std::vector<std::string> files;
+    for (auto& in : opt.inputs) {
+        collect(in, files);
+    }
+
+    // An output of the same name as of an earlier file would overwrite it, so
+    // the file fails. No image has more than 32 levels.
+    std::map<std::string, std::string> owners;
+    std::vector<std::string> unique;
+    size_t collided = 0;
+    for (auto& f : files) {
+        std::vector<std::string> outs;
+        for (size_t k = 1; k <= std::min<size_t>(opt.levels, 32); ++k) {
+            outs.push_back(output_path(opt.out_dir, f, k, opt.levels));
+        }
+        auto other = owners.end();
+        for (auto& o : outs) {
+            other = owners.find(o);
+            if (other != owners.end()) {
+                break;
+            }
+        }
+        if (other != owners.end()) {
+            std::fprintf(stderr, "%s: output %s is also of %s\n", f.c_str(),
+                         other->first.c_str(), other->second.c_str());
+            ++collided;
+            continue;
+        }
+        for (auto& o : outs) {
+            owners.emplace(o, f);
+        }
+        unique.push_back(f);
+    }
+    files.swap(unique);
+
+    // Workers share the buffers freed by each other.
+    auto pool = std::make_shared<ResizeHalf::BufferPool>();
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> done(0), failed(collided), outputs(0);
+    std::atomic<uint64_t> bytes(0);
+    std::mutex print;
+
+    auto worker = [&] {
+        ResizeHalf r(ResizeHalf::GREY8, static_cast<ResizeHalf::MODE>(opt.mode));
+        r.setAllocator(pool);
+        for (size_t i = next++; i < files.size(); i = next++) {
+            size_t in_bytes = 0;
+            try {
+                outputs += process_file(r, files[i], opt, in_bytes);
+                bytes += in_bytes;
+                ++done;
+                if (!opt.quiet) {
+                    std::lock_guard<std::mutex> lock(print);
+                    std::printf("%s\n", files[i].c_str());
+                }
+            } catch (const std::exception& e) {
+                ++failed;
+                std::lock_guard<std::mutex> lock(print);
+                std::fprintf(stderr, "%s: %s\n", files[i].c_str(), e.what());
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(opt.jobs, files.size()); ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+    const double sec = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu files (%zu outputs, %zu failed), %.1f MB in %.3f s: "
+                "%.1f files/s, %.1f MB/s\n",
+                done.load(), outputs.load(), failed.load(), bytes / 1e6, sec,
+                done / std::max(sec, 1e-9), bytes / 1e6 / std::max(sec, 1e-9));
+    return failed > 0 ? 1 : 0;
+}